@@ -14,9 +14,10 @@
 #include "em_device.h"
 
 #include "button.h"
+#include "irqlevel.h"
 
 #ifndef BUTTON_INT_LEVEL
-#define BUTTON_INT_LEVEL 3
+#define BUTTON_INT_LEVEL IRQ_LEVEL_BUTTON
 #endif
 
 // Constant to access GPIO Port B where buttons are connected
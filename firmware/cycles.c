@@ -0,0 +1,20 @@
+/**
+ * @file    cycles.c
+ * @brief   Cycle counting using the DWT unit of the Cortex-M3
+ * @version 1.0
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "cycles.h"
+
+/**
+ * @brief   Cycles_Init
+ *
+ * @note    Enables the trace unit and starts the DWT cycle counter
+ */
+void Cycles_Init(void) {
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;     // Enable DWT
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;                // Start counter
+}
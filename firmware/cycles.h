@@ -0,0 +1,25 @@
+#ifndef CYCLES_H
+#define CYCLES_H
+/**
+ * @file    cycles.h
+ * @brief   Cycle counting using the DWT unit of the Cortex-M3
+ * @version 1.0
+ *
+ * @note    The counter runs at the core clock and wraps around every
+ *          2^32 cycles (about 89 s at 48 MHz). Differences computed with
+ *          unsigned arithmetic are correct across one wrap around.
+ */
+#include <stdint.h>
+#include "em_device.h"
+
+void Cycles_Init(void);
+
+/**
+ * @brief   Returns the current value of the cycle counter
+ */
+static inline uint32_t Cycles_Read(void) {
+
+    return DWT->CYCCNT;
+}
+
+#endif // CYCLES_H
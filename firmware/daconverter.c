@@ -9,6 +9,7 @@
 #include "em_device.h"
 #include "clock_efm32gg_ext.h"
 #include "daconverter.h"
+#include "irqlevel.h"
 
 /**
  * Configuration parameters
@@ -53,7 +54,7 @@ int DAC_DisableChannels(unsigned bm) {
         DAC0->CH0CTRL &= ~DAC_CH0CTRL_EN;
     }
     if( (bm&DAC_CH1)!=0 ) {
-        DAC0->CH0CTRL &= ~DAC_CH1CTRL_EN;
+        DAC0->CH1CTRL &= ~DAC_CH1CTRL_EN;
     }
     return 0;
 }
@@ -69,8 +70,8 @@ int DAC_EnableChannels(unsigned bm) {
     if( (bm&DAC_CH0)!=0 ) {
         DAC0->CH0CTRL |= DAC_CH0CTRL_EN;
     }
-    if( (bm&DAC_CH0)!=0 ) {
-        DAC0->CH0CTRL |= DAC_CH0CTRL_EN;
+    if( (bm&DAC_CH1)!=0 ) {
+        DAC0->CH1CTRL |= DAC_CH1CTRL_EN;
     }
     return 0;
 }
@@ -101,9 +102,9 @@ unsigned daclkfreq;
 
 
     unsigned chs = 0;
-    if( ch0config == DAC_CHN_NOTUSED )
+    if( ch0config != DAC_CHN_NOTUSED )
         chs |= DAC_CH0;
-    if( ch1config == DAC_CHN_NOTUSED )
+    if( ch1config != DAC_CHN_NOTUSED )
         chs |= DAC_CH1;
 
     // Differential output needs both channels
@@ -247,8 +248,9 @@ int DAC_ConfigureClock(unsigned samplerate) {
 
  *  @returns
  *
+ *  @note       Runs from RAM since it is called for every audio sample
  */
-int DAC_SetOutput(int ch, unsigned v) {
+RAMFUNC int DAC_SetOutput(int ch, unsigned v) {
 
     v &= 0xFFF; // only 12 bits
     if( ch == 0 )
@@ -266,13 +268,14 @@ int DAC_SetOutput(int ch, unsigned v) {
 
  *  @returns    always 0
  *
+ *  @note       Runs from RAM since it is called for every audio sample
  */
-int DAC_SetCombOutput( unsigned vch0, unsigned vch1) {
+RAMFUNC int DAC_SetCombOutput( unsigned vch0, unsigned vch1) {
 
     vch0 &= 0xFFF;
     vch1 &= 0xFFF;
 
-    DAC0->COMBDATA = (vch0<<16)|vch1;
+    DAC0->COMBDATA = (vch1<<16)|vch0;       // CH0DATA in bits 11:0
     return 0;
 }
 /**
@@ -354,6 +357,7 @@ int DAC_DisableIRQ(void) {
 int DAC_EnableIRQ(void) {
 
     DAC0->IEN |= (DAC_IEN_CH0|DAC_IEN_CH1);
+    NVIC_SetPriority(DAC0_IRQn, IRQ_LEVEL_AUDIO_IO);
     NVIC_ClearPendingIRQ(DAC0_IRQn);
     NVIC_EnableIRQ(DAC0_IRQn);
     return 0;
@@ -6,6 +6,7 @@
  * @version 1.0
  */
 #include <stdint.h>
+#include "ramfunc.h"
 
 /**
  * @brief   create a bit mask with bit N set
@@ -48,8 +49,8 @@ int DAC_ConfigureClock(unsigned samplerate);
 int DAC_EnableChannels(unsigned bm);
 int DAC_DisableChannels(unsigned bm);
 unsigned DAC_Status(void);
-int DAC_SetOutput(int ch, unsigned v);
-int DAC_SetCombOutput( unsigned vch0, unsigned vch1);
+RAMFUNC int DAC_SetOutput(int ch, unsigned v);
+RAMFUNC int DAC_SetCombOutput( unsigned vch0, unsigned vch1);
 int DAC_SetDifferentialOutput(int v);
 int DAC_SetSineOuputMode(void);
 int DAC_ClearSineOuputMode(void);
@@ -0,0 +1,81 @@
+/**
+ * @file    deadline.c
+ * @brief   Missed deadlines of the audio path: counters and a log
+ * @version 1.0
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "cycles.h"
+#include "sleep.h"
+#include "deadline.h"
+
+Deadline_Log_t deadline_log;
+
+/**
+ * @brief   Counts a miss and writes it to the log
+ *
+ * @param   cause   DEADLINE_TICK: value = cycles from the interrupt to the
+ *                  end of the handler. DEADLINE_FIFO: underruns so far.
+ *                  DEADLINE_I2S: underruns of the ring so far.
+ *                  DEADLINE_STEP: samples late
+ */
+void Deadline_Record(unsigned cause, uint32_t value) {
+uint32_t primask = __get_PRIMASK();
+Deadline_Event_t *e;
+
+    if( cause >= DEADLINE_CAUSES ) return;
+    __disable_irq();
+    deadline_log.count[cause]++;
+    e = &deadline_log.log[deadline_log.events%DEADLINE_LOG];
+    deadline_log.events++;
+    e->ticks = Sleep_GetTicks();
+    e->cycles = Cycles_Read();
+    e->value = value;
+    e->cause = cause;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief   Returns the misses of one cause since Deadline_Reset
+ */
+uint32_t Deadline_GetCount(unsigned cause) {
+
+    if( cause >= DEADLINE_CAUSES ) return 0;
+    return deadline_log.count[cause];
+}
+
+/**
+ * @brief   Copies the newest events, oldest first
+ *
+ * @note    Does not mask the interrupts: the copy starts over when an event
+ *          comes in meanwhile
+ *
+ * @returns Number of events copied, at most n and DEADLINE_LOG
+ */
+unsigned Deadline_GetLog(Deadline_Event_t *events, unsigned n) {
+uint32_t last;
+unsigned m;
+
+    do {
+        last = deadline_log.events;
+        m = n;
+        if( m > DEADLINE_LOG ) m = DEADLINE_LOG;
+        if( m > last ) m = last;
+        for(unsigned i=0;i<m;i++) {
+            events[i] = deadline_log.log[(last - m + i)%DEADLINE_LOG];
+        }
+    } while( last != deadline_log.events );
+    return m;
+}
+
+/**
+ * @brief   Clears the counters and the log
+ */
+void Deadline_Reset(void) {
+uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    for(unsigned i=0;i<DEADLINE_CAUSES;i++) deadline_log.count[i] = 0;
+    deadline_log.events = 0;
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,49 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+/**
+ * @file    deadline.h
+ * @brief   Missed deadlines of the audio path: counters and a log
+ * @version 1.0
+ *
+ * @note    Each miss is counted by cause and written to a ring of the last
+ *          DEADLINE_LOG events, with the RTC time (Sleep_GetTicks, for the
+ *          time of the show) and the cycle counter (for the distance between
+ *          close events). Read deadline_log with the debugger.
+ *
+ * @note    Deadline_Record is called by the interrupts where the miss is
+ *          seen, at any level. It masks the interrupts for a few cycles,
+ *          which only happens when something was already late.
+ */
+#include <stdint.h>
+
+#define DEADLINE_LOG            16      // Events kept, a power of 2
+
+enum {
+    DEADLINE_TICK,              // SysTick raised again before its handler ended
+    DEADLINE_FIFO,              // Render-ahead FIFO empty: silence played
+    DEADLINE_I2S,               // DMA block not refilled: zeros sent
+    DEADLINE_STEP,              // Step played late after idle
+    DEADLINE_CAUSES
+};
+
+typedef struct {
+    uint32_t ticks;             // RTC ticks (sleep.h)
+    uint32_t cycles;            // Cycle counter (cycles.h)
+    uint32_t value;             // Depends on the cause, see Deadline_Record
+    uint32_t cause;
+} Deadline_Event_t;
+
+typedef struct {
+    volatile uint32_t count[DEADLINE_CAUSES];
+    Deadline_Event_t  log[DEADLINE_LOG];
+    volatile uint32_t events;   // Events recorded, log[events%DEADLINE_LOG] is next
+} Deadline_Log_t;
+
+extern Deadline_Log_t deadline_log;
+
+void     Deadline_Record(unsigned cause, uint32_t value);
+uint32_t Deadline_GetCount(unsigned cause);
+unsigned Deadline_GetLog(Deadline_Event_t *events, unsigned n);
+void     Deadline_Reset(void);
+
+#endif // DEADLINE_H
@@ -0,0 +1,202 @@
+/**
+ * @file    i2s.c
+ * @brief   I2S master transmitter on USART1 for EFM32GG
+ * @version 1.1
+ *
+ * @note    In synchronous mode only the integer part of CLKDIV is used, so
+ *          the bit clock is HFPERCLK/(2*(1+div)). At 48 MHz and 44.1 kHz,
+ *          div = 16 gives 44117.6 Hz, the same rate as SysTick with a
+ *          reload of 1088, so both run from the same crystal without drift.
+ *
+ * @note    The DMA request is TXBL: one halfword per request, written to
+ *          TXDOUBLE, which holds a whole 16 bit frame.
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "clock_efm32gg_ext.h"
+#include "deadline.h"
+#include "gpio.h"
+#include "i2sring.h"
+#include "i2s.h"
+#include "trace.h"
+
+#ifndef BIT
+#define BIT(N) (1U<<(N))
+#endif
+
+#define I2S_USART       USART1
+#define I2S_LOCATION    USART_ROUTE_LOCATION_LOC1
+#define I2S_PINS        (BIT(0)|BIT(2)|BIT(3))  // PD0, PD2, PD3
+
+/**
+ * @brief   DMA control blocks
+ *
+ * @note    With 12 channels the table is aligned to 512 bytes and the
+ *          alternate descriptors start at entry 16
+ */
+#define DMA_ALTERNATE   16
+static DMA_DESCRIPTOR_TypeDef dma_table[2*DMA_ALTERNATE] __attribute__((aligned(512)));
+
+#define DMA_CONTROL     ( DMA_CTRL_DST_INC_NONE                         \
+                         |DMA_CTRL_DST_SIZE_HALFWORD                    \
+                         |DMA_CTRL_SRC_INC_HALFWORD                     \
+                         |DMA_CTRL_SRC_SIZE_HALFWORD                    \
+                         |DMA_CTRL_R_POWER_1                            \
+                         |((I2SRING_WORDS-1)<<_DMA_CTRL_N_MINUS_1_SHIFT) \
+                         |DMA_CTRL_CYCLE_CTRL_PINGPONG )
+
+static I2SRing_t ring;
+
+/**
+ * @brief   Points a descriptor to a block
+ */
+static inline void arm(DMA_DESCRIPTOR_TypeDef *d, const uint16_t *block) {
+
+    d->SRCEND = (void *) &block[I2SRING_WORDS-1];
+    d->DSTEND = (void *) &I2S_USART->TXDOUBLE;
+    d->CTRL   = DMA_CONTROL;
+}
+
+/**
+ * @brief   DMA interrupt: a block has been sent
+ *
+ * @note    The channel is now using the other descriptor. The one that
+ *          finished gets the next block
+ */
+RAMFUNC void DMA_IRQHandler(void) {
+const uint32_t mask = BIT(I2S_DMA_CHANNEL);
+
+    TRACE(TRACE_ISR_ENTER, TRACE_IRQ_DMA);
+    if( DMA->IF&mask ) {
+        DMA->IFC = mask;
+        DMA_DESCRIPTOR_TypeDef *d = &dma_table[I2S_DMA_CHANNEL];
+        if( (DMA->CHALTS&mask) == 0 )
+            d += DMA_ALTERNATE;         // Primary active: alternate finished
+        uint32_t underruns = ring.underruns;
+        arm(d, I2SRing_Take(&ring));
+        if( ring.underruns != underruns )
+            Deadline_Record(DEADLINE_I2S, ring.underruns);
+    }
+    TRACE(TRACE_ISR_EXIT, TRACE_IRQ_DMA);
+}
+
+/**
+ * @brief   I2S_Init
+ *
+ * @param   rate    Sample rate in Hz
+ *
+ * @returns 0=OK, -1 if the rate can not be generated
+ */
+int I2S_Init(unsigned rate) {
+uint32_t f = ClockGetPeripheralClockFrequency();
+uint32_t bitclock = 32*rate;
+
+    if( rate == 0 || 2*bitclock > f )
+        return -1;
+
+    CMU->HFPERCLKDIV |= CMU_HFPERCLKDIV_HFPERCLKEN;     // Enable HFPERCLK
+    CMU->HFPERCLKEN0 |= CMU_HFPERCLKEN0_GPIO|CMU_HFPERCLKEN0_USART1;
+    CMU->HFCORECLKEN0 |= CMU_HFCORECLKEN0_DMA;
+
+    NVIC_DisableIRQ(DMA_IRQn);
+    DMA->CHENC = BIT(I2S_DMA_CHANNEL);
+    I2S_USART->CMD = USART_CMD_TXDIS|USART_CMD_RXDIS|USART_CMD_MASTERDIS
+                    |USART_CMD_CLEARTX|USART_CMD_CLEARRX;
+    I2S_USART->IEN = 0;
+    I2S_USART->IFC = _USART_IFC_MASK;
+
+    // Synchronous, MSB first, data stable on the rising edge, WS from CS
+    I2S_USART->CTRL = USART_CTRL_SYNC|USART_CTRL_MSBF|USART_CTRL_AUTOCS;
+    I2S_USART->FRAME = USART_FRAME_DATABITS_SIXTEEN;
+
+    // Nearest integer divider
+    uint32_t div = (f + bitclock)/(2*bitclock) - 1;
+    I2S_USART->CLKDIV = (div<<8)&_USART_CLKDIV_DIV_MASK;
+
+    I2S_USART->I2SCTRL = USART_I2SCTRL_FORMAT_W16D16
+                        |USART_I2SCTRL_JUSTIFY_LEFT
+                        |USART_I2SCTRL_DELAY
+                        |USART_I2SCTRL_EN;
+
+    GPIO_ConfigPins(GPIOD, I2S_PINS, GPIO_MODE_PUSHPULL);
+    I2S_USART->ROUTE = USART_ROUTE_TXPEN|USART_ROUTE_CLKPEN|USART_ROUTE_CSPEN
+                      |I2S_LOCATION;
+
+    // DMA: channel fed by TXBL of the USART
+    DMA->CONFIG = DMA_CONFIG_EN;
+    DMA->CTRLBASE = (uint32_t) dma_table;
+    DMA->CH[I2S_DMA_CHANNEL].CTRL = DMA_CH_CTRL_SOURCESEL_USART1
+                                   |DMA_CH_CTRL_SIGSEL_USART1TXBL;
+    DMA->IFC = BIT(I2S_DMA_CHANNEL);
+    DMA->IEN |= BIT(I2S_DMA_CHANNEL);
+
+    I2SRing_Reset(&ring);
+    NVIC_SetPriority(DMA_IRQn, I2S_IRQ_LEVEL);
+    NVIC_ClearPendingIRQ(DMA_IRQn);
+    return 0;
+}
+
+/**
+ * @brief   Starts the bit clock
+ *
+ * @note    Both descriptors start with zero blocks, so the engine has two
+ *          blocks of time to fill the ring before the first one is taken
+ */
+void I2S_Start(void) {
+
+    arm(&dma_table[I2S_DMA_CHANNEL], i2sring_zero);
+    arm(&dma_table[I2S_DMA_CHANNEL+DMA_ALTERNATE], i2sring_zero);
+    DMA->CHALTC = BIT(I2S_DMA_CHANNEL);                 // Primary first
+    NVIC_EnableIRQ(DMA_IRQn);
+    DMA->CHENS = BIT(I2S_DMA_CHANNEL);
+    I2S_USART->CMD = USART_CMD_MASTEREN|USART_CMD_TXEN;
+}
+
+/**
+ * @brief   Stops the bus after the word being sent
+ */
+void I2S_Stop(void) {
+
+    NVIC_DisableIRQ(DMA_IRQn);
+    DMA->CHENC = BIT(I2S_DMA_CHANNEL);
+    while( (I2S_USART->STATUS&USART_STATUS_TXC) == 0 ) {}
+    I2S_USART->CMD = USART_CMD_TXDIS|USART_CMD_MASTERDIS;
+    I2SRing_Reset(&ring);
+}
+
+/**
+ * @brief   I2S_Write
+ *
+ * @param   words   Interleaved left and right words
+ * @param   n       Number of words (even)
+ *
+ * @returns Words queued. The others are dropped
+ */
+RAMFUNC uint32_t I2S_Write(const uint16_t *words, uint32_t n) {
+
+    return I2SRing_Write(&ring, words, n);
+}
+
+/**
+ * @brief   Returns the words waiting in the ring
+ */
+uint32_t I2S_GetQueued(void) {
+
+    return I2SRing_GetQueued(&ring);
+}
+
+/**
+ * @brief   Returns the zero blocks sent because the ring was empty
+ */
+uint32_t I2S_GetUnderruns(void) {
+
+    return ring.underruns;
+}
+
+/**
+ * @brief   Returns the words dropped because the ring was full
+ */
+uint32_t I2S_GetDropped(void) {
+
+    return ring.dropped;
+}
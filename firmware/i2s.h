@@ -0,0 +1,34 @@
+#ifndef I2S_H
+#define I2S_H
+/**
+ * @file    i2s.h
+ * @brief   I2S master transmitter on USART1 for EFM32GG
+ * @version 1.1
+ *
+ * @note    Location 1: PD0 = SD (data), PD2 = BCLK, PD3 = WS. Standard I2S
+ *          framing, 16 bit words, left first (WS low), MSB first, one bit
+ *          delay after the WS edge. The bit clock is 32 times the sample rate.
+ *
+ * @note    The words are moved to TXDOUBLE by DMA channel I2S_DMA_CHANNEL in
+ *          ping-pong mode, one block of the ring (see i2sring.h) per
+ *          descriptor. The DMA interrupt arms the next block, so the CPU
+ *          only runs once per I2SRING_FRAMES frames. A missing block is sent
+ *          as zeros and counted as an underrun. Words that do not fit are
+ *          dropped and counted.
+ */
+#include <stdint.h>
+#include "ramfunc.h"
+#include "irqlevel.h"
+
+#define I2S_DMA_CHANNEL         0
+#define I2S_IRQ_LEVEL           IRQ_LEVEL_AUDIO_IO
+
+int      I2S_Init(unsigned rate);
+void     I2S_Start(void);
+void     I2S_Stop(void);
+RAMFUNC uint32_t I2S_Write(const uint16_t *words, uint32_t n);
+uint32_t I2S_GetQueued(void);
+uint32_t I2S_GetUnderruns(void);
+uint32_t I2S_GetDropped(void);
+
+#endif // I2S_H
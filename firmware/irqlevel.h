@@ -0,0 +1,34 @@
+#ifndef IRQLEVEL_H
+#define IRQLEVEL_H
+/**
+ * @file    irqlevel.h
+ * @brief   Interrupt priorities of the application, in one place
+ * @version 1.0
+ *
+ * @note    The EFM32GG has 3 priority bits: 0 is the most urgent and 7 the
+ *          least. An interrupt only preempts those with a higher number;
+ *          equal levels wait for each other.
+ *
+ * @note    Audio comes first, then UI timers, then buttons and comms. A
+ *          handler below the audio level must be short: it records the
+ *          event and signals a task of the main loop (sched.h), where the
+ *          work is done below every interrupt (see main.c). The output
+ *          interrupt never waits for it.
+ *
+ * @note    A task that changes the player masks the mixer (PendSV) with
+ *          BASEPRI set to IRQ_BASEPRI(IRQ_LEVEL_DEFERRED); every other
+ *          interrupt still runs.
+ */
+
+#define IRQ_LEVEL_AUDIO         0       // SysTick: one output frame
+#define IRQ_LEVEL_AUDIO_IO      1       // DMA of the I2S ring, DAC0
+#define IRQ_LEVEL_UI            3       // Touch and UI timers
+#define IRQ_LEVEL_BUTTON        4       // GPIO of the buttons
+#define IRQ_LEVEL_COMMS         5       // UART, debug links
+#define IRQ_LEVEL_TIMEBASE      6       // RTC overflow (sleep.c)
+#define IRQ_LEVEL_DEFERRED      7       // PendSV: mixer
+
+/* BASEPRI value that masks level l and the levels below it */
+#define IRQ_BASEPRI(l)          ((l) << (8 - __NVIC_PRIO_BITS))
+
+#endif // IRQLEVEL_H
@@ -0,0 +1,82 @@
+/**
+ * @file    output_dac.c
+ * @brief   Output backend for DAC0, both channels
+ * @version 1.0
+ *
+ * @note    CH0 (PB11) is the left channel and CH1 (PB12) the right one. Each
+ *          sample is one write to COMBDATA, so both channels change together.
+ *
+ * @note    The right channel has its own requantizer. When the stream goes
+ *          from mono to stereo it starts from the state of the left one,
+ *          with a different dither sequence.
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "daconverter.h"
+#include "output.h"
+
+#define DAC_BITS        12
+#define DAC_BLOCK       8               // Samples converted per pass
+
+static Requant_t requant_left;
+static Requant_t requant_right;
+static int stereo = 0;
+
+static int dac_init(unsigned rate) {
+unsigned conf = DAC_VREF_VDD
+               |DAC_SINGLE_ENDED_OUTPUT;
+
+    (void) rate;                        // Paced by the caller
+    if( DAC_Init(conf,500000,DAC_CHN_LOC_0,DAC_CHN_LOC_0) < 0 )
+        return -1;
+    Requant_Init(&requant_left, DAC_BITS, OUTPUT_REQUANT);
+    Requant_Init(&requant_right, DAC_BITS, OUTPUT_REQUANT);
+    stereo = 0;
+    return 0;
+}
+
+static void dac_start(void) {
+
+    DAC_EnableChannels(DAC_CH0|DAC_CH1);
+}
+
+static void dac_stop(void) {
+
+    DAC_SetCombOutput(1<<(DAC_BITS-1), 1<<(DAC_BITS-1));
+}
+
+static uint32_t dac_latency(void) {
+
+    return 0;                           // Converted as soon as written
+}
+
+RAMFUNC static void dac_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+uint32_t comb[DAC_BLOCK];
+
+    if( right && !stereo ) {
+        requant_right = requant_left;
+        requant_right.seed = ~requant_left.seed;
+    }
+    stereo = right != 0;
+
+    while( n > 0 ) {
+        uint32_t m = (n > DAC_BLOCK) ? DAC_BLOCK : n;
+        Output_ConvertDAC(&requant_left, &requant_right, left, right, comb, m);
+        for(uint32_t k=0;k<m;k++) {
+            DAC0->COMBDATA = comb[k];
+        }
+        left += m;
+        if( right ) right += m;
+        n -= m;
+    }
+}
+
+const Output_Backend_t Output_DAC = {
+    .name     = "DAC",
+    .channels = 2,
+    .init     = dac_init,
+    .start    = dac_start,
+    .submit   = dac_submit,
+    .stop     = dac_stop,
+    .latency  = dac_latency
+};
@@ -0,0 +1,60 @@
+/**
+ * @file    output_i2s.c
+ * @brief   Output backend for an I2S codec on USART1
+ * @version 1.0
+ *
+ * @note    16 bits, stereo, no requantization. The codec does the
+ *          conversion, so the DAC and PWM pins stay free.
+ *
+ * @note    Samples are queued in the ring sent by DMA (see i2s.h), so the
+ *          latency is the queue plus the two blocks armed in the DMA.
+ */
+#include <stdint.h>
+#include "i2s.h"
+#include "i2sring.h"
+#include "output.h"
+
+#define I2S_BLOCK       8               // Frames converted per pass
+
+static int i2s_init(unsigned rate) {
+
+    return I2S_Init(rate);
+}
+
+static void i2s_start(void) {
+
+    I2S_Start();
+}
+
+static void i2s_stop(void) {
+
+    I2S_Stop();                         // Codec output goes to zero
+}
+
+static uint32_t i2s_latency(void) {
+
+    return I2S_GetQueued()/2 + 2*I2SRING_FRAMES;
+}
+
+RAMFUNC static void i2s_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+uint16_t words[2*I2S_BLOCK];
+
+    while( n > 0 ) {
+        uint32_t m = (n > I2S_BLOCK) ? I2S_BLOCK : n;
+        Output_ConvertI2S(left, right, words, m);
+        I2S_Write(words, 2*m);
+        left += m;
+        if( right ) right += m;
+        n -= m;
+    }
+}
+
+const Output_Backend_t Output_I2S = {
+    .name     = "I2S",
+    .channels = 2,
+    .init     = i2s_init,
+    .start    = i2s_start,
+    .submit   = i2s_submit,
+    .stop     = i2s_stop,
+    .latency  = i2s_latency
+};
@@ -0,0 +1,125 @@
+/**
+ * @file    output_pwm.c
+ * @brief   Output backends for the PWM of TIMER0
+ * @version 1.0
+ *
+ * @note    Output_PWM: channel 1 (PC0) with PWM_BITS bits.
+ *
+ * @note    Output_DualPWM: channel 1 (PC0) carries the 7 high bits and
+ *          channel 2 (PC1) the 7 low bits of a 14 bit sample. The outputs are
+ *          summed by a weighted network, PC0 -- R -- OUT -- 128R -- PC1 (e.g.
+ *          1k and 128k), before the low-pass filter. With 1% resistors about
+ *          12-13 bits are effective. The carrier is unchanged (24 MHz / 128).
+ *
+ * @note    Both are mono and update the duty cycle at the next overflow.
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "pwm.h"
+#include "output.h"
+
+#define PWM_TIMER       TIMER0
+#define PWM_LOC         PWM_LOC4        // PWM location for TIMER0 channel 1
+#define PWM_CHANNEL     1
+#define PWM_LSB_CHANNEL 2               // Low bits in dual PWM mode (PC1)
+#define PWM_BITS        7               // TOP = 0x7F
+#define PWM_BLOCK       8               // Samples converted per pass
+
+static Requant_t requant;
+
+static uint32_t pwm_latency(void) {
+
+    return 0;                           // Less than one PWM period
+}
+
+static void pwm_start(void) {
+
+    PWM_Start(PWM_TIMER);
+}
+
+/*
+ * Single PWM
+ */
+
+static int pwm_init(unsigned rate) {
+
+    (void) rate;                        // Paced by the caller
+    if( PWM_Init(PWM_TIMER, PWM_LOC, PWM_PARAMS_CH1_ENABLEPIN) < 0 )
+        return -1;
+    Requant_Init(&requant, PWM_BITS, OUTPUT_REQUANT);
+    return 0;
+}
+
+static void pwm_stop(void) {
+
+    PWM_Write(PWM_TIMER, PWM_CHANNEL, 1<<(PWM_BITS-1));
+}
+
+RAMFUNC static void pwm_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+uint16_t code[PWM_BLOCK];
+
+    (void) right;
+    while( n > 0 ) {
+        uint32_t m = (n > PWM_BLOCK) ? PWM_BLOCK : n;
+        Output_ConvertPWM(&requant, left, code, m);
+        for(uint32_t k=0;k<m;k++) {
+            PWM_Write(PWM_TIMER, PWM_CHANNEL, code[k]);
+        }
+        left += m;
+        n -= m;
+    }
+}
+
+const Output_Backend_t Output_PWM = {
+    .name     = "PWM",
+    .channels = 1,
+    .init     = pwm_init,
+    .start    = pwm_start,
+    .submit   = pwm_submit,
+    .stop     = pwm_stop,
+    .latency  = pwm_latency
+};
+
+/*
+ * Dual PWM
+ */
+
+static int dual_init(unsigned rate) {
+
+    (void) rate;
+    if( PWM_Init(PWM_TIMER, PWM_LOC, PWM_PARAMS_CH1_ENABLEPIN|PWM_PARAMS_CH2_ENABLEPIN) < 0 )
+        return -1;
+    Requant_Init(&requant, 2*PWM_BITS, OUTPUT_REQUANT);
+    return 0;
+}
+
+static void dual_stop(void) {
+
+    PWM_WriteSync(PWM_TIMER, PWM_CHANNEL, 1<<(PWM_BITS-1), PWM_LSB_CHANNEL, 0);
+}
+
+RAMFUNC static void dual_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+uint32_t pair[PWM_BLOCK];
+
+    (void) right;
+    while( n > 0 ) {
+        uint32_t m = (n > PWM_BLOCK) ? PWM_BLOCK : n;
+        Output_ConvertDualPWM(&requant, left, pair, PWM_BITS, m);
+        for(uint32_t k=0;k<m;k++) {
+            PWM_WriteSync(PWM_TIMER, PWM_CHANNEL, pair[k]&0xFFFF,
+                                     PWM_LSB_CHANNEL, pair[k]>>16);
+        }
+        left += m;
+        n -= m;
+    }
+}
+
+const Output_Backend_t Output_DualPWM = {
+    .name     = "PWM2",
+    .channels = 1,
+    .init     = dual_init,
+    .start    = pwm_start,
+    .submit   = dual_submit,
+    .stop     = dual_stop,
+    .latency  = pwm_latency
+};
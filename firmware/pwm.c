@@ -324,9 +324,11 @@ unsigned c = 0;
  * @param    value    The threshold value to be set
  *
  * @note     Uses buffered write to CCV (CCVB)
+ *
+ * @note     Runs from RAM since it is called for every audio sample
  */
 
-int PWM_Write(TIMER_TypeDef *timer, unsigned channel, unsigned value) {
+RAMFUNC int PWM_Write(TIMER_TypeDef *timer, unsigned channel, unsigned value) {
 
     timer->CC[channel].CCVB = value;          // Write to buffer to avoid glitch
 
@@ -335,6 +337,58 @@ int PWM_Write(TIMER_TypeDef *timer, unsigned channel, unsigned value) {
 }
 
 
+/**
+ * @brief   PWM_WriteSync
+ *
+ * @note    Sets the threshold of two channels of the same timer, so that both
+ *          take effect in the same PWM period
+ *
+ * @param    timer Pointer to timer as defined by the efm32gg headers (em_device.h *)
+ *
+ * @param    ch0, value0  First channel and its threshold
+ *
+ * @param    ch1, value1  Second channel and its threshold
+ *
+ * @note     CCVB is copied to CCV at the overflow. If the counter is less than
+ *           PWM_SYNC_GUARD counts from TOP, it waits for the overflow, so it
+ *           can not happen between the two writes. At TOP=0x7F and prescaler
+ *           2 the wait is at most 2*PWM_SYNC_GUARD core cycles. The wait
+ *           gives up after PWM_SYNC_TRIES reads of the counter (timer
+ *           stopped or TOP changed meanwhile), writes anyway and returns -1
+ *
+ * @note     The two CCVB addresses are computed before the wait, so the
+ *           writes are two back to back stores (pwm.o is built with -O2
+ *           even in DEBUG builds, see the Makefile)
+ *
+ * @note     Runs from RAM since it is called for every audio sample
+ *
+ * @returns  0=OK, -1 if the wait timed out
+ */
+
+RAMFUNC int PWM_WriteSync(TIMER_TypeDef *timer, unsigned ch0, unsigned value0,
+                                                unsigned ch1, unsigned value1) {
+volatile uint32_t *ccvb0 = &timer->CC[ch0].CCVB;
+volatile uint32_t *ccvb1 = &timer->CC[ch1].CCVB;
+const uint32_t top = timer->TOP;
+unsigned tries = PWM_SYNC_TRIES;
+int rc = 0;
+
+    if( top > PWM_SYNC_GUARD ) {
+        while( timer->CNT >= top - PWM_SYNC_GUARD ) {
+            if( --tries == 0 ) {
+                rc = -1;
+                break;
+            }
+        }
+    }
+    *ccvb0 = value0;
+    *ccvb1 = value1;
+
+    return rc;
+
+}
+
+
 /**
  * @brief    PWM_ConfigTimer
  *
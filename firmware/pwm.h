@@ -3,6 +3,7 @@
 /**
  * @file    pwm.h
  */
+#include "ramfunc.h"
 
 
 /**
@@ -44,6 +45,24 @@
 
 ///}
 
+/**
+ * @brief   Timer counts before the overflow in which PWM_WriteSync waits
+ *
+ * @note    Must cover the time from the read of CNT to the second CCVB
+ *          write: LDR of CNT, compare and branch, two STR, about 12 core
+ *          cycles at -O2 with the peripheral bus wait states. A count takes
+ *          at least one core cycle, so 16 counts leave a margin of 4
+ */
+#define PWM_SYNC_GUARD                        16
+
+/**
+ * @brief   Reads of CNT after which PWM_WriteSync stops waiting
+ *
+ * @note    A read takes at least 4 cycles, so it covers the guard up to a
+ *          prescaler of 1024
+ */
+#define PWM_SYNC_TRIES                        4096
+
 
 
 int  PWM_Init(TIMER_TypeDef* timer, int loc, unsigned params);
@@ -53,7 +72,9 @@ int  PWM_ConfigTimer(TIMER_TypeDef *timer, unsigned div, unsigned top);
 void PWM_Start(TIMER_TypeDef* timer);
 void PWM_Stop(TIMER_TypeDef* timer);
 int  PWM_Read(TIMER_TypeDef* timer, unsigned channel);
-int  PWM_Write(TIMER_TypeDef *timer, unsigned channel, unsigned value);
+RAMFUNC int  PWM_Write(TIMER_TypeDef *timer, unsigned channel, unsigned value);
+RAMFUNC int  PWM_WriteSync(TIMER_TypeDef *timer, unsigned ch0, unsigned value0,
+                                                 unsigned ch1, unsigned value1);
 
 int  PWM_ReconfigureChannel(TIMER_TypeDef* timer, int channel, unsigned top);
 
@@ -0,0 +1,157 @@
+/**
+ * @file    sleep.c
+ * @brief   Sleep in EM1/EM2 and time spent in each energy mode
+ * @version 1.0
+ *
+ * @note    The RTC runs free. Its overflow interrupt only wakes the core once
+ *          every 512 s, so the 24 bit counter is followed even during a long
+ *          EM2.
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "clock_efm32gg_ext.h"
+#include "cycles.h"
+#include "irqlevel.h"
+#include "sleep.h"
+
+#define RTC_FREQ        SLEEP_TICKS_PER_SECOND
+#define RTC_MASK        0xFFFFFF        // 24 bit counter
+#define RTC_WRAP        (RTC_MASK+1)
+
+static uint32_t rtc_last;               // RTC at the last update
+static uint64_t total_ticks;            // RTC ticks since the reset
+static uint64_t em2_ticks;
+static uint64_t em0_cycles;
+static uint32_t awake_since;            // Cycle counter when the core woke up
+static volatile uint32_t rtc_high;      // Overflows times RTC_WRAP
+
+/**
+ * @brief   Adds the RTC ticks since the last update to the total
+ */
+static void rtc_update(void) {
+uint32_t now = RTC->CNT;
+
+    total_ticks += (now - rtc_last)&RTC_MASK;
+    rtc_last = now;
+}
+
+/**
+ * @brief   RTC IRQ Handler. Overflow only
+ */
+void RTC_IRQHandler(void) {
+
+    RTC->IFC = RTC_IFC_OF;
+    rtc_high += RTC_WRAP;
+}
+
+/**
+ * @brief   Sleep_Init
+ *
+ * @note    Starts the RTC. LFACLK is normally set by LCD_Init, otherwise it is
+ *          set to the LFRCO here
+ */
+void Sleep_Init(void) {
+
+    CMU->HFCORECLKEN0 |= CMU_HFCORECLKEN0_LE;
+    if( (CMU->LFCLKSEL&(_CMU_LFCLKSEL_LFA_MASK|_CMU_LFCLKSEL_LFAE_MASK)) == 0 ) {
+        CMU->OSCENCMD = CMU_OSCENCMD_LFRCOEN;
+        while( (CMU->STATUS&CMU_STATUS_LFRCORDY) == 0 ) {}
+        CMU->LFCLKSEL = (CMU->LFCLKSEL&~_CMU_LFCLKSEL_LFA_MASK)|CMU_LFCLKSEL_LFA_LFRCO;
+    }
+    CMU->LFACLKEN0 |= CMU_LFACLKEN0_RTC;
+
+    RTC->CTRL = 0;
+    while( RTC->SYNCBUSY ) {}
+    RTC->IFC = _RTC_IFC_MASK;
+    RTC->IEN = RTC_IEN_OF;
+    RTC->CTRL = RTC_CTRL_EN;
+    while( RTC->SYNCBUSY ) {}
+
+    NVIC_SetPriority(RTC_IRQn, IRQ_LEVEL_TIMEBASE);
+    NVIC_ClearPendingIRQ(RTC_IRQn);
+    NVIC_EnableIRQ(RTC_IRQn);
+    Sleep_ResetStats();
+}
+
+/**
+ * @brief   Sleeps until an interrupt is pending
+ *
+ * @note    Called with interrupts disabled (PRIMASK set). A pending
+ *          interrupt still wakes the core and runs after __enable_irq
+ *
+ * @param   mode    SLEEP_EM1 or SLEEP_EM2
+ */
+void Sleep_Enter(unsigned mode) {
+uint32_t start;
+
+    em0_cycles += Cycles_Read() - awake_since;
+    rtc_update();
+    start = rtc_last;
+
+    if( mode == SLEEP_EM2 ) {
+        SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    } else {
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    }
+    __DSB();
+    __WFI();
+
+    if( mode == SLEEP_EM2 ) {
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+        (void) SystemCoreClockSet(CLOCK_HFXO, 1, 1);    // Woke up on HFRCO
+        em2_ticks += (RTC->CNT - start)&RTC_MASK;       // Start up of the HFXO included
+    }
+    awake_since = Cycles_Read();
+}
+
+/**
+ * @brief   Sleep_GetStats
+ *
+ * @note    Called while awake, from the main loop or an interrupt
+ */
+void Sleep_GetStats(Sleep_Stats_t *stats) {
+uint64_t total = total_ticks + ((RTC->CNT - rtc_last)&RTC_MASK);
+uint64_t em0 = em0_cycles + (Cycles_Read() - awake_since);
+uint32_t cycles_per_ms = SystemCoreClock/1000;
+
+    stats->total_ms = (uint32_t) (total*1000/RTC_FREQ);
+    stats->em0_ms = (uint32_t) (em0/cycles_per_ms);
+    stats->em2_ms = (uint32_t) (em2_ticks*1000/RTC_FREQ);
+    // The clocks are not locked, EM1 gets the difference
+    uint32_t used = stats->em0_ms + stats->em2_ms;
+    stats->em1_ms = (stats->total_ms > used) ? stats->total_ms - used : 0;
+}
+
+/**
+ * @brief   Sleep_GetTicks
+ *
+ * @note    Callable from any level. An interrupt above the RTC may see the
+ *          overflow before its handler: the pending flag counts then
+ *
+ * @returns RTC ticks since Sleep_Init, wrapping around after 36 hours
+ */
+uint32_t Sleep_GetTicks(void) {
+uint32_t high, cnt;
+
+    do {
+        high = rtc_high;
+        cnt = RTC->CNT;
+        if( RTC->IF&RTC_IF_OF ) {
+            cnt = RTC->CNT;
+            high += RTC_WRAP;
+        }
+    } while( high != rtc_high && (RTC->IF&RTC_IF_OF) == 0 );
+    return high + cnt;
+}
+
+/**
+ * @brief   Sleep_ResetStats
+ */
+void Sleep_ResetStats(void) {
+
+    rtc_last = RTC->CNT;
+    total_ticks = 0;
+    em2_ticks = 0;
+    em0_cycles = 0;
+    awake_since = Cycles_Read();
+}
@@ -0,0 +1,46 @@
+#ifndef SLEEP_H
+#define SLEEP_H
+/**
+ * @file    sleep.h
+ * @brief   Sleep in EM1/EM2 and time spent in each energy mode
+ * @version 1.0
+ *
+ * @note    EM1 only stops the core clock: the peripherals and SysTick keep
+ *          running. EM2 also stops the high frequency clocks, so only the
+ *          low energy peripherals (LCD, RTC) and the GPIO interrupts are
+ *          left. The core wakes up from EM2 on HFRCO and Sleep_Enter starts
+ *          the HFXO again before it returns.
+ *
+ * @note    The time base is the RTC on LFACLK (32768 Hz, enabled by
+ *          LCD_Init). The time awake (EM0) is counted in core cycles
+ *          (cycles.h), the time in EM2 with the RTC and EM1 is the rest.
+ *          Sleep_GetTicks extends the RTC to 32 bits, as the clock of the
+ *          main loop scheduler (sched.h).
+ *
+ * @note    Sleep_Enter must be called with interrupts disabled. The
+ *          interrupt that wakes the core runs when the caller enables them
+ *          again, so its time is counted as awake.
+ */
+#include <stdint.h>
+
+#define SLEEP_TICKS_PER_SECOND  32768   // RTC on LFACLK
+
+enum {
+    SLEEP_EM1 = 1,
+    SLEEP_EM2 = 2
+};
+
+typedef struct {
+    uint32_t total_ms;          // Since Sleep_Init or Sleep_ResetStats
+    uint32_t em0_ms;            // Running
+    uint32_t em1_ms;            // Sleep
+    uint32_t em2_ms;            // Deep sleep
+} Sleep_Stats_t;
+
+void Sleep_Init(void);
+void Sleep_Enter(unsigned mode);
+void Sleep_GetStats(Sleep_Stats_t *stats);
+void Sleep_ResetStats(void);
+uint32_t Sleep_GetTicks(void);
+
+#endif // SLEEP_H
@@ -0,0 +1,61 @@
+/**
+ * @file    swo.c
+ * @brief   ITM stimulus ports on the SWO pin
+ * @version 1.0
+ */
+#include <stdint.h>
+#include "em_device.h"
+#include "gpio.h"
+#include "swo.h"
+
+#ifndef BIT
+#define BIT(N) (1U<<(N))
+#endif
+
+#define SWO_PIN         BIT(2)          // PF2
+#define ITM_UNLOCK      0xC5ACCE55
+
+/**
+ * @brief   SWO_Init
+ *
+ * @note    Starts the AUXHFRCO (clock of the trace port), routes SWO to PF2
+ *          and enables the ITM
+ *
+ * @param   ports   Bit n set: stimulus port n enabled
+ */
+void SWO_Init(uint32_t ports) {
+
+    CMU->HFPERCLKEN0 |= CMU_HFPERCLKEN0_GPIO;           // Enable HFPERCKL for GPIO
+    CMU->OSCENCMD = CMU_OSCENCMD_AUXHFRCOEN;
+    while( (CMU->STATUS&CMU_STATUS_AUXHFRCORDY) == 0 ) {}
+
+    GPIO->ROUTE = (GPIO->ROUTE&~_GPIO_ROUTE_SWLOCATION_MASK)
+                 |GPIO_ROUTE_SWLOCATION_LOC0|GPIO_ROUTE_SWOPEN;
+    GPIO_ConfigPins(GPIOF, SWO_PIN, GPIO_MODE_PUSHPULL);
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    TPI->ACPR = SWO_PRESCALER - 1;
+    TPI->SPPR = 2;                      // NRZ
+    TPI->FFCR = 0x100;                  // No formatter
+
+    ITM->LAR = ITM_UNLOCK;
+    ITM->TCR = (1<<ITM_TCR_TraceBusID_Pos)|ITM_TCR_SWOENA_Msk|ITM_TCR_SYNCENA_Msk
+              |ITM_TCR_ITMENA_Msk;
+    ITM->TPR = 0;
+    ITM->TER = ports;
+}
+
+/**
+ * @brief   Writes a word to a stimulus port if it has room
+ *
+ * @note    Reading the port gives 1 when it can take a word. A disabled
+ *          port or ITM reads 0
+ *
+ * @returns 1 if written, 0 if busy
+ */
+int SWO_TryWrite(unsigned port, uint32_t word) {
+
+    if( (ITM->PORT[port].u32&1) == 0 ) return 0;
+    ITM->PORT[port].u32 = word;
+    return 1;
+}
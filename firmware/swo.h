@@ -0,0 +1,25 @@
+#ifndef SWO_H
+#define SWO_H
+/**
+ * @file    swo.h
+ * @brief   ITM stimulus ports on the SWO pin
+ * @version 1.0
+ *
+ * @note    SWO is PF2 (location 0), the pin of the debug connector of the
+ *          STK3700. NRZ (UART) at AUXHFRCO/SWO_PRESCALER, 875 kHz with the
+ *          14 MHz AUXHFRCO. The probe must use the same speed, for example
+ *          JLinkSWOViewerCL -device EFM32GG990F1024 -swofreq 875000.
+ *
+ * @note    SWO_TryWrite never waits: when the stimulus port has no room it
+ *          returns 0 and the caller drops or retries.
+ */
+#include <stdint.h>
+
+#ifndef SWO_PRESCALER
+#define SWO_PRESCALER           16
+#endif
+
+void SWO_Init(uint32_t ports);
+int  SWO_TryWrite(unsigned port, uint32_t word);
+
+#endif // SWO_H
@@ -0,0 +1,950 @@
+/**
+ * @file    benchmark.c
+ * @brief   Host benchmarks of the signal processing kernels.
+ *
+ * Compile and run with 'make benchmark'. Times are taken with the time
+ * stamp counter on x86 (cycles of the reference clock) and with
+ * clock_gettime elsewhere (then reported in ns). They compare kernels with
+ * each other on the host; cycle counts on the Cortex-M3 are measured with
+ * Cycles_Read on the board.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <math.h>
+
+#include "attackcache.h"
+#include "audiofifo.h"
+#include "biquad.h"
+#include "master.h"
+#include "mixkernel.h"
+#include "output.h"
+#include "player.h"
+#include "premix.h"
+#include "requant.h"
+#include "upsample.h"
+#include "soundbank.h"
+#include "voicebudget.h"
+
+extern const SoundBank_Header_t soundbank;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIT "cycles"
+static uint64_t now(void) { return __rdtsc(); }
+#else
+#define UNIT "ns"
+static uint64_t now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+#endif
+
+#define BLOCK   64          // Samples per call, as in the player
+#define BLOCKS  20000       // Calls per measurement
+#define RUNS    5           // Best of
+
+// Pseudo-random test signal, same on every run
+static void fill_noise(int32_t *x, uint32_t n, int32_t amplitude) {
+    uint32_t r = 12345;
+    for (uint32_t i = 0; i < n; i++) {
+        r = r * 1103515245u + 12345u;
+        x[i] = (int32_t) ((r >> 16) % (2 * amplitude + 1)) - amplitude;
+    }
+}
+
+/*
+ * Biquad cascades: cycles per sample and per section, for the block and
+ * the per-sample functions. Block and per-sample output must match.
+ */
+static int bench_biquad(void) {
+    static int32_t input[BLOCK];
+    static int16_t b16[BLOCK];
+    static int32_t b32[BLOCK];
+    int errors = 0;
+
+    fill_noise(input, BLOCK, 12000);
+    printf("Biquad (%s per sample per section)\n", UNIT);
+
+    for (unsigned sections = 1; sections <= BIQUAD_SECTIONS_MAX; sections++) {
+        Biquad_Q15_t q15, q15t;
+        Biquad_Q31_t q31, q31t;
+        Biquad_InitQ15(&q15); Biquad_InitQ15(&q15t);
+        Biquad_InitQ31(&q31); Biquad_InitQ31(&q31t);
+        for (unsigned s = 0; s < sections; s++) {
+            const Biquad_Coefs_t *c = Biquad_GetPreset(s ? BIQUAD_HP_150 : BIQUAD_LP_4K, 22050);
+            Biquad_AddSectionQ15(&q15, c); Biquad_AddSectionQ15(&q15t, c);
+            Biquad_AddSectionQ31(&q31, c); Biquad_AddSectionQ31(&q31t, c);
+        }
+
+        uint64_t best[4] = { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX };
+        for (int run = 0; run < RUNS; run++) {
+            uint64_t t0 = now();
+            for (int b = 0; b < BLOCKS; b++) {
+                for (int i = 0; i < BLOCK; i++) b16[i] = (int16_t) input[i];
+                Biquad_ProcessQ15(&q15, b16, BLOCK);
+            }
+            uint64_t t1 = now();
+            for (int b = 0; b < BLOCKS; b++) {
+                for (int i = 0; i < BLOCK; i++) b16[i] = Biquad_TickQ15(&q15t, (int16_t) input[i]);
+            }
+            uint64_t t2 = now();
+            for (int b = 0; b < BLOCKS; b++) {
+                memcpy(b32, input, sizeof(b32));
+                Biquad_ProcessQ31(&q31, b32, BLOCK);
+            }
+            uint64_t t3 = now();
+            for (int b = 0; b < BLOCKS; b++) {
+                for (int i = 0; i < BLOCK; i++) b32[i] = Biquad_TickQ31(&q31t, input[i]);
+            }
+            uint64_t t4 = now();
+            uint64_t t[4] = { t1 - t0, t2 - t1, t3 - t2, t4 - t3 };
+            for (int k = 0; k < 4; k++) if (t[k] < best[k]) best[k] = t[k];
+        }
+
+        const double n = (double) BLOCKS * BLOCK * sections;
+        printf("  %u section(s): Q15 block %.2f  Q15 tick %.2f  Q31 block %.2f  Q31 tick %.2f\n",
+               sections, best[0] / n, best[1] / n, best[2] / n, best[3] / n);
+
+        // Both paths have seen the same samples: their states must agree
+        for (unsigned s = 0; s < sections; s++) {
+            if (memcmp(&q15.s[s], &q15t.s[s], sizeof(q15.s[s])) != 0
+                || memcmp(&q31.s[s], &q31t.s[s], sizeof(q31.s[s])) != 0) {
+                printf("  ERROR: block and per-sample results differ\n");
+                errors++;
+            }
+        }
+    }
+
+    // Worst case of every preset: input and state at full scale with the
+    // signs of the coefficients, so the five products add up (about 7 x
+    // 2^29 for the high-pass and shelf sections, past a 32 bit accumulator)
+    static const uint32_t rates[2] = { 22050, 44100 };
+    unsigned checked = 0;
+    for (unsigned r = 0; r < 2; r++) {
+        for (unsigned p = 0; p < BIQUAD_PRESETS; p++) {
+            Biquad_Q15_t tick, block;
+            Biquad_InitQ15(&tick);
+            Biquad_AddSectionQ15(&tick, Biquad_GetPreset(p, rates[r]));
+            Biquad_SectionQ15_t *s = &tick.s[0];
+#define FULL(c) ((c) < 0 ? -32767 : 32767)
+            int16_t x = FULL(s->b0);
+            s->x1 = FULL(s->b1); s->x2 = FULL(s->b2);
+            s->y1 = FULL(s->a1); s->y2 = FULL(s->a2);
+#undef FULL
+            int64_t acc = (1 << 13) + (int64_t) s->b0 * x + (int64_t) s->b1 * s->x1
+                        + (int64_t) s->b2 * s->x2 + (int64_t) s->a1 * s->y1 + (int64_t) s->a2 * s->y2;
+            int32_t ref = (int32_t) (acc >> 14) > INT16_MAX ? INT16_MAX
+                        : (int32_t) (acc >> 14) < INT16_MIN ? INT16_MIN : (int32_t) (acc >> 14);
+            block = tick;
+            int16_t yb = x;
+            Biquad_ProcessQ15(&block, &yb, 1);
+            int16_t y = Biquad_TickQ15(&tick, x);
+            if (y != ref || yb != ref) {
+                printf("  ERROR: preset %u at %u Hz at full scale: tick %d block %d instead of %d\n", p,
+                       (unsigned) rates[r], y, yb, (int) ref);
+                errors++;
+            }
+            checked++;
+        }
+    }
+    printf("  %u presets at full scale without overflow\n", checked);
+    return errors;
+}
+
+/*
+ * Requantizer: cost per sample and the noise left below 4 kHz (two low-pass
+ * sections at 22050 Hz) for a 1 kHz sine at -6 dBFS.
+ */
+static int bench_requant(void) {
+    static const struct { unsigned mode; const char *name; } modes[] = {
+        { REQUANT_TRUNCATE,               "truncate      " },
+        { REQUANT_DITHER,                 "tpdf          " },
+        { REQUANT_SHAPE1,                 "shape1        " },
+        { REQUANT_DITHER|REQUANT_SHAPE1,  "tpdf + shape1 " },
+        { REQUANT_DITHER|REQUANT_SHAPE2,  "tpdf + shape2 " },
+    };
+    static const unsigned bits[] = { 7, 12 };
+    enum { N = 22050 };
+    static int16_t x[N];
+    static uint16_t y[N];
+    static int32_t e[N];
+
+    for (int i = 0; i < N; i++) {
+        x[i] = (int16_t) lrint(16384.0 * sin(2.0 * 3.14159265358979 * 1000.0 * i / 22050.0));
+    }
+
+    printf("Requantizer (%s per sample, noise in dBFS)\n", UNIT);
+    for (unsigned b = 0; b < sizeof(bits) / sizeof(bits[0]); b++) {
+        for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            Requant_t r;
+            uint64_t best = UINT64_MAX;
+            for (int run = 0; run < RUNS; run++) {
+                Requant_Init(&r, bits[b], modes[m].mode);
+                uint64_t t0 = now();
+                Requant_ProcessBlock(&r, x, y, N);
+                uint64_t t = now() - t0;
+                if (t < best) best = t;
+            }
+
+            // Error of the reconstructed output, total and below 4 kHz
+            Biquad_Q31_t lp;
+            Biquad_InitQ31(&lp);
+            Biquad_AddSectionQ31(&lp, Biquad_GetPreset(BIQUAD_LP_4K, 22050));
+            Biquad_AddSectionQ31(&lp, Biquad_GetPreset(BIQUAD_LP_4K, 22050));
+            const unsigned shift = 16 - bits[b];
+            // Truncation is biased by half a step; leave the bias out
+            const int32_t bias = modes[m].mode == REQUANT_TRUNCATE ? (1 << shift) / 2 : 0;
+            double total = 0, band = 0;
+            for (int i = 0; i < N; i++) {
+                e[i] = ((int32_t) y[i] << shift) - 32768 + bias - x[i];
+                total += (double) e[i] * e[i];
+            }
+            Biquad_ProcessQ31(&lp, e, N);
+            for (int i = N / 10; i < N; i++) band += (double) e[i] * e[i];
+            printf("  %2u bits %s %6.2f   total %6.1f   below 4 kHz %6.1f\n",
+                   bits[b], modes[m].name, (double) best / N,
+                   10 * log10(total / N / (32768.0 * 32768.0) + 1e-20),
+                   10 * log10(band / (N - N / 10) / (32768.0 * 32768.0) + 1e-20));
+        }
+    }
+    return 0;
+}
+
+// Amplitude of frequency f in x (Goertzel), relative to full scale
+static double tone_level(const int16_t *x, int n, double f, double rate) {
+    double w = 2.0 * 3.14159265358979 * f / rate;
+    double c = 2.0 * cos(w), s1 = 0, s2 = 0;
+    for (int i = 0; i < n; i++) {
+        double s0 = x[i] + c * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double p = s1 * s1 + s2 * s2 - c * s1 * s2;
+    return 2.0 * sqrt(p > 0 ? p : 0) / n / 32768.0;
+}
+
+/*
+ * Halfband 2x interpolator: cost per input sample (two outputs) and image
+ * rejection. A tone at f (22050 Hz) leaves an image at 22050-f (44100 Hz).
+ */
+static int bench_upsample(void) {
+    enum { N = 22050 };                 // 1 s: whole number of cycles
+    static const double tones[] = { 1000, 4000, 6000, 8000, 10000 };
+    static int16_t x[N];
+    static int16_t y[2 * N];
+    Upsample_t u;
+
+    printf("Halfband 2x interpolator\n");
+    for (unsigned t = 0; t < sizeof(tones) / sizeof(tones[0]); t++) {
+        for (int i = 0; i < N; i++) {
+            x[i] = (int16_t) lrint(16384.0 * sin(2.0 * 3.14159265358979 * tones[t] * i / 22050.0));
+        }
+        uint64_t best = UINT64_MAX;
+        for (int run = 0; run < RUNS; run++) {
+            Upsample_Init(&u);
+            uint64_t t0 = now();
+            Upsample_ProcessBlock(&u, x, y, N);
+            uint64_t dt = now() - t0;
+            if (dt < best) best = dt;
+        }
+        double signal = tone_level(y, 2 * N, tones[t], 44100.0);
+        double image = tone_level(y, 2 * N, 22050.0 - tones[t], 44100.0);
+        printf("  %5.0f Hz: %.2f %s per input sample, gain %+.2f dB, image %6.1f dB\n",
+               tones[t], (double) best / N, UNIT, 20 * log10(signal / 0.5),
+               20 * log10(image / signal + 1e-12));
+    }
+    return 0;
+}
+
+static void discard(const int16_t *frames, uint32_t n, void *arg) {
+    (void) frames;
+    *(uint32_t *) arg += n;
+}
+
+/*
+ * Output switch with the audio interrupt running: the interrupt is
+ * simulated by parking or resuming from the init of the new backend, the
+ * long part of Output_Select. The backend must end up started exactly
+ * when the engine is awake.
+ */
+static int switch_event;                // 0 none, 1 park, 2 park then resume
+static int switch_started;
+
+static int switch_init(unsigned rate) {
+    (void) rate;
+    if (switch_event >= 1) Output_Park();
+    if (switch_event == 2) Output_Resume();
+    return 0;
+}
+static void switch_start(void) { switch_started = 1; }
+static void switch_stop(void) { switch_started = 0; }
+static void switch_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+    (void) left; (void) right; (void) n;
+}
+static uint32_t switch_latency(void) { return 0; }
+
+static const Output_Backend_t switch_backend = {
+    .name = "TEST", .channels = 2, .init = switch_init, .start = switch_start,
+    .submit = switch_submit, .stop = switch_stop, .latency = switch_latency
+};
+
+static int check_switch(void) {
+    int errors = 0;
+
+    for (switch_event = 0; switch_event <= 2; switch_event++) {
+        int awake = switch_event != 1;
+        switch_started = 0;
+        Output_Select(&switch_backend, 44100);
+        if (switch_started != awake || (Output_Get() == &switch_backend) != awake) {
+            printf("  ERROR: switch with event %d: started %d\n", switch_event, switch_started);
+            errors++;
+        }
+        Output_Resume();        // Wakes up
+        if (!switch_started || Output_Get() != &switch_backend) {
+            printf("  ERROR: switch with event %d: silent after the wake up\n", switch_event);
+            errors++;
+        }
+        Output_Stop();
+    }
+    return errors;
+}
+
+/*
+ * Output backends: the conversion kernel of each kind of output and the
+ * submit path of the host backends, one sample per call as in the audio
+ * interrupt and in blocks. The kernels must agree with Requant_Process.
+ */
+static int bench_output(void) {
+    enum { N = 4096 };
+    static int32_t noise[2 * N];
+    static int16_t left[N], right[N];
+    static uint16_t code[2 * N], ref[N];
+    static uint32_t word[N];
+    uint64_t best[6] = { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX };
+    Requant_t rl, rr;
+    int errors = 0;
+
+    fill_noise(noise, 2 * N, 20000);
+    for (int i = 0; i < N; i++) {
+        left[i] = (int16_t) noise[2 * i];
+        right[i] = (int16_t) noise[2 * i + 1];
+    }
+
+    printf("Output conversion kernels (%s per sample)\n", UNIT);
+    for (int run = 0; run < RUNS; run++) {
+        uint64_t t[6];
+        Requant_Init(&rl, 12, OUTPUT_REQUANT);
+        Requant_Init(&rr, 12, OUTPUT_REQUANT);
+        t[0] = now();
+        Output_ConvertDAC(&rl, &rr, left, 0, word, N);
+        t[1] = now();
+        Output_ConvertDAC(&rl, &rr, left, right, word, N);
+        t[2] = now();
+        Requant_Init(&rl, 7, OUTPUT_REQUANT);
+        Output_ConvertPWM(&rl, left, code, N);
+        t[3] = now();
+        Requant_Init(&rl, 14, OUTPUT_REQUANT);
+        Output_ConvertDualPWM(&rl, left, word, 7, N);
+        t[4] = now();
+        Output_ConvertI2S(left, right, code, N);
+        t[5] = now();
+        for (int k = 0; k < 5; k++) if (t[k + 1] - t[k] < best[k]) best[k] = t[k + 1] - t[k];
+    }
+    printf("  DAC mono %.2f  DAC stereo %.2f  PWM %.2f  dual PWM %.2f  I2S %.2f\n",
+           (double) best[0] / N, (double) best[1] / N, (double) best[2] / N,
+           (double) best[3] / N, (double) best[4] / N);
+
+    // Dual PWM halves put back together, and I2S words in bus order
+    Requant_Init(&rl, 14, OUTPUT_REQUANT);
+    Requant_ProcessBlock(&rl, left, ref, N);
+    Requant_Init(&rl, 14, OUTPUT_REQUANT);
+    Output_ConvertDualPWM(&rl, left, word, 7, N);
+    for (int i = 0; i < N; i++) {
+        if (((word[i] & 0xFFFF) << 7 | word[i] >> 16) != ref[i]) {
+            printf("  ERROR: dual PWM code differs at %d\n", i);
+            errors++;
+            break;
+        }
+        if (code[2 * i] != (uint16_t) left[i] || code[2 * i + 1] != (uint16_t) right[i]) {
+            printf("  ERROR: I2S frame differs at %d\n", i);
+            errors++;
+            break;
+        }
+    }
+
+    // Submit through the host backends
+    static const Output_Backend_t *const sinks[] = { &Output_Null, &Output_File };
+    uint32_t written = 0;
+    Output_SetFileWriter(discard, &written, 2);
+    printf("Output backends (%s per sample)\n", UNIT);
+    for (unsigned s = 0; s < sizeof(sinks) / sizeof(sinks[0]); s++) {
+        if (Output_Select(sinks[s], 44100) < 0) {
+            printf("  ERROR: %s does not start\n", sinks[s]->name);
+            errors++;
+            continue;
+        }
+        best[0] = best[1] = UINT64_MAX;
+        for (int run = 0; run < RUNS; run++) {
+            uint64_t t0 = now();
+            for (int i = 0; i < N; i++) Output_Submit(&left[i], &right[i], 1);
+            uint64_t t1 = now();
+            for (int i = 0; i < N; i += BLOCK) Output_Submit(&left[i], &right[i], BLOCK);
+            uint64_t t2 = now();
+            if (t1 - t0 < best[0]) best[0] = t1 - t0;
+            if (t2 - t1 < best[1]) best[1] = t2 - t1;
+        }
+        printf("  %-4s one per call %.2f  blocks of %d %.2f  latency %u\n", sinks[s]->name,
+               (double) best[0] / N, BLOCK, (double) best[1] / N, (unsigned) Output_GetLatency());
+    }
+    Output_Stop();
+    if (written != 2u * RUNS * N) {
+        printf("  ERROR: file sink wrote %u of %u frames\n", (unsigned) written, 2u * RUNS * N);
+        errors++;
+    }
+    errors += check_switch();
+    return errors;
+}
+
+/*
+ * Render-ahead FIFO: cost of the pop done by the output interrupt and of
+ * the push of a block, and the statistics for a producer that stalls.
+ */
+static int bench_fifo(void) {
+    enum { N = 1 << 16, BLK = 64 };
+    static int32_t noise[2 * BLK];
+    static int16_t left[BLK], right[BLK];
+    static AudioFifo_t fifo;
+    AudioFifo_Stats_t st;
+    uint64_t push = 0, pop = 0;
+    uint32_t popped = 0, pos = 0;
+    int errors = 0;
+
+    fill_noise(noise, 2 * BLK, 30000);
+    for (int i = 0; i < BLK; i++) {
+        left[i] = (int16_t) noise[2 * i];
+        right[i] = (int16_t) noise[2 * i + 1];
+    }
+    AudioFifo_Init(&fifo);
+
+    // Refill whenever a block fits, except during a stall of 300 frames
+    for (uint32_t t = 0; t < N; t++) {
+        if ((t < 20000 || t >= 20300) && AudioFifo_GetDemand(&fifo) >= BLK) {
+            uint64_t t0 = now();
+            AudioFifo_Push(&fifo, left, right, BLK);
+            push += now() - t0;
+        }
+        int16_t l, r;
+        uint64_t t0 = now();
+        int ok = AudioFifo_Pop(&fifo, &l, &r);
+        pop += now() - t0;
+        if (ok) {
+            if (l != left[pos] || r != right[pos]) errors++;
+            pos = (pos + 1) % BLK;
+            popped++;
+        }
+    }
+    AudioFifo_GetStats(&fifo, &st);
+    printf("Render-ahead FIFO (%s per frame), %u frames\n", UNIT, AUDIOFIFO_FRAMES);
+    printf("  pop %.2f  push %.2f  fill %u  high %u  low %u  underruns %u\n",
+           (double) pop / N, (double) push / popped, (unsigned) st.fill,
+           (unsigned) st.high, (unsigned) st.low, (unsigned) st.underruns);
+    if (errors) printf("  ERROR: %d frames differ\n", errors);
+    // The stall is longer than the FIFO: every missing frame is an underrun
+    if (st.underruns != N - popped || st.underruns == 0) {
+        printf("  ERROR: %u underruns counted, %u frames missing\n",
+               (unsigned) st.underruns, (unsigned) (N - popped));
+        errors++;
+    }
+    return errors;
+}
+
+/*
+ * Voice budget on a cost model of the mixer: a fixed part and a part per
+ * voice, with the effects switched on for a while and a quiet passage at
+ * the end. The limit must follow the load down without overloads and come
+ * back to the top when the load falls.
+ */
+static int bench_budget(void) {
+    enum { PERIOD = 48000000 / 22050 * 32, FIXED = 3000, VOICE = 4500, FX = 15000, MAX = 20 };
+    const VoiceBudget_Config_t config = { VOICEBUDGET_HIGH, VOICEBUDGET_LOW, VOICEBUDGET_HOLD,
+                                          VOICEBUDGET_MIN, MAX };
+    static VoiceBudget_t vb;
+    VoiceBudget_Stats_t st;
+    unsigned limit, fx_limit = MAX, over = 0, overloads = 0;
+    uint64_t cost = 0;
+    int errors = 0;
+
+    VoiceBudget_Init(&vb, PERIOD, &config);
+    limit = vb.stats.limit;
+    for (int b = 0; b < 6000; b++) {
+        unsigned wanted = b < 4000 ? 12 : 2;
+        int fx = b >= 1500 && b < 3000;
+        unsigned voices = wanted < limit ? wanted : limit;
+        uint32_t cycles = FIXED + VOICE * voices + (fx ? FX : 0);
+        unsigned before = limit;
+        uint64_t t0 = now();
+        limit = VoiceBudget_Update(&vb, cycles, voices);
+        cost += now() - t0;
+        // A block over high must be the one that lowers the limit
+        if (cycles * VOICEBUDGET_ONE > (uint32_t) VOICEBUDGET_HIGH * PERIOD && limit == before) over++;
+        if (cycles > PERIOD) overloads++;
+        if (fx && limit < fx_limit) fx_limit = limit;
+    }
+    VoiceBudget_GetStats(&vb, &st);
+    printf("Voice budget (%s per block)\n", UNIT);
+    printf("  update %.2f  limit with effects %u, at the end %u  lowered %u  raised %u  load max %u/%u\n",
+           (double) cost / 6000, fx_limit, (unsigned) st.limit, (unsigned) st.lowered,
+           (unsigned) st.raised, (unsigned) st.load_max, VOICEBUDGET_ONE);
+    if (over || overloads || st.overloads) {
+        printf("  ERROR: %u blocks over high kept the limit, %u overloads\n", over, overloads);
+        errors++;
+    }
+    if (fx_limit >= 12 || st.limit != MAX) {
+        printf("  ERROR: the limit did not follow the load\n");
+        errors++;
+    }
+    return errors;
+}
+
+/*
+ * Mixer: cost of a block of the player with the loop over the playing
+ * voices and in constant time (every channel), with the spread between the
+ * cheapest and the dearest block. Each block is timed as the best of
+ * MIX_RUNS, which keeps most of the host noise out of the spread. Both
+ * must give the same samples. The spread is only printed: in constant time
+ * only the blocks with a step cost more (every instrument is started), but
+ * wall clock time on a host is too noisy to fail on. The cycles on the
+ * board are in render_cycles_max.
+ */
+enum { MIX_RATE = 22050, MIX_BLOCK = 32, MIX_BLOCKS = 4 * MIX_RATE / MIX_BLOCK, MIX_RUNS = 25 };
+
+static void mix_run(int constant, int16_t *out, uint64_t *times) {
+    Player_Config_t config = { .sample_rate = MIX_RATE, .bpm = 200, .beats_per_bar = 4 };
+    Player_t *player = Player_GetInstance();
+
+    // One block first, so the host caches are warm from the first timed
+    // block (the Cortex-M3 has no data cache)
+    for (int warm = 1; warm >= 0; warm--) {
+        Player_Init(player, config);
+        Player_SetLimiter(player, 1);
+        Player_SetConstantTime(player, constant);
+        if (warm) Player_Render(player, out, 0, MIX_BLOCK);
+    }
+    for (int b = 0; b < MIX_BLOCKS; b++) {
+        uint64_t t0 = now();
+        Player_Render(player, &out[b * MIX_BLOCK], 0, MIX_BLOCK);
+        uint64_t t = now() - t0;
+        if (t < times[b]) times[b] = t;
+    }
+}
+
+static int bench_mixer(void) {
+    static int16_t out[2][MIX_BLOCKS * MIX_BLOCK];
+    static uint64_t times[2][MIX_BLOCKS];
+    static Master_t master;
+    int errors = 0;
+
+    if (SoundBank_Init(&soundbank, 0) < 0) {
+        printf("Mixer\n  ERROR: invalid sound bank\n");
+        return 1;
+    }
+    AttackCache_Init();
+
+    printf("Mixer (%s per block of %d samples, %d channels)\n", UNIT, MIX_BLOCK, CURRENT_SOUNDS_MAX);
+    const char *names[2] = { "playing voices", "constant time " };
+    for (int m = 0; m < 2; m++) {
+        for (int b = 0; b < MIX_BLOCKS; b++) times[m][b] = UINT64_MAX;
+        for (int r = 0; r < MIX_RUNS; r++) mix_run(m, out[m], times[m]);
+        uint64_t best = UINT64_MAX, worst = 0, total = 0;
+        for (int b = 0; b < MIX_BLOCKS; b++) {
+            if (times[m][b] < best) best = times[m][b];
+            if (times[m][b] > worst) worst = times[m][b];
+            total += times[m][b];
+        }
+        printf("  %s  min %6.0f  mean %6.0f  max %6.0f  max/min %.2f\n", names[m], (double) best,
+               (double) total / MIX_BLOCKS, (double) worst, (double) worst / best);
+    }
+    if (memcmp(out[0], out[1], sizeof(out[0]))) {
+        printf("  ERROR: constant time mixing gives other samples\n");
+        errors++;
+    }
+
+    // The soft clipper without branches, at every level
+    Master_Init(&master);
+    for (int32_t x = -200000; x <= 200000; x++) {
+        int16_t y = Master_SoftClip(&master, x);
+        if (Master_SoftClipFixed(&master, x) != y) {
+            printf("  ERROR: soft clipper without branches differs at %d\n", (int) x);
+            errors++;
+            break;
+        }
+    }
+    return errors;
+}
+
+/*
+ * Mixing kernels: the Cortex-M3 kernel (paired loads, unrolled) and, on
+ * x86, the SSE2 and AVX2 host kernels against the reference loop on random
+ * frames of every length and alignment of the tail, then the cost per
+ * frame of each. On the host the M3 kernel runs as C; the SXTH/ADD ASR
+ * sequence it is written for is the same arithmetic. All must be bit
+ * identical.
+ */
+enum { KERNEL_FRAMES = 4096 };
+
+typedef void (*Kernel_t)(int32_t *, const int16_t *, uint32_t);
+
+static const struct {
+    const char  *name;
+    Kernel_t    func;
+    unsigned    needs;          // MIXKERNEL_SSE2... (0 = none)
+} kernels[] = {
+    { "reference", MixKernel_AddRef,  0 },
+    { "fast     ", MixKernel_AddFast, 0 },
+#if MIXKERNEL_SIMD
+    { "sse2     ", MixKernel_AddSse2, MIXKERNEL_SSE2 },
+    { "avx2     ", MixKernel_AddAvx2, MIXKERNEL_AVX2 },
+#endif
+};
+#define KERNELS (int) (sizeof(kernels) / sizeof(kernels[0]))
+
+static int bench_kernel(void) {
+    static int32_t noise[2 * KERNEL_FRAMES];
+    static int16_t frames[2 * KERNEL_FRAMES] __attribute__((aligned(4)));
+    static int32_t acc[KERNELS][KERNEL_FRAMES];
+    unsigned features = 0;
+    int errors = 0;
+
+#if MIXKERNEL_SIMD
+    features = MixKernel_GetHostFeatures();
+#endif
+
+    fill_noise(noise, 2 * KERNEL_FRAMES, 32768);
+    for (int k = 0; k < 2 * KERNEL_FRAMES; k++) {
+        frames[k] = (int16_t) (noise[k] > INT16_MAX ? INT16_MAX : noise[k]);
+    }
+    // Full scale at the ends of the range
+    frames[0] = frames[1] = INT16_MIN;
+    frames[2] = frames[3] = INT16_MAX;
+
+    printf("Mixing kernel (%s per frame, %d frames per call)\n", UNIT, MIX_BLOCK);
+    for (int m = 1; m < KERNELS; m++) {
+        if ((features & kernels[m].needs) != kernels[m].needs) continue;
+        for (uint32_t n = 0; n <= 67; n++) {
+            for (uint32_t start = 0; start < 8; start++) {
+                for (uint32_t k = 0; k < n; k++) acc[0][k] = acc[m][k] = noise[k] << 8;
+                MixKernel_AddRef(acc[0], &frames[2 * start], n);
+                kernels[m].func(acc[m], &frames[2 * start], n);
+                if (memcmp(acc[0], acc[m], n * sizeof(int32_t))) {
+                    printf("  ERROR: %s differs, %u frames from frame %u\n", kernels[m].name,
+                           (unsigned) n, (unsigned) start);
+                    errors++;
+                }
+            }
+        }
+    }
+
+    double cost[KERNELS];
+    for (int m = 0; m < KERNELS; m++) {
+        if ((features & kernels[m].needs) != kernels[m].needs) {
+            printf("  %s not supported by this processor\n", kernels[m].name);
+            continue;
+        }
+        uint64_t best = UINT64_MAX;
+        for (int r = 0; r < RUNS; r++) {
+            memset(acc[m], 0, sizeof(acc[m]));
+            uint64_t t0 = now();
+            for (int rep = 0; rep < 16; rep++) {
+                for (int b = 0; b < KERNEL_FRAMES; b += MIX_BLOCK) {
+                    kernels[m].func(&acc[m][b], &frames[2 * b], MIX_BLOCK);
+                }
+            }
+            uint64_t t = now() - t0;
+            if (t < best) best = t;
+        }
+        cost[m] = (double) best / (16.0 * KERNEL_FRAMES);
+        printf("  %s %6.2f  speedup %5.2f\n", kernels[m].name, cost[m], cost[0] / cost[m]);
+        if (memcmp(acc[0], acc[m], sizeof(acc[0]))) {
+            printf("  ERROR: %s differs on the long run\n", kernels[m].name);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/*
+ * Block rendering: Player_Render (voices mixed a run at a time by the
+ * kernel) against Player_TickStereo and Player_Tick sample by sample, with
+ * pan, a bus filter and a send on, and plain mono. Same samples expected.
+ */
+static void render_run(int block, int stereo, int16_t *l, int16_t *r, uint64_t *best) {
+    Player_Config_t config = { .sample_rate = MIX_RATE, .bpm = 200, .beats_per_bar = 4 };
+    Player_t *player = Player_GetInstance();
+
+    Player_Init(player, config);
+    Player_SetLimiter(player, 1);
+    if (stereo) {
+        Player_SetPan(player, PLAYER_SNARE, -12);
+        Player_SetPan(player, PLAYER_HIHAT, 20);
+        Player_AddFilter(player, PLAYER_KICK, 0);
+        Player_SetSend(player, PLAYER_SNARE, PLAYER_REVERB, PLAYER_SEND_UNITY / 4);
+    }
+    uint64_t t0 = now();
+    for (int b = 0; b < MIX_BLOCKS; b++) {
+        int16_t *lb = &l[b * MIX_BLOCK], *rb = stereo ? &r[b * MIX_BLOCK] : 0;
+        if (block) {
+            Player_Render(player, lb, rb, MIX_BLOCK);
+        } else if (stereo) {
+            for (int k = 0; k < MIX_BLOCK; k++) Player_TickStereo(player, &lb[k], &rb[k]);
+        } else {
+            for (int k = 0; k < MIX_BLOCK; k++) lb[k] = Player_Tick(player);
+        }
+    }
+    uint64_t t = now() - t0;
+    if (t < *best) *best = t;
+}
+
+static int bench_render(void) {
+    static int16_t out[2][2][MIX_BLOCKS * MIX_BLOCK];
+    int errors = 0;
+
+#if MIXKERNEL_SIMD
+    static const int16_t silent[2] = { 0, 0 };
+    int32_t probe = 0;
+    MixKernel_AddHost(&probe, silent, 1);   // Picks the host kernel
+    printf("Block rendering (%s per block of %d samples, %s kernel)\n", UNIT, MIX_BLOCK,
+           MixKernel_GetHostName());
+#else
+    printf("Block rendering (%s per block of %d samples)\n", UNIT, MIX_BLOCK);
+#endif
+    const char *names[2] = { "mono  ", "stereo" };
+    for (int stereo = 0; stereo < 2; stereo++) {
+        uint64_t best[2] = { UINT64_MAX, UINT64_MAX };
+        for (int r = 0; r < RUNS; r++) {
+            for (int block = 0; block < 2; block++) {
+                render_run(block, stereo, out[block][0], out[block][1], &best[block]);
+            }
+        }
+        printf("  %s  per sample %6.0f  block %6.0f  speedup %.2f\n", names[stereo],
+               (double) best[0] / MIX_BLOCKS, (double) best[1] / MIX_BLOCKS,
+               (double) best[0] / best[1]);
+        if (memcmp(out[0][0], out[1][0], sizeof(out[0][0]))
+            || (stereo && memcmp(out[0][1], out[1][1], sizeof(out[0][1])))) {
+            printf("  ERROR: block rendering gives other samples (%s)\n", names[stereo]);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/*
+ * Premixed loop: the player with the loop buffer (PREMIX_BYTES, set by the
+ * Makefile for the benchmark) against live mixing, with a stop and a
+ * restart in the middle of a loop. The samples must be the same, and the
+ * buffer must really play before and after the restart.
+ */
+enum { PREMIX_BLOCKS = 8 * 16 * (MIX_RATE * 15 / 200) / MIX_BLOCK, PREMIX_STOP = 3000 };
+
+static void premix_run(int premix, int16_t *out, uint8_t *voices) {
+    Player_Config_t config = { .sample_rate = MIX_RATE, .bpm = 200, .beats_per_bar = 4 };
+    Player_t *player = Player_GetInstance();
+
+    Player_Init(player, config);
+    Player_SetLimiter(player, 1);
+    Player_SetPremix(player, premix);
+    for (int b = 0; b < PREMIX_BLOCKS; b++) {
+        if (b == PREMIX_STOP) {
+            Player_Stop(player);
+            Player_Resume(player);
+        }
+        Player_Render(player, &out[b * MIX_BLOCK], 0, MIX_BLOCK);
+        voices[b] = Player_GetVoices(player);
+        Player_Background(player);
+    }
+}
+
+static int bench_premix(void) {
+    static int16_t out[2][PREMIX_BLOCKS * MIX_BLOCK];
+    static uint8_t voices[2][PREMIX_BLOCKS];
+    int errors = 0;
+
+    printf("Premixed loop (%u KB)\n", (unsigned) (Premix_GetCapacity() * sizeof(int16_t) / 1024));
+    if (Premix_GetCapacity() == 0) {
+        printf("  ERROR: built without PREMIX_BYTES\n");
+        return 1;
+    }
+    premix_run(0, out[0], voices[0]);
+    premix_run(1, out[1], voices[1]);
+
+    // Blocks where the live mixer had voices and the buffer played instead
+    int before = 0, after = 0;
+    for (int b = 0; b < PREMIX_BLOCKS; b++) {
+        if (voices[0][b] && !voices[1][b]) {
+            if (b < PREMIX_STOP) before++;
+            else after++;
+        }
+    }
+    printf("  blocks from the buffer: %d before the stop, %d after\n", before, after);
+    if (!before || !after) {
+        printf("  ERROR: the premixed loop did not play\n");
+        errors++;
+    }
+    for (int k = 0; k < PREMIX_BLOCKS * MIX_BLOCK; k++) {
+        if (out[0][k] != out[1][k]) {
+            printf("  ERROR: sample %d is %d, live mixing gives %d\n", k, out[1][k], out[0][k]);
+            errors++;
+            break;
+        }
+    }
+    return errors;
+}
+
+/*
+ * Step edits: Player_ToggleStep while the premixed loop plays (a snare
+ * added to an empty step, a kick taken off a step that had it). The loop
+ * is patched in place. Against live mixing with the same edits the
+ * samples must be the same, and once settled the patched loop must play
+ * as a loop rendered fresh with the edited pattern. The limiter is off so
+ * that only the buffer tells the last runs apart.
+ */
+enum { EDIT_AT = 2900, EDIT2_AT = 2950, LOOP_BLOCKS = 16 * (MIX_RATE * 15 / 200) / MIX_BLOCK };
+
+static void edit_run(int premix, int edit_at, int16_t *out, uint8_t *voices) {
+    Player_Config_t config = { .sample_rate = MIX_RATE, .bpm = 200, .beats_per_bar = 4 };
+    Player_t *player = Player_GetInstance();
+
+    Player_Init(player, config);
+    Player_SetPremix(player, premix);
+    for (int b = 0; b < PREMIX_BLOCKS; b++) {
+        if (b == edit_at) Player_ToggleStep(player, 2, PLAYER_SNARE);
+        if (b == edit_at + (EDIT2_AT - EDIT_AT)) Player_ToggleStep(player, 0, PLAYER_KICK);
+        Player_Render(player, &out[b * MIX_BLOCK], 0, MIX_BLOCK);
+        voices[b] = Player_GetVoices(player);
+        Player_Background(player);
+    }
+}
+
+static int bench_edit(void) {
+    static int16_t out[3][PREMIX_BLOCKS * MIX_BLOCK];
+    static uint8_t voices[3][PREMIX_BLOCKS];
+    int errors = 0;
+
+    edit_run(0, EDIT_AT, out[0], voices[0]);   // Live
+    edit_run(1, EDIT_AT, out[1], voices[1]);   // Patched
+    edit_run(1, 0, out[2], voices[2]);         // Edited before the first render
+
+    int patched = 0;
+    for (int b = EDIT2_AT; b < PREMIX_BLOCKS; b++) {
+        if (voices[0][b] && !voices[1][b]) patched++;
+    }
+    printf("Step edits on the premixed loop\n  blocks from the patched buffer: %d\n", patched);
+    if (!patched) {
+        printf("  ERROR: the patched loop did not play\n");
+        errors++;
+    }
+    for (int k = 0; k < PREMIX_BLOCKS * MIX_BLOCK; k++) {
+        if (out[0][k] != out[1][k]) {
+            printf("  ERROR: sample %d is %d, live mixing gives %d\n", k, out[1][k], out[0][k]);
+            errors++;
+            break;
+        }
+    }
+    for (int k = (PREMIX_BLOCKS - 2 * LOOP_BLOCKS) * MIX_BLOCK; k < PREMIX_BLOCKS * MIX_BLOCK; k++) {
+        if (out[1][k] != out[2][k]) {
+            printf("  ERROR: sample %d is %d, a fresh render gives %d\n", k, out[1][k], out[2][k]);
+            errors++;
+            break;
+        }
+    }
+    return errors;
+}
+
+/*
+ * Loud blocks of the premixed loop: four kicks on top of each other push
+ * the bound over 16 bits, so those blocks are read from the 32 bit slots.
+ * Premix_Read must give the exact sum after the render and after patches,
+ * and a loop with more loud blocks than slots must be refused.
+ */
+static int check_reads(const Premix_t *premix, const char *when) {
+    for (uint32_t pos = 0; pos < premix->length; pos++) {
+        if (Premix_Read(premix, pos) != Premix_Sum(premix, pos)) {
+            printf("  ERROR: %s, sample %u is %d instead of %d\n", when, (unsigned) pos,
+                   (int) Premix_Read(premix, pos), (int) Premix_Sum(premix, pos));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static unsigned count_wide(const Premix_t *premix) {
+    unsigned wide = 0;
+    for (uint32_t b = 0; b <= (premix->length - 1) / PREMIX_BLOCK; b++) wide += premix->wide_of[b] != PREMIX_NARROW;
+    return wide;
+}
+
+static int bench_wide(void) {
+    static Premix_t premix;
+    const uint32_t length = 8192;
+    uint32_t kick_length;
+    const int16_t *kick = SoundBank_GetSound(SOUNDBANK_KICK, &kick_length);
+    int errors = 0;
+
+    Premix_Reset(&premix, length);
+    for (int i = 0; i < 2; i++) Premix_AddHit(&premix, 100, SOUNDBANK_KICK, kick, kick_length, 0, i);
+    Premix_AddHit(&premix, length - 50, SOUNDBANK_KICK, kick, kick_length, 1, 0);   // Wraps
+    int done;
+    while ((done = Premix_Render(&premix, 1024)) == 0) {}
+    printf("Loud blocks of the premixed loop\n  %u of %u blocks in 32 bits (%d slots)\n", count_wide(&premix),
+           (unsigned) ((length - 1) / PREMIX_BLOCK + 1), PREMIX_WIDE_BLOCKS);
+    if (done != 1 || !count_wide(&premix)) {
+        printf("  ERROR: render %d with %u loud blocks\n", done, count_wide(&premix));
+        errors++;
+    }
+    errors += check_reads(&premix, "after the render");
+    Premix_PatchRemove(&premix, 0);
+    errors += check_reads(&premix, "after a removal");
+    if (Premix_PatchAdd(&premix, 2000, SOUNDBANK_KICK, kick, kick_length, 2, 0) < 0
+        || Premix_PatchAdd(&premix, 2000, SOUNDBANK_KICK, kick, kick_length, 2, 1) < 0
+        || Premix_PatchAdd(&premix, 2010, SOUNDBANK_KICK, kick, kick_length, 2, 2) < 0) {
+        printf("  ERROR: patch refused\n");
+        errors++;
+    }
+    errors += check_reads(&premix, "after additions");
+    printf("  %u after a removal and three additions\n", count_wide(&premix));
+
+    // Stacks of kicks all over the loop: more loud blocks than slots
+    Premix_Reset(&premix, length);
+    for (uint32_t start = 0; start + 512 <= length; start += 512) {
+        for (int i = 0; i < 4; i++) Premix_AddHit(&premix, start, SOUNDBANK_KICK, kick, kick_length, 0, i);
+    }
+    while ((done = Premix_Render(&premix, 1024)) == 0) {}
+    if (done != -1) {
+        printf("  ERROR: a loop with %u stacks was accepted\n", (unsigned) (length / 512));
+        errors++;
+    }
+    return errors;
+}
+
+int main(void) {
+    int errors = 0;
+
+    errors += bench_biquad();
+    errors += bench_requant();
+    errors += bench_upsample();
+    errors += bench_output();
+    errors += bench_fifo();
+    errors += bench_budget();
+    errors += bench_mixer();
+    errors += bench_kernel();
+    errors += bench_render();
+    errors += bench_premix();
+    errors += bench_edit();
+    errors += bench_wide();
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+# biquad_design.py
+#
+# Gera software/biquad_presets.h com os coeficientes das seções biquad
+# pré-calculadas (fórmulas do "Audio EQ Cookbook" de R. Bristow-Johnson).
+#
+# Uso: python3 scripts/biquad_design.py > software/biquad_presets.h
+#
+# A ordem de PRESETS deve ser a mesma do enum em software/biquad.h.
+import math
+
+SAMPLE_RATES = [22050, 44100]
+
+# (nome, tipo, frequência em Hz, Q, ganho em dB)
+PRESETS = [
+    ("LP_2K",           "lowpass",   2000, 0.7071,  0.0),
+    ("LP_4K",           "lowpass",   4000, 0.7071,  0.0),
+    ("LP_6K",           "lowpass",   6000, 0.7071,  0.0),
+    ("LP_8K",           "lowpass",   8000, 0.7071,  0.0),
+    ("HP_30",           "highpass",    30, 0.7071,  0.0),
+    ("HP_150",          "highpass",   150, 0.7071,  0.0),
+    ("PEAK_60_P6",      "peaking",     60, 1.0,     6.0),
+    ("PEAK_2K5_M6",     "peaking",   2500, 1.4,    -6.0),
+    ("LOWSHELF_120_P6", "lowshelf",   120, 0.7071,  6.0),
+    ("HIGHSHELF_6K_P6", "highshelf", 6000, 0.7071,  6.0),
+    ("HIGHSHELF_6K_M6", "highshelf", 6000, 0.7071, -6.0),
+]
+
+Q30 = 1 << 30
+
+
+def design(kind, fs, f0, q, gain_db):
+    """Retorna (b0, b1, b2, a1, a2) normalizados por a0."""
+    a = 10.0 ** (gain_db / 40.0)
+    w0 = 2.0 * math.pi * f0 / fs
+    cw, sw = math.cos(w0), math.sin(w0)
+    alpha = sw / (2.0 * q)
+
+    if kind == "lowpass":
+        b = [(1 - cw) / 2, 1 - cw, (1 - cw) / 2]
+        den = [1 + alpha, -2 * cw, 1 - alpha]
+    elif kind == "highpass":
+        b = [(1 + cw) / 2, -(1 + cw), (1 + cw) / 2]
+        den = [1 + alpha, -2 * cw, 1 - alpha]
+    elif kind == "peaking":
+        b = [1 + alpha * a, -2 * cw, 1 - alpha * a]
+        den = [1 + alpha / a, -2 * cw, 1 - alpha / a]
+    elif kind == "lowshelf":
+        s = 2 * math.sqrt(a) * alpha
+        b = [a * ((a + 1) - (a - 1) * cw + s),
+             2 * a * ((a - 1) - (a + 1) * cw),
+             a * ((a + 1) - (a - 1) * cw - s)]
+        den = [(a + 1) + (a - 1) * cw + s,
+               -2 * ((a - 1) + (a + 1) * cw),
+               (a + 1) + (a - 1) * cw - s]
+    elif kind == "highshelf":
+        s = 2 * math.sqrt(a) * alpha
+        b = [a * ((a + 1) + (a - 1) * cw + s),
+             -2 * a * ((a - 1) + (a + 1) * cw),
+             a * ((a + 1) + (a - 1) * cw - s)]
+        den = [(a + 1) - (a - 1) * cw + s,
+               2 * ((a - 1) - (a + 1) * cw),
+               (a + 1) - (a - 1) * cw - s]
+    else:
+        raise ValueError(kind)
+
+    a0 = den[0]
+    return [b[0] / a0, b[1] / a0, b[2] / a0, den[1] / a0, den[2] / a0]
+
+
+def to_q30(c):
+    v = int(round(c * Q30))
+    if not -(1 << 31) <= v < (1 << 31):
+        raise ValueError("coeficiente fora de Q30: %f" % c)
+    return v
+
+
+print("/** ***************************************************************************")
+print(" * @file    biquad_presets.h")
+print(" * @brief   Precomputed biquad sections (Q30)")
+print(" *")
+print(" * @note    Generated by scripts/biquad_design.py. Do not edit.")
+print(" *          Included by biquad.c only. a1 and a2 are stored negated.")
+print("******************************************************************************/")
+print("#ifndef BIQUAD_PRESETS_H")
+print("#define BIQUAD_PRESETS_H")
+print()
+for fs in SAMPLE_RATES:
+    print("static const Biquad_Coefs_t biquad_presets_%d[BIQUAD_PRESETS] = {" % fs)
+    for name, kind, f0, q, g in PRESETS:
+        b0, b1, b2, a1, a2 = design(kind, fs, f0, q, g)
+        c = [to_q30(b0), to_q30(b1), to_q30(b2), to_q30(-a1), to_q30(-a2)]
+        print("    [BIQUAD_%s] = { %s }," % (name, ", ".join("%11d" % v for v in c)))
+    print("};")
+    print()
+print("#endif // BIQUAD_PRESETS_H")
@@ -0,0 +1,198 @@
+/**
+ * @file    i2s_capture.c
+ * @brief   Host stand-in for the I2S output.
+ *
+ * Runs the player in stereo through the same conversion kernel and block
+ * ring as the firmware (Output_ConvertI2S, i2sring.c). The DMA is modelled
+ * as in i2s.c: two descriptors start with zero blocks and each finished
+ * block is replaced by I2SRing_Take. The words are serialized as the USART
+ * sends them (WS low for left, MSB first, data one bit after the WS edge),
+ * the bit stream is decoded back and compared with what was submitted.
+ *
+ * The engine stalls for a few blocks to force underruns and later writes a
+ * burst that does not fit, to check that frames are never split and that
+ * left stays on the left. The start of the bus is written to
+ * i2s_capture.vcd (BCLK, WS, SD) for a waveform viewer.
+ *
+ * Compile and run with 'make i2s-capture'.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "player.h"
+#include "soundbank.h"
+#include "attackcache.h"
+#include "output.h"
+#include "i2sring.h"
+
+extern const SoundBank_Header_t soundbank;
+
+#define RATE            44100
+#define FRAMES          (2*RATE)                // Engine ticks
+#define STALL_AT        (RATE/2)                // Engine stops for
+#define STALL_FRAMES    (3*I2SRING_FRAMES+7)    //   this many ticks
+#define BURST_AT        RATE                    // Extra frames written
+#define BURST_FRAMES    (3*I2SRING_FRAMES)
+#define BLOCKS_MAX      (FRAMES/I2SRING_FRAMES + 8)
+#define VCD_FRAMES      96
+
+static uint16_t sent[2*(FRAMES+BURST_FRAMES)];  // Words accepted by the ring
+static uint32_t sent_count = 0;
+
+static uint16_t bus[BLOCKS_MAX*I2SRING_WORDS];  // Words in the order sent
+static uint8_t  zero_block[BLOCKS_MAX];         // Block was i2sring_zero
+static uint32_t bus_blocks = 0;
+
+static uint8_t  ws[BLOCKS_MAX*I2SRING_WORDS*16+1];
+static uint8_t  sd[BLOCKS_MAX*I2SRING_WORDS*16+1];
+
+static I2SRing_t ring;
+
+// Engine side: one frame per tick, as Output_I2S does
+static void produce(int16_t left, int16_t right) {
+    uint16_t words[2];
+    Output_ConvertI2S(&left, &right, words, 1);
+    if (I2SRing_Write(&ring, words, 2) == 2) {
+        sent[sent_count++] = words[0];
+        sent[sent_count++] = words[1];
+    }
+}
+
+// DMA side: the block in the active descriptor has been sent
+static void dma_block(const uint16_t *block) {
+    memcpy(&bus[bus_blocks * I2SRING_WORDS], block, sizeof(uint16_t) * I2SRING_WORDS);
+    zero_block[bus_blocks] = block == i2sring_zero;
+    bus_blocks++;
+}
+
+// USART in I2S mode, W16D16, MSB first, one bit delay
+static uint32_t serialize(void) {
+    uint32_t words = bus_blocks * I2SRING_WORDS;
+    for (uint32_t w = 0; w < words; w++) {
+        for (int i = 0; i < 16; i++) {
+            ws[16 * w + i] = w & 1;
+            sd[16 * w + i + 1] = (bus[w] >> (15 - i)) & 1;
+        }
+    }
+    sd[0] = 0;
+    return 16 * words;
+}
+
+// Receiver: a word starts one bit after each WS edge
+static uint32_t deserialize(uint32_t slots, uint16_t *out) {
+    uint32_t n = 0;
+    for (uint32_t s = 0; s + 16 < slots + 1; s++) {
+        if (s == 0 || ws[s] != ws[s - 1]) {
+            uint16_t v = 0;
+            for (int i = 1; i <= 16; i++) v = (uint16_t) (v << 1 | sd[s + i]);
+            if ((n & 1) != ws[s]) return n;     // Lost the channel order
+            out[n++] = v;
+        }
+    }
+    return n;
+}
+
+static void write_vcd(const char *name, uint32_t slots) {
+    FILE *f = fopen(name, "w");
+    if (!f) return;
+    const unsigned half = 354;  // ns, bit clock of 32 x 44117.6 Hz
+    fprintf(f, "$timescale 1ns $end\n$scope module i2s $end\n"
+               "$var wire 1 c BCLK $end\n$var wire 1 w WS $end\n$var wire 1 d SD $end\n"
+               "$upscope $end\n$enddefinitions $end\n");
+    // Data and WS change on the falling edge, the codec samples on the rising one
+    for (uint32_t s = 0; s < slots; s++) {
+        fprintf(f, "#%u\n0c\n%uw\n%ud\n", (unsigned) (2 * s * half), ws[s], sd[s]);
+        fprintf(f, "#%u\n1c\n", (unsigned) ((2 * s + 1) * half));
+    }
+    fclose(f);
+}
+
+int main(void) {
+    static uint16_t rx[BLOCKS_MAX * I2SRING_WORDS];
+    int errors = 0;
+
+    if (SoundBank_Init(&soundbank, 0) < 0) {
+        fprintf(stderr, "Invalid sound bank\n");
+        return 1;
+    }
+    AttackCache_Init();
+    Player_Config_t config = { .sample_rate = RATE, .bpm = 120, .beats_per_bar = 4 };
+    Player_t *player = Player_GetInstance();
+    Player_Init(player, config);
+    Player_SetPan(player, PLAYER_SNARE, -PLAYER_PAN_MAX);
+    Player_SetPan(player, PLAYER_HIHAT, PLAYER_PAN_MAX / 2);
+
+    // I2S_Start: both descriptors armed with zeros
+    I2SRing_Reset(&ring);
+    const uint16_t *armed[2] = { i2sring_zero, i2sring_zero };
+    int active = 0;
+
+    for (uint32_t t = 0; t < FRAMES; t++) {
+        int16_t l, r;
+        if (t < STALL_AT || t >= STALL_AT + STALL_FRAMES) {
+            Player_TickStereo(player, &l, &r);
+            produce(l, r);
+        }
+        if (t == BURST_AT) {
+            for (int k = 0; k < BURST_FRAMES; k++) {
+                Player_TickStereo(player, &l, &r);
+                produce(l, r);
+            }
+        }
+        // One block leaves the bus every I2SRING_FRAMES frames
+        if ((t + 1) % I2SRING_FRAMES == 0) {
+            dma_block(armed[active]);
+            armed[active] = I2SRing_Take(&ring);
+            active ^= 1;
+        }
+    }
+
+    uint32_t slots = serialize();
+    uint32_t words = deserialize(slots, rx);
+    write_vcd("i2s_capture.vcd", VCD_FRAMES * 32);
+
+    printf("I2S stand-in: %u blocks of %d frames on the bus\n", (unsigned) bus_blocks, I2SRING_FRAMES);
+    if (words != bus_blocks * I2SRING_WORDS) {
+        printf("  ERROR: decoded %u of %u words\n", (unsigned) words, (unsigned) (bus_blocks * I2SRING_WORDS));
+        errors++;
+    }
+
+    // Zero blocks aside, the bus carries the accepted words in order
+    uint32_t next = 0, zeros = 0, stereo = 0;
+    for (uint32_t b = 0; b < bus_blocks && !errors; b++) {
+        const uint16_t *w = &rx[b * I2SRING_WORDS];
+        if (zero_block[b]) {
+            zeros++;
+            for (int k = 0; k < I2SRING_WORDS; k++) {
+                if (w[k]) { printf("  ERROR: zero block %u carries data\n", (unsigned) b); errors++; break; }
+            }
+            continue;
+        }
+        if (next + I2SRING_WORDS > sent_count || memcmp(w, &sent[next], sizeof(uint16_t) * I2SRING_WORDS)) {
+            printf("  ERROR: block %u differs from the submitted frames\n", (unsigned) b);
+            errors++;
+            break;
+        }
+        for (int k = 0; k < I2SRING_WORDS; k += 2) stereo += w[k] != w[k + 1];
+        next += I2SRING_WORDS;
+    }
+    if (stereo == 0) {
+        printf("  ERROR: left and right are equal, the pan did not reach the bus\n");
+        errors++;
+    }
+    // Two priming blocks, the rest must be the counted underruns
+    if (zeros != 2 + ring.underruns) {
+        printf("  ERROR: %u zero blocks, %u underruns counted\n", (unsigned) zeros, (unsigned) ring.underruns);
+        errors++;
+    }
+
+    printf("  frames submitted %u, sent %u, queued %u, dropped %u\n",
+           (unsigned) (sent_count / 2), (unsigned) (next / 2),
+           (unsigned) (I2SRing_GetQueued(&ring) / 2), (unsigned) (ring.dropped / 2));
+    printf("  underruns %u (stall of %d frames), frames with left != right %u\n",
+           (unsigned) ring.underruns, STALL_FRAMES, (unsigned) stereo);
+    printf("  %s, first %d frames in i2s_capture.vcd\n", errors ? "FAILED" : "OK", VCD_FRAMES);
+    return errors ? 1 : 0;
+}
@@ -9,6 +9,15 @@
 
 // Inclua os headers do seu projeto que são independentes de hardware
 #include "player.h"
+#include "soundbank.h"
+#include "attackcache.h"
+#include "output.h"
+
+// Amostras por chamada de Player_Render (RENDER_BLOCK em main.c)
+#define BLOCK 32
+
+// Imagem do banco de sons (sounds/soundbank.c), ligada junto no host
+extern const SoundBank_Header_t soundbank;
 
 // Função para escrever o cabeçalho de um arquivo WAV.
 // Um arquivo WAV precisa dessas informações no início para ser tocável.
@@ -42,9 +51,21 @@ void write_wav_header(FILE *f, int32_t sample_rate, int32_t frame_count) {
     fwrite(&subchunk2_size, 4, 1, f);
 }
 
+// Saída Output_File: grava os quadros no arquivo
+static void write_frames(const int16_t *frames, uint32_t n, void *arg) {
+    fwrite(frames, sizeof(int16_t), n, (FILE *) arg);
+}
+
 int main(void) {
     printf("Iniciando gerador de áudio para o host...\n");
 
+    if (SoundBank_Init(&soundbank, 0) < 0) {
+        fprintf(stderr, "Banco de sons inválido\n");
+        return 1;
+    }
+    AttackCache_Init();
+    printf("Cache de ataque: %u bytes\n", (unsigned) AttackCache_GetUsedBytes());
+
     // Configurações do Player
     Player_Config_t config = {
       .sample_rate = 44100,
@@ -53,6 +74,8 @@ int main(void) {
     };
     Player_t *player = Player_GetInstance();
     Player_Init(player, config);
+    Player_SetPremix(player, 1);
+    Player_SetLimiter(player, 1);
 
     // Configurações do arquivo de saída
     const int DURATION_SECONDS = 30;
@@ -68,16 +91,30 @@ int main(void) {
     // Escreve um cabeçalho WAV temporário (os tamanhos serão atualizados no final)
     write_wav_header(output_file, SAMPLE_RATE, FRAME_COUNT);
 
+    // Mesmo backend de saída do firmware, gravando em arquivo (mono)
+    Output_SetFileWriter(write_frames, output_file, 1);
+    if (Output_Select(&Output_File, SAMPLE_RATE) < 0) {
+        fprintf(stderr, "Saída em arquivo indisponível\n");
+        return 1;
+    }
+
     printf("Gerando %d segundos de áudio...\n", DURATION_SECONDS);
 
     // Loop principal para gerar as amostras de áudio
-    for (int i = 0; i < FRAME_COUNT; i++) {
-        // Pega a próxima amostra do player
-        int16_t sample = Player_Tick(player);
-        // Escreve a amostra no arquivo
-        fwrite(&sample, sizeof(int16_t), 1, output_file);
+    // Blocos como no firmware: as vozes passam pelo kernel de mixagem
+    // (SSE2/AVX2 no host), com as mesmas amostras de Player_Tick
+    for (int i = 0; i < FRAME_COUNT; i += BLOCK) {
+        int16_t block[BLOCK];
+        uint32_t n = (FRAME_COUNT - i < BLOCK) ? FRAME_COUNT - i : BLOCK;
+        // Próximas amostras do player
+        Player_Render(player, block, 0, n);
+        // Trabalho em segundo plano (laço principal no firmware)
+        Player_Background(player);
+        // Envia o bloco para a saída
+        Output_Submit(block, 0, n);
     }
     
+    Output_Stop(); // Grava o que ficou no buffer
     fclose(output_file);
 
     printf("Arquivo 'output.wav' gerado com sucesso!\n");
@@ -0,0 +1,186 @@
+/**
+ * @file    sched_sim.c
+ * @brief   Main loop scheduler on a virtual clock.
+ *
+ * Runs software/sched.c as the firmware main loop does: Sched_Run until
+ * nothing is released, then the clock moves to the next tick (the core
+ * sleeps). A task costs ticks by moving the clock forward; interrupts are
+ * modelled by signals at given times. The clock starts just before the
+ * 32 bit wrap around.
+ *
+ * Checks: no overrun under a light load, earliest deadline first among
+ * released tasks, a signal during a job, a job in slices, periods lost
+ * under overload counted as skipped, and the wait reported for sleeping.
+ *
+ * Compile and run with 'make sched-sim'.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sched.h"
+
+#define START           (UINT32_MAX - 5000)     // Wraps around in every test
+
+static uint32_t now;
+static Sched_t sched;
+static int errors = 0;
+static char order[64];                          // Names of the jobs, in order
+static unsigned order_len;
+
+static uint32_t clock_read(void) {
+    return now;
+}
+
+// A task: costs its ticks, optionally signals another one in the middle
+typedef struct {
+    char        tag;
+    uint32_t    cost;
+    int         signal;         // Task id to signal halfway once, -1 = none
+    int         slices;         // Returns 1 this many times per job
+    int         left;
+} Job_t;
+
+static int job(void *arg) {
+    Job_t *j = arg;
+    now += j->cost / 2;
+    if (j->signal >= 0) {
+        Sched_Signal(&sched, j->signal);
+        j->signal = -1;
+    }
+    now += j->cost - j->cost / 2;
+    if (order_len + 1 < sizeof(order)) order[order_len++] = j->tag;
+    if (j->slices) {
+        if (j->left == 0) j->left = j->slices;
+        if (--j->left) return 1;
+    }
+    return 0;
+}
+
+// Main loop until end; signals[] are raised by an "interrupt" at their time
+static void run(uint32_t ticks, const uint32_t *at, const int *ids, int n) {
+    uint32_t end = now + ticks;
+    int next = 0;
+    while ((int32_t) (now - end) < 0) {
+        while (next < n && (int32_t) (now - at[next]) >= 0) Sched_Signal(&sched, ids[next++]);
+        if (!Sched_Run(&sched)) now++;
+    }
+}
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        printf("  ERROR: %s\n", what);
+        errors++;
+    }
+}
+
+static void print_tasks(void) {
+    for (int i = 0; i < sched.count; i++) {
+        Sched_Task_t *t = &sched.tasks[i];
+        printf("    %-8s runs %6u overruns %5u skipped %5u exec max %4u response max %4u\n",
+               t->name, (unsigned) t->runs, (unsigned) t->overruns, (unsigned) t->skipped,
+               (unsigned) t->exec_max, (unsigned) t->response_max);
+    }
+}
+
+static void reset(void) {
+    now = START;
+    order_len = 0;
+    Sched_Init(&sched, clock_read);
+}
+
+int main(void) {
+    // Light load: utilization about 0.4, every deadline met
+    {
+        static Job_t a = { 'a', 2, -1, 0, 0 }, b = { 'b', 5, -1, 0, 0 }, e = { 'e', 1, -1, 0, 0 };
+        static uint32_t at[100];
+        static int ids[100];
+        reset();
+        Sched_AddPeriodic(&sched, "a", job, &a, 10, 10);
+        Sched_AddPeriodic(&sched, "b", job, &b, 25, 25);
+        int ie = Sched_AddEvent(&sched, "e", job, &e, 8);
+        for (int i = 0; i < 100; i++) { at[i] = START + 97 * i + 3; ids[i] = ie; }
+        run(10000, at, ids, 100);
+        printf("Light load, 10000 ticks\n");
+        print_tasks();
+        check(sched.tasks[0].runs == 1000 && sched.tasks[1].runs == 400, "periodic runs");
+        check(sched.tasks[2].runs == 100, "event runs");
+        for (int i = 0; i < 3; i++) check(sched.tasks[i].overruns == 0 && sched.tasks[i].skipped == 0,
+                                          "overrun under light load");
+        check(sched.tasks[2].response_max <= 1 + 5, "event waits at most one job");
+    }
+
+    // Earliest deadline first: added last, released last, runs first
+    {
+        static Job_t x = { 'x', 3, -1, 0, 0 }, y = { 'y', 3, -1, 0, 0 }, z = { 'z', 3, -1, 0, 0 };
+        reset();
+        int ix = Sched_AddEvent(&sched, "x", job, &x, 100);
+        int iy = Sched_AddEvent(&sched, "y", job, &y, 50);
+        int iz = Sched_AddEvent(&sched, "z", job, &z, 10);
+        Sched_Signal(&sched, ix);
+        now++;
+        Sched_Signal(&sched, iy);
+        now++;
+        Sched_Signal(&sched, iz);
+        run(100, 0, 0, 0);
+        order[order_len] = 0;
+        printf("Earliest deadline first: %s\n", order);
+        check(order_len == 3 && order[0] == 'z' && order[1] == 'y' && order[2] == 'x', "EDF order");
+    }
+
+    // A signal during a job, a job in slices
+    {
+        static Job_t s = { 's', 4, -1, 0, 0 }, p = { 'p', 2, -1, 3, 0 }, t = { 't', 2, -1, 0, 0 };
+        reset();
+        int is = Sched_AddEvent(&sched, "s", job, &s, 20);
+        int ip = Sched_AddEvent(&sched, "p", job, &p, 40);
+        int it = Sched_AddEvent(&sched, "t", job, &t, 5);
+        s.signal = is;                          // Releases itself again
+        Sched_Signal(&sched, ip);
+        uint32_t at[1] = { START + 3 };
+        int ids[1] = { it };
+        run(3, 0, 0, 0);                        // First slice of p
+        Sched_Signal(&sched, is);
+        run(100, at, ids, 1);
+        order[order_len] = 0;
+        printf("Signal during a job, job in slices: %s\n", order);
+        print_tasks();
+        check(sched.tasks[ip].runs == 1, "sliced job counted once");
+        check(sched.tasks[ip].exec_max == 2, "slice time");
+        check(sched.tasks[is].runs == 2, "signal during the job lost");
+        check(sched.tasks[it].response_max <= 2 + 4, "event waits at most one job");
+    }
+
+    // Overload: 30 ticks of work every 20
+    {
+        static Job_t h = { 'h', 30, -1, 0, 0 }, l = { 'l', 1, -1, 0, 0 };
+        reset();
+        Sched_AddPeriodic(&sched, "heavy", job, &h, 20, 20);
+        Sched_AddPeriodic(&sched, "light", job, &l, 50, 50);
+        run(3000, 0, 0, 0);
+        printf("Overload, 3000 ticks\n");
+        print_tasks();
+        check(sched.tasks[0].overruns > 0 && sched.tasks[0].skipped > 0, "overload not counted");
+        check(sched.tasks[0].runs + sched.tasks[0].skipped >= 3000 / 20 - 1, "releases lost");
+        check(sched.tasks[1].runs > 0, "light task starved");
+    }
+
+    // Wait for the sleep decision
+    {
+        static Job_t a = { 'a', 1, -1, 0, 0 }, e = { 'e', 1, -1, 0, 0 };
+        reset();
+        Sched_AddPeriodic(&sched, "a", job, &a, 100, 100);
+        int ie = Sched_AddEvent(&sched, "e", job, &e, 10);
+        while (Sched_Run(&sched)) {}
+        uint32_t w = Sched_GetWait(&sched);
+        printf("Wait after the jobs: %u ticks\n", (unsigned) w);
+        check(w == 99, "wait to the next release");
+        Sched_Signal(&sched, ie);
+        check(Sched_GetWait(&sched) == 0, "wait with a signal");
+        now += 200;
+        while (Sched_Run(&sched)) {}
+        check(sched.tasks[0].skipped == 1, "skipped period");
+    }
+
+    printf("%s\n", errors ? "FAILED" : "OK");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file    swo_capture.c
+ * @brief   Host stand-in for the SWO telemetry: writes a capture file.
+ *
+ * Runs the player and the telemetry module (software/telemetry.c) as the
+ * firmware does: a packet from the monitor every 100 ms, pumped once per
+ * sample. The ITM is modelled as a one word stimulus port drained at the
+ * SWO rate (875 kHz NRZ, 5 bytes per word), so TryWrite is busy while a
+ * word is going out. The bytes are framed as the ITM sends them, with
+ * syncs, local timestamps and DWT hardware packets in between.
+ *
+ * Trouble on the way: a burst of printf on port 0 holds the SWO for
+ * 250 ms (packets dropped by Telemetry_Send) and an overflow eats one word
+ * of a packet (the decoder must skip that packet alone).
+ *
+ * The bytes go to swo_capture.bin, the packets that reached the wire whole
+ * to swo_capture.csv, in the CSV of scripts/swo_decode.py. 'make swo-replay'
+ * runs both and compares.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "player.h"
+#include "soundbank.h"
+#include "attackcache.h"
+#include "telemetry.h"
+
+extern const SoundBank_Header_t soundbank;
+
+#define RATE            22050
+#define SECONDS         10
+#define MONITOR         (RATE/10)               // Samples between packets
+#define PORT            1                       // TELEMETRY_PORT in main.c
+#define CORE_HZ         48000000
+#define WORD_SAMPLES    2                       // 57 us per word on the SWO
+#define SYNC_EVERY      (2*RATE)
+#define TIMESTAMP_EVERY 1000
+#define PC_SAMPLE_EVERY 777
+#define BURST_AT        (3*RATE)                // printf on port 0 holds the
+#define BURST_SAMPLES   (RATE/4)                //   SWO this long
+#define OVERFLOW_AT     (6*RATE)                // One word lost after this
+
+static FILE *bin;
+static FILE *csv;
+static uint32_t now;                            // Sample
+static uint32_t port_free = 0;                  // Sample the port takes a word again
+static uint32_t last_stamp = 0;
+static int overflow_done = 0;
+static int packet_lost = 0;
+static Telemetry_t tm;
+
+static void put(const uint8_t *b, unsigned n) {
+    fwrite(b, 1, n, bin);
+}
+
+// Source packet: header (port, size code) and the data, little endian
+static void source(unsigned port, int hardware, uint32_t data, unsigned size) {
+    uint8_t b[5];
+    b[0] = (uint8_t) (port << 3 | (hardware ? 4 : 0) | (size == 4 ? 3 : size));
+    for (unsigned i = 0; i < size; i++) b[1 + i] = (uint8_t) (data >> (8 * i));
+    put(b, 1 + size);
+}
+
+// Local timestamp, format 1: cycles since the last one, 7 bits per byte
+static void timestamp(uint32_t cycles) {
+    uint8_t b[6];
+    unsigned n = 0;
+    b[n++] = 0xC0;
+    do {
+        b[n] = cycles & 0x7F;
+        cycles >>= 7;
+        if (cycles) b[n] |= 0x80;
+        n++;
+    } while (cycles && n < 5);
+    put(b, n);
+}
+
+// Traffic of the other sources between the words
+static void background(void) {
+    static const uint8_t sync[6] = { 0, 0, 0, 0, 0, 0x80 };
+    static const char text[] = "printf on port 0\n";
+    static unsigned k = 0;
+
+    if (now % SYNC_EVERY == 0) put(sync, sizeof(sync));
+    if (now % TIMESTAMP_EVERY == 0) {
+        timestamp((now - last_stamp) * (CORE_HZ / RATE));
+        last_stamp = now;
+    }
+    if (now % PC_SAMPLE_EVERY == 0) source(2, 1, 0x00001234 + now, 4);   // DWT PC sample
+    if (now >= BURST_AT && now < BURST_AT + BURST_SAMPLES) {
+        source(0, 0, (uint8_t) text[k++ % (sizeof(text) - 1)], 1);
+        port_free = now + 1;
+    }
+}
+
+// SWO_TryWrite: one word in the stimulus port at a time
+static int port_write(uint32_t word) {
+    if ((int32_t) (now - port_free) < 0) return 0;
+    port_free = now + WORD_SAMPLES;
+    if (!overflow_done && now >= OVERFLOW_AT && tm.sent == 3) {
+        // Word lost in the ITM: only the overflow packet comes out
+        static const uint8_t overflow = 0x70;
+        put(&overflow, 1);
+        overflow_done = 1;
+        packet_lost = 1;
+        return 1;
+    }
+    source(PORT, 0, word, 4);
+    return 1;
+}
+
+static void stats(Player_t *player, Telemetry_Stats_t *s) {
+    Player_VoiceStats_t v;
+    Player_GetVoiceStats(player, &v);
+    uint32_t voices = v.voices;
+    static uint32_t isr_max = 0, render_max = 0;
+    uint32_t isr = 180 + 3 * voices + now % 7;
+    uint32_t render = 2100 + 310 * voices + now % 97;
+
+    if (isr > isr_max) isr_max = isr;
+    if (render > render_max) render_max = render;
+    memset(s, 0, sizeof(*s));
+    s->time_ms = (uint32_t) ((uint64_t) now * 1000 / RATE);
+    s->isr_cycles_last = isr;
+    s->isr_cycles_max = isr_max;
+    s->render_cycles_max = render_max;
+    s->latency_max = 14;
+    s->voices = voices;
+    s->voice_limit = v.limit;
+    s->steals = v.steals;
+    s->render_load = render * 1024 / (CORE_HZ / RATE * 32);
+    s->fifo_fill = 200 + now % 50;
+    s->fifo_low = 160;
+    s->dropped = tm.dropped;
+}
+
+int main(void) {
+    if (SoundBank_Init(&soundbank, 0) < 0) {
+        fprintf(stderr, "Invalid sound bank\n");
+        return 1;
+    }
+    AttackCache_Init();
+    Player_Config_t config = { .sample_rate = RATE, .bpm = 120, .beats_per_bar = 4 };
+    Player_t *player = Player_GetInstance();
+    Player_Init(player, config);
+
+    bin = fopen("swo_capture.bin", "wb");
+    csv = fopen("swo_capture.csv", "w");
+    if (!bin || !csv) {
+        fprintf(stderr, "Cannot write the capture\n");
+        return 1;
+    }
+
+    // The capture starts in the middle of a packet of an earlier run
+    for (int i = 0; i < 5; i++) source(PORT, 0, 0x0BADF00D + i, 4);
+
+    Telemetry_Init(&tm, port_write);
+    unsigned max_voices = 0;
+    for (now = 0; now < SECONDS * RATE; now++) {
+        int16_t l, r;
+        Player_TickStereo(player, &l, &r);
+
+        if (now % MONITOR == 0) {
+            Telemetry_Stats_t s;
+            stats(player, &s);
+            if (s.voices > max_voices) max_voices = s.voices;
+            Telemetry_Send(&tm, TELEMETRY_STATS, &s, sizeof(s) / sizeof(uint32_t));
+        }
+        background();
+
+        // Main loop: pump at every wake up
+        uint32_t packets = tm.packets;
+        Telemetry_Pump(&tm);
+        if (tm.packets != packets) {
+            if (!packet_lost) {
+                fprintf(csv, "%u,%u", (unsigned) (tm.words[0] & 0xFF), (unsigned) (tm.words[0] >> 16 & 0xFF));
+                for (unsigned i = 1; i + 1 < tm.length; i++) fprintf(csv, ",%u", (unsigned) tm.words[i]);
+                fprintf(csv, "\n");
+            }
+            packet_lost = 0;
+        }
+    }
+    fclose(bin);
+    fclose(csv);
+
+    printf("SWO stand-in: %d s, %u packets written, %u dropped (port busy), 1 cut by an overflow\n",
+           SECONDS, (unsigned) tm.packets, (unsigned) tm.dropped);
+    printf("  up to %u voices, bytes in swo_capture.bin, packets in swo_capture.csv\n", max_voices);
+    return 0;
+}
@@ -0,0 +1,206 @@
+# swo_decode.py
+#
+# Decodifica a telemetria (software/telemetry.h) de um fluxo de bytes do SWO
+# e imprime uma linha por pacote.
+#
+# Uso: python3 scripts/swo_decode.py captura.bin
+#      <fonte dos bytes crus do SWO> | python3 scripts/swo_decode.py -
+#      python3 scripts/swo_decode.py --csv captura.bin
+#      python3 scripts/swo_decode.py --check esperado.csv captura.bin
+#
+# O fluxo é o protocolo ITM: sincronismo, overflow, timestamps e pacotes de
+# fonte (stimulus ports do software e pacotes de hardware do DWT). Só as
+# palavras de 32 bits da porta --port (1, TELEMETRY_PORT em main.c) formam
+# os pacotes; o resto é ignorado. Um pacote é reconhecido pelo magic, pelo
+# tamanho e pela palavra de verificação, então palavras perdidas (overflow,
+# início da captura no meio de um pacote) só perdem aquele pacote.
+#
+# --check compara os pacotes com os que scripts/swo_capture.c escreveu
+# ('make swo-replay'), sem placa nem probe.
+#
+# As tabelas TYPES e STATS devem seguir software/telemetry.h.
+import argparse
+import sys
+
+MAGIC = 0xA5
+WORDS_MAX = 16
+
+TYPES = {1: "stats"}
+STATS = [
+    "time_ms", "isr_cycles_last", "isr_cycles_max", "render_cycles_max", "latency_max",
+    "voices", "voice_limit", "steals", "render_load", "fifo_fill", "fifo_low", "late_ticks", "fifo_underruns", "i2s_underruns",
+    "late_steps", "dropped",
+]
+
+
+class ItmParser:
+    """Separa o fluxo ITM em palavras de uma porta. None marca um overflow."""
+
+    def __init__(self, port):
+        self.port = port
+        self.pending = b""
+        self.zeros = 0
+        self.overflows = 0
+        self.syncs = 0
+        self.timestamps = 0
+        self.other = 0          # Outras portas, hardware, extensões
+
+    def feed(self, data):
+        data = self.pending + data
+        out = []
+        i = 0
+        n = len(data)
+        while i < n:
+            b = data[i]
+            if b == 0x00:
+                self.zeros += 1
+                i += 1
+                continue
+            if b == 0x80 and self.zeros >= 5:
+                self.syncs += 1
+                self.zeros = 0
+                i += 1
+                continue
+            self.zeros = 0
+
+            if b & 0x03:
+                # Pacote de fonte: 1, 2 ou 4 bytes de dados
+                size = {1: 1, 2: 2, 3: 4}[b & 0x03]
+                if i + 1 + size > n:
+                    break
+                if not (b & 0x04) and (b >> 3) == self.port and size == 4:
+                    out.append(int.from_bytes(data[i + 1:i + 5], "little"))
+                else:
+                    self.other += 1
+                i += 1 + size
+                continue
+
+            if b == 0x70:
+                self.overflows += 1
+                out.append(None)
+                i += 1
+                continue
+
+            # Timestamps e extensões: bytes de continuação enquanto o bit 7 vale 1
+            j = i + 1
+            if b & 0x80:
+                while j < n and data[j] & 0x80:
+                    j += 1
+                if j >= n:
+                    break
+                j += 1
+            if b & 0x0F == 0 and b not in (0x00, 0x80):
+                self.timestamps += 1
+            else:
+                self.other += 1
+            i = j
+        self.pending = data[i:]
+        return out
+
+
+class PacketParser:
+    """Junta palavras em pacotes, ressincronizando após perdas."""
+
+    def __init__(self):
+        self.words = []
+        self.lost_words = 0
+        self.last_seq = None
+        self.lost_packets = 0
+
+    def feed(self, words):
+        out = []
+        for w in words:
+            if w is None:
+                continue        # A verificação descarta o pacote incompleto
+            self.words.append(w)
+            out += self._scan()
+        return out
+
+    def _scan(self):
+        out = []
+        while self.words:
+            h = self.words[0]
+            length = (h >> 8) & 0xFF
+            if h >> 24 != MAGIC or length > WORDS_MAX:
+                self.words.pop(0)
+                self.lost_words += 1
+                continue
+            if len(self.words) < length + 2:
+                break
+            if sum(self.words[:length + 2]) & 0xFFFFFFFF != 0:
+                self.words.pop(0)
+                self.lost_words += 1
+                continue
+            seq = h & 0xFF
+            if self.last_seq is not None:
+                self.lost_packets += (seq - self.last_seq - 1) & 0xFF
+            self.last_seq = seq
+            out.append((seq, (h >> 16) & 0xFF, self.words[1:length + 1]))
+            del self.words[:length + 2]
+        return out
+
+
+def to_csv(packet):
+    seq, kind, payload = packet
+    return ",".join(str(v) for v in [seq, kind] + payload)
+
+
+def to_text(packet):
+    seq, kind, payload = packet
+    if kind != 1 or len(payload) != len(STATS):
+        return "#%3d %s %s" % (seq, TYPES.get(kind, kind), payload)
+    s = dict(zip(STATS, payload))
+    return ("%9.3f s  isr %4d/%4d  render %5d (%3d%%)  lat %3d  voices %2d/%2d  steals %d"
+            "  fifo %3d (low %3d)  late %d  fifo_u %d  i2s_u %d  steps %d  drop %d" % (
+                s["time_ms"] / 1000.0, s["isr_cycles_last"], s["isr_cycles_max"],
+                s["render_cycles_max"], s["render_load"] * 100 // 1024, s["latency_max"],
+                s["voices"], s["voice_limit"], s["steals"], s["fifo_fill"],
+                s["fifo_low"], s["late_ticks"], s["fifo_underruns"], s["i2s_underruns"],
+                s["late_steps"], s["dropped"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decodifica a telemetria do SWO")
+    ap.add_argument("capture", help="arquivo com os bytes do SWO, ou - para stdin")
+    ap.add_argument("--port", type=int, default=1, help="stimulus port (padrão 1)")
+    ap.add_argument("--csv", action="store_true", help="uma linha CSV por pacote")
+    ap.add_argument("--check", metavar="CSV", help="compara com os pacotes esperados")
+    args = ap.parse_args()
+
+    itm = ItmParser(args.port)
+    packets = PacketParser()
+    decoded = []
+    count = 0
+    f = sys.stdin.buffer if args.capture == "-" else open(args.capture, "rb")
+    while True:
+        chunk = f.read1(4096) if hasattr(f, "read1") else f.read(4096)
+        if not chunk:
+            break
+        for p in packets.feed(itm.feed(chunk)):
+            count += 1
+            if args.check:
+                decoded.append(to_csv(p))
+            else:
+                print(to_csv(p) if args.csv else to_text(p), flush=True)
+
+    sys.stderr.write("%d pacotes, %d perdidos, %d palavras descartadas; ITM: %d overflows, "
+                     "%d sincronismos, %d timestamps, %d outros pacotes\n" % (
+                         count, packets.lost_packets, packets.lost_words, itm.overflows,
+                         itm.syncs, itm.timestamps, itm.other))
+    if not args.check:
+        return 0
+
+    with open(args.check) as e:
+        expected = [line.strip() for line in e if line.strip()]
+    if decoded != expected:
+        missing = [x for x in expected if x not in decoded]
+        extra = [x for x in decoded if x not in expected]
+        print("FAILED: %d esperados, %d decodificados, %d faltando, %d a mais" % (
+            len(expected), len(decoded), len(missing), len(extra)))
+        return 1
+    print("OK: %d pacotes iguais aos escritos" % len(decoded))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
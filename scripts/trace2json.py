@@ -0,0 +1,141 @@
+# trace2json.py
+#
+# Converte o despejo do trace (software/trace.h) em JSON do Chrome trace,
+# que abre em chrome://tracing ou em https://ui.perfetto.dev.
+#
+# Uso: python3 scripts/trace2json.py trace.bin > trace.json
+#
+# trace.bin é a variável trace inteira, como sai de Trace_Dump (UART,
+# arquivo no host) ou do depurador ('make trace-dump'). Little endian.
+#
+# A tabela EVENTS deve ter a mesma ordem do enum em software/trace.h.
+import json
+import struct
+import sys
+
+MAGIC = 0x31435254
+
+EVENTS = [
+    "ISR_ENTER", "ISR_EXIT", "TASK_BEGIN", "TASK_END", "STEP",
+    "VOICE_START", "VOICE_END", "VOICE_DROP", "PATTERN", "PREMIX", "UI", "MARK",
+    "VOICE_STEAL",
+]
+IRQS = ["SysTick", "PendSV", "DMA", "GPIO"]
+UI = ["pause", "rythm", "bpm"]
+# Tarefas na ordem de Sched_Add* em main.c
+TASKS = ["buttons", "touch", "display", "monitor", "premix"]
+# Instrumentos (PLAYER_KICK...) e bits do passo (bKICK...) em player.c
+INSTRUMENTS = ["kick", "snare", "hihat"]
+
+PID = 1
+TID_MAIN = 1
+TID_PLAYER = 2
+TID_UI = 3
+TID_IRQ = 10        # + TRACE_IRQ_*
+
+
+def name_of(table, i):
+    return table[i] if i < len(table) else str(i)
+
+
+def read_records(data):
+    """Retorna (clock_hz, [(tempo, id, payload)]) do mais antigo ao mais novo."""
+    magic, records, clock_hz, _mask, head = struct.unpack_from("<5I", data, 0)
+    if magic != MAGIC:
+        raise ValueError("não é um despejo do trace (magic %08x)" % magic)
+    if len(data) < 20 + 8 * records:
+        raise ValueError("despejo incompleto: %d bytes" % len(data))
+
+    n = min(head, records)
+    out = []
+    for k in range(head - n, head):
+        time, event = struct.unpack_from("<2I", data, 20 + 8 * (k % records))
+        out.append((time, event >> 24, event & 0xFFFFFF))
+    return clock_hz, out
+
+
+def to_chrome(clock_hz, records):
+    events = []
+    meta = [(TID_MAIN, "main loop"), (TID_PLAYER, "player"), (TID_UI, "ui")]
+    meta += [(TID_IRQ + i, name) for i, name in enumerate(IRQS)]
+    for tid, name in meta:
+        events.append({"ph": "M", "pid": PID, "tid": tid, "name": "thread_name",
+                       "args": {"name": name}})
+
+    # Contador de ciclos de 32 bits: desfaz as voltas
+    base = 0
+    last = None
+    voices = {}
+    us = 0.0
+    for time, ev, arg in records:
+        if last is not None and time < last:
+            base += 1 << 32
+        last = time
+        us = (base + time) * 1e6 / clock_hz
+        name = name_of(EVENTS, ev)
+
+        if ev in (0, 1):
+            events.append({"ph": "B" if ev == 0 else "E", "pid": PID,
+                           "tid": TID_IRQ + arg, "ts": us, "name": name_of(IRQS, arg)})
+        elif ev in (2, 3):
+            events.append({"ph": "B" if ev == 2 else "E", "pid": PID,
+                           "tid": TID_MAIN, "ts": us, "name": name_of(TASKS, arg)})
+        elif ev == 5:
+            channel = arg & 0xFF
+            voices[channel] = name_of(INSTRUMENTS, arg >> 8)
+            events.append({"ph": "b", "pid": PID, "tid": TID_PLAYER, "ts": us,
+                           "cat": "voice", "id": channel, "name": voices[channel]})
+        elif ev in (6, 12):
+            if arg in voices:
+                inst = voices.pop(arg)
+                events.append({"ph": "e", "pid": PID, "tid": TID_PLAYER, "ts": us,
+                               "cat": "voice", "id": arg, "name": inst})
+                if ev == 12:
+                    # Voz roubada: limite de vozes ou nova batida
+                    events.append({"ph": "i", "s": "t", "pid": PID, "tid": TID_PLAYER, "ts": us,
+                                   "name": name, "args": {"instrument": inst, "channel": arg}})
+        else:
+            if ev == 9 and arg == 1:
+                # O loop pré-mixado desliga as vozes ao vivo
+                for channel, inst in voices.items():
+                    events.append({"ph": "e", "pid": PID, "tid": TID_PLAYER, "ts": us,
+                                   "cat": "voice", "id": channel, "name": inst})
+                voices = {}
+            args = {"value": arg}
+            if ev == 4:
+                args = {"step": arg >> 8,
+                        "instruments": [n for i, n in enumerate(INSTRUMENTS) if arg & (1 << i)]}
+            elif ev == 7:
+                args = {"instrument": name_of(INSTRUMENTS, arg)}
+            elif ev == 10:
+                args = {"event": name_of(UI, arg >> 16), "value": arg & 0xFFFF}
+            tid = TID_UI if ev == 10 else TID_PLAYER
+            events.append({"ph": "i", "s": "t", "pid": PID, "tid": tid, "ts": us,
+                           "name": name, "args": args})
+
+    # Vozes ainda soando no fim do trace
+    for channel, inst in voices.items():
+        events.append({"ph": "e", "pid": PID, "tid": TID_PLAYER, "ts": us,
+                       "cat": "voice", "id": channel, "name": inst})
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("uso: python3 scripts/trace2json.py trace.bin > trace.json\n")
+        return 1
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    try:
+        clock_hz, records = read_records(data)
+    except ValueError as e:
+        sys.stderr.write("trace2json: %s\n" % e)
+        return 1
+    json.dump(to_chrome(clock_hz, records), sys.stdout, indent=0)
+    sys.stdout.write("\n")
+    sys.stderr.write("%d eventos\n" % len(records))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
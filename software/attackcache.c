@@ -0,0 +1,94 @@
+/** ***************************************************************************
+ * @file    attackcache.c
+ * @brief   RAM copy of the first samples (attack) of every sound bank entry
+ * @version 1.0
+******************************************************************************/
+#include "attackcache.h"
+#include "soundbank.h"
+
+typedef struct {
+    const int16_t *data;        // Start of the copy in RAM
+    uint32_t       length;      // Samples copied (int16_t, always even)
+} AttackCache_Entry_t;
+
+static AttackCache_Entry_t entries[SOUNDBANK_ENTRIES_MAX];
+static uint32_t used = 0;       // Samples used in attackcache_ram
+
+#if ATTACKCACHE_BYTES > 0
+static int16_t attackcache_ram[ATTACKCACHE_BYTES/sizeof(int16_t)] __attribute__((aligned(4)));
+#endif
+
+/**
+ * @brief   AttackCache_Init
+ *
+ * @note    Must be called after SoundBank_Init. Copies the attack of each
+ *          sound to RAM, as configured by ATTACKCACHE_SAMPLES
+ *
+ * @returns Number of entries cached
+ */
+int AttackCache_Init(void) {
+int cached = 0;
+
+    used = 0;
+    for(unsigned i=0;i<SOUNDBANK_ENTRIES_MAX;i++) {
+        entries[i].data = 0;
+        entries[i].length = 0;
+    }
+
+#if ATTACKCACHE_BYTES > 0
+    static const uint32_t samples[] = ATTACKCACHE_SAMPLES;
+    const uint32_t capacity = sizeof(attackcache_ram)/sizeof(attackcache_ram[0]);
+    unsigned n = SoundBank_Count();
+
+    if( n > sizeof(samples)/sizeof(samples[0]) )
+        n = sizeof(samples)/sizeof(samples[0]);
+
+    for(unsigned i=0;i<n;i++) {
+        uint32_t length;
+        const int16_t *data = SoundBank_GetSound(i, &length);
+        uint32_t m = samples[i];
+
+        if( m > length ) m = length;
+        if( m > capacity-used ) m = capacity-used;
+        m &= ~1UL;                  // Whole frames only
+        if( !data || m == 0 )
+            continue;
+
+        for(uint32_t k=0;k<m;k++) attackcache_ram[used+k] = data[k];
+        entries[i].data = &attackcache_ram[used];
+        entries[i].length = m;
+        used += m;
+        cached++;
+    }
+#endif
+    return cached;
+}
+
+/**
+ * @brief   AttackCache_Get
+ *
+ * @param   index   Sound bank entry
+ * @param   length  Receives the number of cached samples (0 if not cached)
+ *
+ * @returns Pointer to the cached samples or null. Sample k of the copy is
+ *          sample k of the bank entry
+ */
+const int16_t *AttackCache_Get(unsigned index, uint32_t *length) {
+
+    if( index >= SOUNDBANK_ENTRIES_MAX ) {
+        *length = 0;
+        return 0;
+    }
+    *length = entries[index].length;
+    return entries[index].data;
+}
+
+/**
+ * @brief   Returns the RAM actually used by the cache in bytes
+ *
+ * @note    The reserved RAM is ATTACKCACHE_BYTES
+ */
+uint32_t AttackCache_GetUsedBytes(void) {
+
+    return used*sizeof(int16_t);
+}
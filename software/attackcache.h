@@ -0,0 +1,32 @@
+/** ***************************************************************************
+ * @file    attackcache.h
+ * @brief   RAM copy of the first samples (attack) of every sound bank entry
+ * @version 1.0
+ *
+ * @note    Hits pile up on the transients. Reading the attack from RAM keeps
+ *          the flash free for the tails of the other voices.
+ *
+ * @note    The RAM budget is fixed at compile time with ATTACKCACHE_BYTES
+ *          (0 disables the cache) and the amount cached per sound with
+ *          ATTACKCACHE_SAMPLES, indexed by bank entry. Entries are filled in
+ *          order until the budget is exhausted. The budget shows up as the
+ *          attackcache_ram symbol in 'make size'.
+******************************************************************************/
+#ifndef ATTACKCACHE_H
+#define ATTACKCACHE_H
+#include <stdint.h>
+
+#ifndef ATTACKCACHE_BYTES
+#define ATTACKCACHE_BYTES       16384
+#endif
+
+// Samples (int16_t, 2 per frame) cached for KICK, SNARE, ...
+#ifndef ATTACKCACHE_SAMPLES
+#define ATTACKCACHE_SAMPLES     { 4096, 2048 }
+#endif
+
+int             AttackCache_Init(void);
+const int16_t  *AttackCache_Get(unsigned index, uint32_t *length);
+uint32_t        AttackCache_GetUsedBytes(void);
+
+#endif // ATTACKCACHE_H
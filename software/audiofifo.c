@@ -0,0 +1,109 @@
+/** ***************************************************************************
+ * @file    audiofifo.c
+ * @brief   Render-ahead FIFO between the mixer and the output interrupt
+ * @version 1.0
+******************************************************************************/
+#include "audiofifo.h"
+
+/*
+ * head is volatile, frames[] is not, so the compiler may move the stores of
+ * the frames after the store of head. The barrier keeps them before it.
+ * The Cortex-M3 does not reorder its own stores, so no DMB is needed.
+ */
+#define PUBLISH_BARRIER()       __asm volatile ("" ::: "memory")
+
+/**
+ * @brief   AudioFifo_Init
+ *
+ * @note    Empty FIFO, target at full capacity
+ */
+void AudioFifo_Init(AudioFifo_t *fifo) {
+
+    fifo->head = 0;
+    fifo->tail = 0;
+    fifo->target = AUDIOFIFO_FRAMES;
+    AudioFifo_ResetStats(fifo);
+}
+
+/**
+ * @brief   AudioFifo_SetTarget
+ *
+ * @note    Sets the fill the producer aims at, that is the latency in
+ *          output frames
+ *
+ * @returns 0=OK, -1 if frames is 0 or above the capacity
+ */
+int AudioFifo_SetTarget(AudioFifo_t *fifo, uint32_t frames) {
+
+    if( frames == 0 || frames > AUDIOFIFO_FRAMES )
+        return -1;
+    fifo->target = frames;
+    return 0;
+}
+
+/**
+ * @brief   AudioFifo_Push
+ *
+ * @param   left, right Samples of each channel. right == 0 for mono
+ * @param   n           Number of frames
+ *
+ * @returns Frames pushed. The others do not fit and are not pushed
+ */
+uint32_t AudioFifo_Push(AudioFifo_t *fifo, const int16_t *left, const int16_t *right, uint32_t n) {
+uint32_t h = fifo->head;
+uint32_t room = AUDIOFIFO_FRAMES - (h - fifo->tail);
+
+    if( n > room ) n = room;
+    if( !right ) right = left;
+    for(uint32_t k=0;k<n;k++) {
+        fifo->frames[(h+k)&(AUDIOFIFO_FRAMES-1)] = (uint16_t) left[k]
+                                                  | ((uint32_t) (uint16_t) right[k]<<16);
+    }
+    PUBLISH_BARRIER();
+    fifo->head = h + n;                 // Published after the data
+    return n;
+}
+
+/**
+ * @brief   AudioFifo_PushSilence
+ *
+ * @note    Pushes n frames of zeros, e.g. to restart the output ahead of
+ *          the mixer
+ *
+ * @returns Frames pushed
+ */
+uint32_t AudioFifo_PushSilence(AudioFifo_t *fifo, uint32_t n) {
+uint32_t h = fifo->head;
+uint32_t room = AUDIOFIFO_FRAMES - (h - fifo->tail);
+
+    if( n > room ) n = room;
+    for(uint32_t k=0;k<n;k++) {
+        fifo->frames[(h+k)&(AUDIOFIFO_FRAMES-1)] = 0;
+    }
+    PUBLISH_BARRIER();
+    fifo->head = h + n;                 // Published after the data
+    return n;
+}
+
+/**
+ * @brief   AudioFifo_GetStats
+ */
+void AudioFifo_GetStats(AudioFifo_t *fifo, AudioFifo_Stats_t *stats) {
+
+    stats->fill = AudioFifo_GetFill(fifo);
+    stats->high = fifo->high;
+    stats->low = fifo->low;
+    stats->underruns = fifo->underruns;
+}
+
+/**
+ * @brief   AudioFifo_ResetStats
+ *
+ * @note    The watermarks start again with the next Pop
+ */
+void AudioFifo_ResetStats(AudioFifo_t *fifo) {
+
+    fifo->high = 0;
+    fifo->low = AUDIOFIFO_FRAMES;
+    fifo->underruns = 0;
+}
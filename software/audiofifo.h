@@ -0,0 +1,108 @@
+/** ***************************************************************************
+ * @file    audiofifo.h
+ * @brief   Render-ahead FIFO between the mixer and the output interrupt
+ * @version 1.0
+ *
+ * @note    The mixer renders blocks ahead of time at low priority and the
+ *          output interrupt only pops one frame per period. Work that delays
+ *          the mixer (UI, premix rendering) is absorbed as long as the FIFO
+ *          does not empty.
+ *
+ * @note    Single producer, single consumer, no lock: Push only moves head
+ *          and Pop only moves tail. A frame is one 32 bit word (left in the
+ *          low half), so the interrupt reads it with one load.
+ *
+ * @note    The capacity is AUDIOFIFO_FRAMES (a power of 2). The fill target,
+ *          and so the latency, can be lowered at run time with
+ *          AudioFifo_SetTarget: a lower target answers faster to the UI, a
+ *          higher one tolerates longer spikes of other work.
+ *
+ * @note    Statistics: fill level, highest and lowest fill seen by Pop
+ *          since the last reset, and underruns (Pop on an empty FIFO, which
+ *          returns silence).
+******************************************************************************/
+#ifndef AUDIOFIFO_H
+#define AUDIOFIFO_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#ifndef AUDIOFIFO_FRAMES
+#define AUDIOFIFO_FRAMES        256     // 5.8 ms at 44.1 kHz
+#endif
+
+#if (AUDIOFIFO_FRAMES & (AUDIOFIFO_FRAMES-1)) != 0
+#error "AUDIOFIFO_FRAMES must be a power of 2"
+#endif
+
+typedef struct {
+    uint32_t fill;              // Frames in the FIFO now
+    uint32_t high;              // Highest fill seen by Pop
+    uint32_t low;               // Lowest fill seen by Pop
+    uint32_t underruns;         // Pops on an empty FIFO
+} AudioFifo_Stats_t;
+
+typedef struct {
+    uint32_t          frames[AUDIOFIFO_FRAMES];
+    volatile uint32_t head;     // Frames pushed
+    volatile uint32_t tail;     // Frames popped
+    uint32_t          target;   // Fill the producer aims at
+    volatile uint32_t high;
+    volatile uint32_t low;
+    volatile uint32_t underruns;
+} AudioFifo_t;
+
+void     AudioFifo_Init(AudioFifo_t *fifo);
+int      AudioFifo_SetTarget(AudioFifo_t *fifo, uint32_t frames);
+uint32_t AudioFifo_Push(AudioFifo_t *fifo, const int16_t *left, const int16_t *right, uint32_t n);
+uint32_t AudioFifo_PushSilence(AudioFifo_t *fifo, uint32_t n);
+void     AudioFifo_GetStats(AudioFifo_t *fifo, AudioFifo_Stats_t *stats);
+void     AudioFifo_ResetStats(AudioFifo_t *fifo);
+
+/**
+ * @brief   Returns the frames in the FIFO
+ */
+static inline uint32_t AudioFifo_GetFill(const AudioFifo_t *fifo) {
+
+    return fifo->head - fifo->tail;
+}
+
+/**
+ * @brief   Returns the frames the producer should push to reach the target
+ */
+static inline uint32_t AudioFifo_GetDemand(const AudioFifo_t *fifo) {
+uint32_t fill = fifo->head - fifo->tail;
+
+    return (fill < fifo->target) ? fifo->target - fill : 0;
+}
+
+/**
+ * @brief   Pops one frame
+ *
+ * @note    Always inlined: it runs in SysTick for every frame, and at -O0 a
+ *          plain static inline would be a call into flash
+ *
+ * @returns 1 if a frame was popped, 0 on underrun (left and right are 0)
+ */
+__attribute__((always_inline))
+static inline int AudioFifo_Pop(AudioFifo_t *fifo, int16_t *left, int16_t *right) {
+uint32_t t = fifo->tail;
+uint32_t fill = fifo->head - t;
+
+    if( fill == 0 ) {
+        fifo->underruns++;
+        fifo->low = 0;
+        *left = *right = 0;
+        return 0;
+    }
+    if( fill > fifo->high ) fifo->high = fill;
+    if( fill < fifo->low ) fifo->low = fill;
+
+    uint32_t w = fifo->frames[t&(AUDIOFIFO_FRAMES-1)];
+    __asm volatile ("" ::: "memory");   // Read before the slot is freed
+    fifo->tail = t + 1;
+    *left  = (int16_t) (w&0xFFFF);
+    *right = (int16_t) (w>>16);
+    return 1;
+}
+
+#endif // AUDIOFIFO_H
@@ -0,0 +1,227 @@
+/** ***************************************************************************
+ * @file    biquad.c
+ * @brief   Fixed point biquad filter cascades
+ * @version 1.0
+******************************************************************************/
+#include "biquad.h"
+#include "biquad_presets.h"
+
+/**
+ * @brief   Biquad_GetPreset
+ *
+ * @param   preset      BIQUAD_LP_2K, ...
+ * @param   sample_rate 22050 or 44100
+ *
+ * @returns Coefficients of the section or null if there is no table for it
+ */
+const Biquad_Coefs_t *Biquad_GetPreset(unsigned preset, uint32_t sample_rate) {
+
+    if( preset >= BIQUAD_PRESETS )
+        return 0;
+    if( sample_rate == 22050 )
+        return &biquad_presets_22050[preset];
+    if( sample_rate == 44100 )
+        return &biquad_presets_44100[preset];
+    return 0;
+}
+
+/**
+ * @brief   Converts a Q30 coefficient to Q14, rounded and saturated
+ */
+static int16_t to_q14(int32_t c) {
+int32_t v = (int32_t) (((int64_t) c + (1<<15)) >> 16);
+
+    if( v > INT16_MAX ) v = INT16_MAX;
+    if( v < INT16_MIN ) v = INT16_MIN;
+    return (int16_t) v;
+}
+
+/**
+ * @brief   Biquad_InitQ15
+ *
+ * @note    Empties the cascade. A cascade without sections passes the
+ *          samples unchanged
+ */
+void Biquad_InitQ15(Biquad_Q15_t *f) {
+
+    f->sections = 0;
+}
+
+/**
+ * @brief   Biquad_AddSectionQ15
+ *
+ * @note    The section starts with zero state. It is published last, so it
+ *          can be added while the cascade is in use
+ *
+ * @returns 0=OK, -1 if the cascade is full or c is null
+ */
+int Biquad_AddSectionQ15(Biquad_Q15_t *f, const Biquad_Coefs_t *c) {
+unsigned n = f->sections;
+
+    if( !c || n >= BIQUAD_SECTIONS_MAX )
+        return -1;
+
+    Biquad_SectionQ15_t *s = &f->s[n];
+    s->b0 = to_q14(c->b0);
+    s->b1 = to_q14(c->b1);
+    s->b2 = to_q14(c->b2);
+    s->a1 = to_q14(c->a1);
+    s->a2 = to_q14(c->a2);
+    s->x1 = s->x2 = s->y1 = s->y2 = 0;
+    f->sections = n+1;
+    return 0;
+}
+
+/**
+ * @brief   Biquad_ProcessQ15
+ *
+ * @note    Filters a block in place
+ */
+RAMFUNC void Biquad_ProcessQ15(Biquad_Q15_t *f, int16_t *buffer, uint32_t n) {
+const unsigned sections = f->sections;
+
+    for(unsigned i=0;i<sections;i++) {
+        Biquad_SectionQ15_t *s = &f->s[i];
+        const int32_t b0 = s->b0, b1 = s->b1, b2 = s->b2;
+        const int32_t a1 = s->a1, a2 = s->a2;
+        int32_t x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+
+        for(uint32_t k=0;k<n;k++) {
+            int32_t x = buffer[k];
+            int64_t acc = (1<<13) + (int64_t) b0*x + (int64_t) b1*x1 + (int64_t) b2*x2
+                        + (int64_t) a1*y1 + (int64_t) a2*y2;
+            acc >>= 14;
+            if( acc > INT16_MAX ) acc = INT16_MAX;
+            if( acc < INT16_MIN ) acc = INT16_MIN;
+            x2 = x1; x1 = x;
+            y2 = y1; y1 = (int32_t) acc;
+            buffer[k] = (int16_t) acc;
+        }
+        s->x1 = (int16_t) x1; s->x2 = (int16_t) x2;
+        s->y1 = (int16_t) y1; s->y2 = (int16_t) y2;
+    }
+}
+
+/**
+ * @brief   Biquad_InitQ31
+ */
+void Biquad_InitQ31(Biquad_Q31_t *f) {
+
+    f->sections = 0;
+}
+
+/**
+ * @brief   Biquad_AddSectionQ31
+ *
+ * @returns 0=OK, -1 if the cascade is full or c is null
+ */
+int Biquad_AddSectionQ31(Biquad_Q31_t *f, const Biquad_Coefs_t *c) {
+unsigned n = f->sections;
+
+    if( !c || n >= BIQUAD_SECTIONS_MAX )
+        return -1;
+
+    Biquad_SectionQ31_t *s = &f->s[n];
+    s->b0 = c->b0;
+    s->b1 = c->b1;
+    s->b2 = c->b2;
+    s->a1 = c->a1;
+    s->a2 = c->a2;
+    s->x1 = s->x2 = s->y1 = s->y2 = 0;
+    f->sections = n+1;
+    return 0;
+}
+
+/**
+ * @brief   Biquad_ProcessQ31
+ *
+ * @note    Filters a block in place
+ */
+RAMFUNC void Biquad_ProcessQ31(Biquad_Q31_t *f, int32_t *buffer, uint32_t n) {
+const unsigned sections = f->sections;
+
+    for(unsigned i=0;i<sections;i++) {
+        Biquad_SectionQ31_t *s = &f->s[i];
+        const int32_t b0 = s->b0, b1 = s->b1, b2 = s->b2;
+        const int32_t a1 = s->a1, a2 = s->a2;
+        int32_t x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+
+        for(uint32_t k=0;k<n;k++) {
+            int32_t x = buffer[k];
+            int64_t acc = (int64_t) 1<<29;
+            acc += (int64_t) b0*x;
+            acc += (int64_t) b1*x1;
+            acc += (int64_t) b2*x2;
+            acc += (int64_t) a1*y1;
+            acc += (int64_t) a2*y2;
+            x2 = x1; x1 = x;
+            y2 = y1; y1 = (int32_t) (acc >> 30);
+            buffer[k] = y1;
+        }
+        s->x1 = x1; s->x2 = x2;
+        s->y1 = y1; s->y2 = y2;
+    }
+}
+
+/**
+ * @brief   Biquad_IsQuietQ15
+ *
+ * @note    With rounding, a section fed with zeros may settle on a small
+ *          value instead of zero
+ *
+ * @returns 1 if the state of every section is within +/-residue
+ */
+int Biquad_IsQuietQ15(const Biquad_Q15_t *f, int32_t residue) {
+const unsigned n = f->sections;
+
+    for(unsigned i=0;i<n;i++) {
+        const Biquad_SectionQ15_t *s = &f->s[i];
+        if( s->x1 > residue || s->x1 < -residue || s->x2 > residue || s->x2 < -residue
+         || s->y1 > residue || s->y1 < -residue || s->y2 > residue || s->y2 < -residue )
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief   Biquad_IsQuietQ31
+ *
+ * @returns 1 if the state of every section is within +/-residue
+ */
+int Biquad_IsQuietQ31(const Biquad_Q31_t *f, int32_t residue) {
+const unsigned n = f->sections;
+
+    for(unsigned i=0;i<n;i++) {
+        const Biquad_SectionQ31_t *s = &f->s[i];
+        if( s->x1 > residue || s->x1 < -residue || s->x2 > residue || s->x2 < -residue
+         || s->y1 > residue || s->y1 < -residue || s->y2 > residue || s->y2 < -residue )
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief   Biquad_ClearQ15
+ *
+ * @note    Zeroes the state and keeps the sections
+ */
+void Biquad_ClearQ15(Biquad_Q15_t *f) {
+
+    for(unsigned i=0;i<BIQUAD_SECTIONS_MAX;i++) {
+        Biquad_SectionQ15_t *s = &f->s[i];
+        s->x1 = s->x2 = s->y1 = s->y2 = 0;
+    }
+}
+
+/**
+ * @brief   Biquad_ClearQ31
+ *
+ * @note    Zeroes the state and keeps the sections
+ */
+void Biquad_ClearQ31(Biquad_Q31_t *f) {
+
+    for(unsigned i=0;i<BIQUAD_SECTIONS_MAX;i++) {
+        Biquad_SectionQ31_t *s = &f->s[i];
+        s->x1 = s->x2 = s->y1 = s->y2 = 0;
+    }
+}
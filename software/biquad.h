@@ -0,0 +1,127 @@
+/** ***************************************************************************
+ * @file    biquad.h
+ * @brief   Fixed point biquad filter cascades
+ * @version 1.0
+ *
+ * @note    Direct form I sections, y = b0*x + b1*x1 + b2*x2 + a1*y1 + a2*y2,
+ *          with a1 and a2 stored negated so every term is a multiply-add.
+ *
+ * @note    Two flavours share the same precomputed sections:
+ *          - Q15: 16 bit samples, Q14 coefficients, 64 bit accumulator
+ *            (SMLAL). The coefficients are below 2 in magnitude, but the
+ *            five of a high-pass or shelf add up to about 7, so a full
+ *            scale input would overflow 32 bits. Good for cutoffs above
+ *            about 1 kHz (e.g. the brightness of a voice).
+ *          - Q31: 32 bit samples, Q30 coefficients, 64 bit accumulator
+ *            (SMLAL). For low cutoffs and for the master bus, where the mix
+ *            does not fit 16 bits.
+ *
+ * @note    The block functions run section by section over the whole block,
+ *          so coefficients and state stay in registers.
+ *
+ * @note    The preset tables are generated by scripts/biquad_design.py for
+ *          22050 Hz and 44100 Hz. The order below must match the script.
+******************************************************************************/
+#ifndef BIQUAD_H
+#define BIQUAD_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#define BIQUAD_SECTIONS_MAX     2       // Sections per cascade
+
+// Precomputed sections
+enum {
+    BIQUAD_LP_2K = 0,
+    BIQUAD_LP_4K,
+    BIQUAD_LP_6K,
+    BIQUAD_LP_8K,
+    BIQUAD_HP_30,
+    BIQUAD_HP_150,
+    BIQUAD_PEAK_60_P6,
+    BIQUAD_PEAK_2K5_M6,
+    BIQUAD_LOWSHELF_120_P6,
+    BIQUAD_HIGHSHELF_6K_P6,
+    BIQUAD_HIGHSHELF_6K_M6,
+    BIQUAD_PRESETS
+};
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;         // Q30, a1 and a2 negated
+} Biquad_Coefs_t;
+
+typedef struct {
+    int16_t b0, b1, b2, a1, a2;         // Q14
+    int16_t x1, x2, y1, y2;
+} Biquad_SectionQ15_t;
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;         // Q30
+    int32_t x1, x2, y1, y2;
+} Biquad_SectionQ31_t;
+
+typedef struct {
+    volatile uint8_t    sections;       // Sections in use, 0 = bypass
+    Biquad_SectionQ15_t s[BIQUAD_SECTIONS_MAX];
+} Biquad_Q15_t;
+
+typedef struct {
+    volatile uint8_t    sections;
+    Biquad_SectionQ31_t s[BIQUAD_SECTIONS_MAX];
+} Biquad_Q31_t;
+
+const Biquad_Coefs_t *Biquad_GetPreset(unsigned preset, uint32_t sample_rate);
+
+void Biquad_InitQ15(Biquad_Q15_t *f);
+int  Biquad_AddSectionQ15(Biquad_Q15_t *f, const Biquad_Coefs_t *c);
+RAMFUNC void Biquad_ProcessQ15(Biquad_Q15_t *f, int16_t *buffer, uint32_t n);
+
+void Biquad_InitQ31(Biquad_Q31_t *f);
+int  Biquad_AddSectionQ31(Biquad_Q31_t *f, const Biquad_Coefs_t *c);
+RAMFUNC void Biquad_ProcessQ31(Biquad_Q31_t *f, int32_t *buffer, uint32_t n);
+
+int  Biquad_IsQuietQ15(const Biquad_Q15_t *f, int32_t residue);
+int  Biquad_IsQuietQ31(const Biquad_Q31_t *f, int32_t residue);
+void Biquad_ClearQ15(Biquad_Q15_t *f);
+void Biquad_ClearQ31(Biquad_Q31_t *f);
+
+/**
+ * @brief   Filters one sample through a Q15 cascade
+ */
+static inline int16_t Biquad_TickQ15(Biquad_Q15_t *f, int16_t x) {
+const unsigned n = f->sections;
+
+    for(unsigned i=0;i<n;i++) {
+        Biquad_SectionQ15_t *s = &f->s[i];
+        int64_t acc = 1<<13;
+        acc += (int64_t) s->b0*x + (int64_t) s->b1*s->x1 + (int64_t) s->b2*s->x2
+             + (int64_t) s->a1*s->y1 + (int64_t) s->a2*s->y2;
+        acc >>= 14;
+        if( acc > INT16_MAX ) acc = INT16_MAX;
+        if( acc < INT16_MIN ) acc = INT16_MIN;
+        s->x2 = s->x1; s->x1 = x;
+        s->y2 = s->y1; s->y1 = (int16_t) acc;
+        x = (int16_t) acc;
+    }
+    return x;
+}
+
+/**
+ * @brief   Filters one sample through a Q31 cascade
+ */
+static inline int32_t Biquad_TickQ31(Biquad_Q31_t *f, int32_t x) {
+const unsigned n = f->sections;
+
+    for(unsigned i=0;i<n;i++) {
+        Biquad_SectionQ31_t *s = &f->s[i];
+        int64_t acc = (int64_t) 1<<29;
+        acc += (int64_t) s->b0*x + (int64_t) s->b1*s->x1 + (int64_t) s->b2*s->x2
+             + (int64_t) s->a1*s->y1 + (int64_t) s->a2*s->y2;
+        int32_t y = (int32_t) (acc >> 30);
+        s->x2 = s->x1; s->x1 = x;
+        s->y2 = s->y1; s->y1 = y;
+        x = y;
+    }
+    return x;
+}
+
+#endif // BIQUAD_H
@@ -0,0 +1,39 @@
+/** ***************************************************************************
+ * @file    biquad_presets.h
+ * @brief   Precomputed biquad sections (Q30)
+ *
+ * @note    Generated by scripts/biquad_design.py. Do not edit.
+ *          Included by biquad.c only. a1 and a2 are stored negated.
+******************************************************************************/
+#ifndef BIQUAD_PRESETS_H
+#define BIQUAD_PRESETS_H
+
+static const Biquad_Coefs_t biquad_presets_22050[BIQUAD_PRESETS] = {
+    [BIQUAD_LP_2K] = {    61418270,   122836539,    61418270,  1308758256,  -480689510 },
+    [BIQUAD_LP_4K] = {   190314683,   380629366,   190314683,   546229238,  -233746146 },
+    [BIQUAD_LP_6K] = {   359471542,   718943083,   359471542,  -174884793,  -189259549 },
+    [BIQUAD_LP_8K] = {   576746479,  1153492958,   576746479,  -909605726,  -323638365 },
+    [BIQUAD_HP_30] = {  1067270851, -2134541702,  1067270851,  2134502704, -1060838875 },
+    [BIQUAD_HP_150] = {  1041774494, -2083548988,  1041774494,  2082597066, -1010759085 },
+    [BIQUAD_PEAK_60_P6] = {  1080170012, -2134254103,  1054396062,  2134254103, -1060824250 },
+    [BIQUAD_PEAK_2K5_M6] = {   940926799, -1222215298,   674032286,  1222215298,  -541217260 },
+    [BIQUAD_LOWSHELF_120_P6] = {  1082789597, -2103365852,  1022314271,  2103799324, -1030928572 },
+    [BIQUAD_HIGHSHELF_6K_P6] = {  1474788335,   -57581700,   253424268,  -387806799,  -209082281 },
+    [BIQUAD_HIGHSHELF_6K_M6] = {   781753881,   282348571,   152225499,    41923222,  -184509349 },
+};
+
+static const Biquad_Coefs_t biquad_presets_44100[BIQUAD_PRESETS] = {
+    [BIQUAD_LP_2K] = {    18059396,    36118792,    18059396,  1719157134,  -717652895 },
+    [BIQUAD_LP_4K] = {    61418270,   122836539,    61418270,  1308758256,  -480689510 },
+    [BIQUAD_LP_6K] = {   120317959,   240635919,   120317959,   919108663,  -326638677 },
+    [BIQUAD_LP_8K] = {   190314683,   380629366,   190314683,   546229238,  -233746146 },
+    [BIQUAD_HP_30] = {  1070501448, -2141002896,  1070501448,  2140993117, -1067270851 },
+    [BIQUAD_HP_150] = {  1057637433, -2115274866,  1057637433,  2115033317, -1041774591 },
+    [BIQUAD_PEAK_60_P6] = {  1076965731, -2140926911,  1064039410,  2140926911, -1067263317 },
+    [BIQUAD_PEAK_2K5_M6] = {   993617815, -1711596895,   832606979,  1711596895,  -752482970 },
+    [BIQUAD_LOWSHELF_120_P6] = {  1078256893, -2125530306,  1047712296,  2125639767, -1052117905 },
+    [BIQUAD_HIGHSHELF_6K_P6] = {  1757564286, -1775567912,   629454208,   737392292,  -275101050 },
+    [BIQUAD_HIGHSHELF_6K_M6] = {   655976862,  -450492167,   168066400,  1084740708,  -384549979 },
+};
+
+#endif // BIQUAD_PRESETS_H
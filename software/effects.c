@@ -0,0 +1,219 @@
+/** ***************************************************************************
+ * @file    effects.c
+ * @brief   Send effects: tempo synced delay and a small reverb
+ * @version 1.0
+******************************************************************************/
+#include "effects.h"
+
+#define REVERB_COMBS            4
+#define REVERB_ALLPASSES        2
+
+// Line lengths in samples (Freeverb halved)
+static const uint16_t comb_length[REVERB_COMBS] = { 557, 593, 641, 677 };
+static const uint16_t allpass_length[REVERB_ALLPASSES] = { 277, 219 };
+#define REVERB_SAMPLES          (557+593+641+677+277+219)
+#define REVERB_LONGEST          677
+
+typedef struct {
+    int16_t  *line;
+    uint16_t length;
+    uint16_t index;
+    int32_t  store;             // Damping filter of the combs
+} Line_t;
+
+#if EFFECTS_DELAY_SAMPLES > 0
+static int16_t delay_ram[EFFECTS_DELAY_SAMPLES];
+#endif
+#if EFFECTS_REVERB
+static int16_t reverb_ram[REVERB_SAMPLES];
+#endif
+
+static uint32_t delay_write;    // Write position in delay_ram
+static uint32_t delay_length;   // Delay minus the block latency
+static int32_t  delay_feedback = EFFECTS_UNITY/2;
+static Line_t   combs[REVERB_COMBS];
+static Line_t   allpasses[REVERB_ALLPASSES];
+static int32_t  room = 26214;   // Comb feedback (0.8)
+static int32_t  damp = 8192;    // Comb damping (0.25)
+static uint32_t quiet;          // Samples since something was written to a line
+
+static inline int16_t sat16(int32_t x) {
+
+    if( x > INT16_MAX ) return INT16_MAX;
+    if( x < INT16_MIN ) return INT16_MIN;
+    return (int16_t) x;
+}
+
+/**
+ * @brief   Effects_Init
+ *
+ * @note    Clears the lines. The delay starts at one block
+ */
+void Effects_Init(void) {
+
+#if EFFECTS_DELAY_SAMPLES > 0
+    for(uint32_t i=0;i<EFFECTS_DELAY_SAMPLES;i++) delay_ram[i] = 0;
+#endif
+    delay_write = 0;
+    delay_length = 0;
+
+#if EFFECTS_REVERB
+    int16_t *p = reverb_ram;
+    for(uint32_t i=0;i<REVERB_SAMPLES;i++) reverb_ram[i] = 0;
+    for(unsigned c=0;c<REVERB_COMBS;c++) {
+        combs[c].line = p;
+        combs[c].length = comb_length[c];
+        combs[c].index = 0;
+        combs[c].store = 0;
+        p += comb_length[c];
+    }
+    for(unsigned a=0;a<REVERB_ALLPASSES;a++) {
+        allpasses[a].line = p;
+        allpasses[a].length = allpass_length[a];
+        allpasses[a].index = 0;
+        p += allpass_length[a];
+    }
+#endif
+    quiet = UINT32_MAX;
+}
+
+/**
+ * @brief   Returns the longest delay in samples
+ */
+uint32_t Effects_GetDelayCapacity(void) {
+
+    return EFFECTS_DELAY_SAMPLES;
+}
+
+/**
+ * @brief   Effects_SetDelayTime
+ *
+ * @param   samples Time from the send to the first echo
+ *
+ * @returns Time actually set, limited by the line and by the block latency
+ */
+uint32_t Effects_SetDelayTime(uint32_t samples) {
+
+    if( samples > EFFECTS_DELAY_SAMPLES ) samples = EFFECTS_DELAY_SAMPLES;
+    if( samples <= EFFECTS_BLOCK ) samples = EFFECTS_BLOCK + 1;
+    if( EFFECTS_DELAY_SAMPLES == 0 ) samples = EFFECTS_BLOCK;
+    delay_length = samples - EFFECTS_BLOCK;
+    return samples;
+}
+
+/**
+ * @brief   Sets the delay feedback (Q15, below EFFECTS_UNITY)
+ */
+void Effects_SetDelayFeedback(uint16_t feedback) {
+
+    if( feedback >= EFFECTS_UNITY ) feedback = EFFECTS_UNITY-1;
+    delay_feedback = feedback;
+}
+
+/**
+ * @brief   Sets the comb feedback and damping of the reverb (Q15)
+ */
+void Effects_SetReverb(uint16_t room_size, uint16_t damping) {
+
+    if( room_size >= EFFECTS_UNITY ) room_size = EFFECTS_UNITY-1;
+    if( damping >= EFFECTS_UNITY ) damping = EFFECTS_UNITY-1;
+    room = room_size;
+    damp = damping;
+}
+
+/**
+ * @brief   Returns 1 when every line holds only zeros
+ */
+int Effects_IsIdle(void) {
+uint32_t longest = REVERB_LONGEST;
+
+    if( EFFECTS_DELAY_SAMPLES > longest ) longest = EFFECTS_DELAY_SAMPLES;
+    return quiet >= longest;
+}
+
+/**
+ * @brief   Effects_ProcessBlock
+ *
+ * @note    Processes EFFECTS_BLOCK samples of both sends
+ *
+ * @param   delay_in    Delay send
+ * @param   reverb_in   Reverb send
+ * @param   out         Receives the sum of both returns
+ */
+RAMFUNC void Effects_ProcessBlock(const int32_t *delay_in, const int32_t *reverb_in,
+                                  int32_t *out) {
+int32_t written = 0;            // OR of everything written to the lines
+
+    for(uint32_t k=0;k<EFFECTS_BLOCK;k++) out[k] = 0;
+
+#if EFFECTS_DELAY_SAMPLES > 0
+    {
+        uint32_t w = delay_write;
+        uint32_t r = (w >= delay_length) ? w - delay_length
+                                         : w + EFFECTS_DELAY_SAMPLES - delay_length;
+        const int32_t fb = delay_feedback;
+        for(uint32_t k=0;k<EFFECTS_BLOCK;k++) {
+            int32_t y = delay_ram[r];
+            int16_t v = sat16(delay_in[k] + y*fb/EFFECTS_UNITY);
+            delay_ram[w] = v;
+            written |= v;
+            out[k] += y;
+            if( ++r == EFFECTS_DELAY_SAMPLES ) r = 0;
+            if( ++w == EFFECTS_DELAY_SAMPLES ) w = 0;
+        }
+        delay_write = w;
+    }
+#endif
+
+#if EFFECTS_REVERB
+    {
+        int32_t wet[EFFECTS_BLOCK];
+        const int32_t d1 = EFFECTS_UNITY - damp, d2 = damp, fb = room;
+
+        for(uint32_t k=0;k<EFFECTS_BLOCK;k++) wet[k] = 0;
+
+        // Combs in parallel. The input is scaled down so their sum fits
+        for(unsigned c=0;c<REVERB_COMBS;c++) {
+            Line_t *l = &combs[c];
+            int16_t *line = l->line;
+            uint32_t i = l->index;
+            int32_t store = l->store;
+            for(uint32_t k=0;k<EFFECTS_BLOCK;k++) {
+                int32_t y = line[i];
+                store = (y*d1 + store*d2)/EFFECTS_UNITY;
+                int16_t v = sat16((reverb_in[k]>>2) + store*fb/EFFECTS_UNITY);
+                line[i] = v;
+                written |= v;
+                wet[k] += y;
+                if( ++i == l->length ) i = 0;
+            }
+            l->index = (uint16_t) i;
+            l->store = store;
+        }
+
+        // Allpasses in series
+        for(unsigned a=0;a<REVERB_ALLPASSES;a++) {
+            Line_t *l = &allpasses[a];
+            int16_t *line = l->line;
+            uint32_t i = l->index;
+            for(uint32_t k=0;k<EFFECTS_BLOCK;k++) {
+                int32_t b = line[i];
+                int16_t v = sat16(wet[k] + b/2);
+                line[i] = v;
+                written |= v;
+                wet[k] = b - wet[k];
+                if( ++i == l->length ) i = 0;
+            }
+            l->index = (uint16_t) i;
+        }
+
+        for(uint32_t k=0;k<EFFECTS_BLOCK;k++) out[k] += wet[k];
+    }
+#endif
+
+    if( written ) {
+        quiet = 0;
+    } else if( quiet < UINT32_MAX - EFFECTS_BLOCK ) {
+        quiet += EFFECTS_BLOCK;
+    }
+}
@@ -0,0 +1,48 @@
+/** ***************************************************************************
+ * @file    effects.h
+ * @brief   Send effects: tempo synced delay and a small reverb
+ * @version 1.0
+ *
+ * @note    The player sums a delay send and a reverb send from the instrument
+ *          buses and hands them over one block at a time. The wet block comes
+ *          back one block later, so the delay line is shortened by
+ *          EFFECTS_BLOCK to keep the echo on the beat.
+ *
+ * @note    The reverb is a Schroeder network: four damped combs in parallel
+ *          followed by two allpasses, as in Freeverb, with the line lengths
+ *          halved for 22050 Hz.
+ *
+ * @note    The lines are reserved at compile time: EFFECTS_DELAY_SAMPLES
+ *          (int16_t) for the delay and EFFECTS_REVERB (0 or 1) for the
+ *          reverb, about 6 KB. They show up as delay_ram and reverb_ram in
+ *          'make size'.
+ *
+ * @note    Feedback products are divided, not shifted, so they round towards
+ *          zero and the lines really decay to silence. Effects_IsIdle tells
+ *          when every line is zero, and then the player skips the effects.
+******************************************************************************/
+#ifndef EFFECTS_H
+#define EFFECTS_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#ifndef EFFECTS_DELAY_SAMPLES
+#define EFFECTS_DELAY_SAMPLES   16384   // 0.74 s at 22050 Hz
+#endif
+#ifndef EFFECTS_REVERB
+#define EFFECTS_REVERB          1
+#endif
+
+#define EFFECTS_BLOCK           16      // Samples per block (and wet latency)
+#define EFFECTS_UNITY           32768   // Gain 1.0 in Q15
+
+void     Effects_Init(void);
+uint32_t Effects_SetDelayTime(uint32_t samples);
+uint32_t Effects_GetDelayCapacity(void);
+void     Effects_SetDelayFeedback(uint16_t feedback);
+void     Effects_SetReverb(uint16_t room, uint16_t damp);
+int      Effects_IsIdle(void);
+RAMFUNC void Effects_ProcessBlock(const int32_t *delay_in, const int32_t *reverb_in,
+                                  int32_t *out);
+
+#endif // EFFECTS_H
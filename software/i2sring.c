@@ -0,0 +1,84 @@
+/** ***************************************************************************
+ * @file    i2sring.c
+ * @brief   Block ring between the audio engine and the I2S DMA
+ * @version 1.0
+******************************************************************************/
+#include "i2sring.h"
+
+/*
+ * head is volatile, words[] is not, so the compiler may move the stores of
+ * the words after the store of head. The barrier keeps them before it. The
+ * Cortex-M3 does not reorder its own stores, so no DMB is needed.
+ */
+#define PUBLISH_BARRIER()       __asm volatile ("" ::: "memory")
+
+const uint16_t i2sring_zero[I2SRING_WORDS] = { 0 };
+
+/**
+ * @brief   Empties the ring and clears the counters
+ */
+void I2SRing_Reset(I2SRing_t *ring) {
+
+    ring->head = 0;
+    ring->tail = 0;
+    ring->underruns = 0;
+    ring->dropped = 0;
+    ring->started = 0;
+}
+
+/**
+ * @brief   I2SRing_Write
+ *
+ * @note    Called by the engine. The slot of block b is free once block
+ *          b-I2SRING_BLOCKS has left the DMA, that is two takes later
+ *
+ * @param   words   Interleaved left and right words
+ * @param   n       Number of words (even)
+ *
+ * @returns Words queued. The others are dropped
+ */
+RAMFUNC uint32_t I2SRing_Write(I2SRing_t *ring, const uint16_t *words, uint32_t n) {
+uint32_t h = ring->head;
+uint32_t limit = (ring->tail + I2SRING_BLOCKS - 2)*I2SRING_WORDS;
+uint32_t room = limit - h;
+
+    if( n > room ) {
+        uint32_t m = room & ~1u;        // Whole frames only
+        ring->dropped += n - m;
+        n = m;
+    }
+    for(uint32_t k=0;k<n;k++) {
+        uint32_t w = h + k;
+        ring->words[(w/I2SRING_WORDS)%I2SRING_BLOCKS][w%I2SRING_WORDS] = words[k];
+    }
+    PUBLISH_BARRIER();
+    ring->head = h + n;                 // Published after the words
+    return n;
+}
+
+/**
+ * @brief   I2SRing_Take
+ *
+ * @note    Called by the DMA interrupt when a block has been sent
+ *
+ * @returns The next complete block or i2sring_zero
+ */
+RAMFUNC const uint16_t *I2SRing_Take(I2SRing_t *ring) {
+uint32_t t = ring->tail;
+
+    if( ring->head - t*I2SRING_WORDS < I2SRING_WORDS ) {
+        if( ring->started ) ring->underruns++;
+        return i2sring_zero;
+    }
+    ring->started = 1;
+    ring->tail = t + 1;
+    return ring->words[t%I2SRING_BLOCKS];
+}
+
+/**
+ * @brief   Returns the words written and not taken yet
+ */
+uint32_t I2SRing_GetQueued(const I2SRing_t *ring) {
+
+    return ring->head - ring->tail*I2SRING_WORDS;
+}
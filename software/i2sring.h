@@ -0,0 +1,45 @@
+/** ***************************************************************************
+ * @file    i2sring.h
+ * @brief   Block ring between the audio engine and the I2S DMA
+ * @version 1.0
+ *
+ * @note    The engine writes interleaved left/right words. The DMA takes one
+ *          block of I2SRING_FRAMES frames at a time: two blocks are armed
+ *          (ping-pong), so a block is reused only after two more blocks were
+ *          taken. When the next block is not complete the DMA gets a block
+ *          of zeros and the underrun is counted; the words already written
+ *          wait for the next take, so frames are never split.
+ *
+ * @note    One writer and one reader, no lock: the writer only moves head
+ *          and the reader only moves tail. Counters wrap around modulo 2^32,
+ *          which is a multiple of the ring size.
+ *
+ * @note    Hardware independent, so the host stand-in (scripts/i2s_capture.c)
+ *          runs the same code as the firmware.
+******************************************************************************/
+#ifndef I2SRING_H
+#define I2SRING_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#define I2SRING_FRAMES          32      // Frames per DMA block
+#define I2SRING_BLOCKS          4       // Blocks in the ring (2 in the DMA)
+#define I2SRING_WORDS           (2*I2SRING_FRAMES)
+
+typedef struct {
+    uint16_t          words[I2SRING_BLOCKS][I2SRING_WORDS];
+    volatile uint32_t head;             // Words written
+    volatile uint32_t tail;             // Blocks taken
+    uint32_t          underruns;        // Zero blocks sent after the start
+    uint32_t          dropped;          // Words that did not fit
+    uint8_t           started;          // A block with data was taken
+} I2SRing_t;
+
+extern const uint16_t i2sring_zero[I2SRING_WORDS];
+
+void     I2SRing_Reset(I2SRing_t *ring);
+RAMFUNC uint32_t I2SRing_Write(I2SRing_t *ring, const uint16_t *words, uint32_t n);
+RAMFUNC const uint16_t *I2SRing_Take(I2SRing_t *ring);
+uint32_t I2SRing_GetQueued(const I2SRing_t *ring);
+
+#endif // I2SRING_H
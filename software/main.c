@@ -15,107 +15,249 @@
 #include "em_device.h"
 
 #include "button.h"
-#include "daconverter.h"
+#include "cycles.h"
+#include "deadline.h"
+#include "irqlevel.h"
 #include "lcd.h"
 #include "led.h"
-#include "pwm.h"
+#include "sleep.h"
+#include "swo.h"
 #include "touch.h"
 
 #include "player.h"
+#include "sched.h"
+#include "soundbank.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "attackcache.h"
+#include "audiofifo.h"
+#include "output.h"
+#include "upsample.h"
+#include "voicebudget.h"
 
-#define PWM_CHANNEL 1
-#define PWM_LOC PWM_LOC4 // PWM location for TIMER0 channel 1
-#define TIMER TIMER0
 #define TOUCH_PERIOD 100
 
-#define USE_DAC 0
-#define USE_PWM 1
+/* Output backends (see output.h). The one in use can be changed at run time
+   by writing output_select with the debugger. PWM2 is the dual PWM on PC0 and
+   PC1, which needs the weighted resistor pair described in output_pwm.c */
+static const Output_Backend_t *const outputs[] = {
+    &Output_PWM,
+    &Output_DualPWM,
+    &Output_DAC,
+    &Output_I2S,
+    &Output_Null
+};
+#define OUTPUTS (sizeof(outputs)/sizeof(outputs[0]))
+#define OUTPUT_DEFAULT 0 // PWM
+
+/* Output rate over the mixing rate: 1, or 2 to interpolate with a halfband
+   filter and update the output at 44.1 kHz. The images of the 22.05 kHz
+   stream are then far above the audio band, easy for the analog filter */
+#define OUTPUT_OVERSAMPLE 2
+
+#if OUTPUT_OVERSAMPLE != 1 && OUTPUT_OVERSAMPLE != 2
+#error "OUTPUT_OVERSAMPLE must be 1 or 2"
+#endif
 
-#if USE_DAC && USE_PWM
-#error "Cannot use both DAC and PWM at the same time"
+/* Mixing is done in PendSV, RENDER_BLOCK samples at a time, ahead of the
+   output. The FIFO holds AUDIOFIFO_FRAMES output frames (audiofifo.h); the
+   latency is the FIFO target, lowered with AudioFifo_SetTarget */
+#define RENDER_BLOCK 32
+
+/* Idle: when the player is paused or silent until the next step, the FIFO
+   is played out, the output is parked and SysTick slows down to one
+   interrupt every TOUCH_PERIOD samples, which wakes the main loop for the
+   touch task. SysTick only counts the time and restarts the output with
+   the FIFO target of silence when the next step is that far away; PendSV
+   moves the player forward without mixing and tells it when (idle_until),
+   so the player is never changed above PendSV. Gaps shorter than IDLE_MIN
+   samples (after the FIFO) keep running. With IDLE_DEEP the core sleeps in
+   EM2 while paused, see sleep_mode() */
+#define IDLE_MIN (2 * TOUCH_PERIOD)
+#ifndef IDLE_DEEP
+#define IDLE_DEEP 1
 #endif
 
-#if (!USE_DAC) && (!USE_PWM)
-#error "Must use either DAC or PWM"
+/* Constant time mixing (Player_SetConstantTime): every voice channel is
+   mixed at every sample and the effects never stop, so render_cycles_max
+   is the cost of every block, for timing analysis. Nothing is left to the
+   voice budget then, and the output never goes idle. Build with
+   -DMIX_CONSTANT_TIME=1 */
+#ifndef MIX_CONSTANT_TIME
+#define MIX_CONSTANT_TIME 0
 #endif
 
-const int TickDivisor = 22050; // Frequency of SysTick. 44.1 kHz equal to audio sample rate
+enum {
+    AUDIO_RUNNING,              // Mixing, one SysTick per output frame
+    AUDIO_DRAINING,             // No more mixing, playing the FIFO out
+    AUDIO_IDLE                  // Output parked, slow SysTick
+};
+
+/* Sound bank region, defined in efm32gg.ld */
+extern const uint8_t __soundbank_start__[];
+extern const uint8_t __soundbank_size__[];
+
+const int TickDivisor = 22050; // Mixing rate. SysTick runs at TickDivisor * OUTPUT_OVERSAMPLE
 Player_t *player;
 char current_bpm[4] = "000";
 
-
-void init_hardware_output()
-{
-#if USE_DAC
-    // Configure DAC
-    unsigned conf = DAC_VREF_VDD
-                   |DAC_SINGLE_ENDED_OUTPUT;
-    DAC_Init(conf,500000,DAC_CHN_LOC_0,DAC_CHN_LOC_0);
-#endif
-#if USE_PWM
-    // Configure PWM output
-    PWM_Init(TIMER, PWM_LOC, PWM_PARAMS_CH1_ENABLEPIN);
+/* Cycles spent in SysTick_Handler and per block in PendSV_Handler. Read
+   them with the debugger, along with the FIFO statistics in fifo */
+volatile uint32_t audio_isr_cycles_last = 0;
+volatile uint32_t audio_isr_cycles_max = 0;
+volatile uint32_t render_cycles_max = 0;
+AudioFifo_t fifo;
+
+/* Voice limit from the cycles of each rendered block (voicebudget.h):
+   effects, filters or a heavier output cost voices instead of deadlines.
+   The policy can be changed at run time with VoiceBudget_SetConfig; the
+   load, the limit and its moves are in budget.stats */
+VoiceBudget_t budget;
+static const VoiceBudget_Config_t budget_config = {
+    .high = VOICEBUDGET_HIGH,
+    .low  = VOICEBUDGET_LOW,
+    .hold = VOICEBUDGET_HOLD,
+    .min  = VOICEBUDGET_MIN,
+    .max  = CURRENT_SOUNDS_MAX
+};
+
+/* Entry latency of SysTick: cycles from the interrupt (reload of the
+   counter) to the first read in the handler, stacking included. A frame is
+   late when the next interrupt is already pending at the end of the
+   handler. Late frames, FIFO and I2S underruns and late steps are also
+   counted and logged by cause in deadline_log (deadline.h) */
+volatile uint32_t audio_latency_last = 0;
+volatile uint32_t audio_latency_max = 0;
+volatile uint32_t audio_late = 0;
+
+/* Time in each energy mode, updated by the monitor task */
+Sleep_Stats_t energy;
+
+#if TELEMETRY_ENABLE
+/* Counters sent by the monitor task on ITM port TELEMETRY_PORT (SWO pin),
+   decoded by scripts/swo_decode.py. Built with 'make TELEMETRY=1'. The
+   SWO clock stops in EM2, so nothing goes out while paused with IDLE_DEEP */
+#define TELEMETRY_PORT 1
+Telemetry_t telemetry;
 #endif
-}
 
-void output_audio_sample(int16_t sample)
+/* Main loop tasks (sched.h) on the RTC clock. Runs, overruns and times of
+   each task are in sched.tasks, for the debugger */
+#define TICKS(ms) ((ms) * SLEEP_TICKS_PER_SECOND / 1000)
+Sched_t sched;
+static int task_buttons;
+static int task_display;
+static int task_premix;
+
+/* Button presses, counted by the interrupt and handled by the buttons
+   task. Each counter has a single writer, so no lock is needed */
+static volatile uint8_t pause_requests = 0;   // Button 1
+static volatile uint8_t rythm_requests = 0;   // Button 2
+
+/* LCD contents, written by the display task */
+static char *display_text;
+static uint8_t display_bpm;
+static uint8_t display_dirty = 0;             // Bit 0: text, bit 1: BPM
+
+static volatile uint8_t audio_state = AUDIO_RUNNING;
+static uint32_t idle_period;      // Mixed samples per SysTick period while idle
+static volatile uint32_t idle_frames;     // Mixed samples passed while idle (SysTick)
+static uint32_t idle_skipped;             // Of those, skipped in the player (PendSV)
+static volatile uint32_t idle_until = 0;  // Restart at this idle_frames (PendSV)
+static volatile uint8_t resume_pending = 0; // Idle ended, PendSV skips the rest
+static uint32_t frame_cycles;     // SysTick period at the output rate
+
+static Upsample_t upsample;       // Mono or left channel
+static Upsample_t upsample_right;
+
+volatile unsigned output_select = OUTPUT_DEFAULT;
+static unsigned output_index = OUTPUT_DEFAULT;
+
+
+/**
+ * @brief   Keeps the mixer (PendSV) out while a task changes the player
+ *
+ * @note    SysTick and the other interrupts still run. The mixer runs at
+ *          render_unlock, which also lets it see a change made while idle
+ */
+static void render_lock(void)
 {
-#if USE_DAC
-    uint32_t shifted = (uint32_t)(sample + 32768);
-    DAC_SetOutput(0, shifted >> 4); // Convert to 12-bit value
-#endif
-#if USE_PWM
-    uint32_t shifted = (uint32_t)(sample + 32768);
-    PWM_Write(TIMER, 1, (unsigned int) (shifted >> 9));
-#endif
+    __set_BASEPRI(IRQ_BASEPRI(IRQ_LEVEL_DEFERRED));
 }
 
-void output_audio_sample_uint7_t(uint8_t sample)
+static void render_unlock(void)
 {
-#if USE_DAC
-    uint32_t shifted = (uint32_t)(sample) << 5; // Convert 7-bit to 12-bit
-    DAC_SetCombOutput(0, shifted);
-#endif
-#if USE_PWM
-    PWM_Write(TIMER, PWM_CHANNEL, sample);
-#endif
+    __set_BASEPRI(0);
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
 void set_rythm_display(char *rythm)
 {
-    LCD_WriteAlphanumericDisplay(rythm);
+    display_text = rythm;
+    display_dirty |= 1;
+    Sched_Signal(&sched, task_display);
 }
 
 void show_bpm_display(uint8_t bpm)
 {
-    current_bpm[0] = '0' + (bpm / 100);
-    current_bpm[1] = '0' + ((bpm / 10) % 10);
-    current_bpm[2] = '0' + (bpm % 10);
-    current_bpm[3] = '\0'; // Null-terminate the string
-    LCD_WriteNumericDisplay(current_bpm);
+    display_bpm = bpm;
+    display_dirty |= 2;
+    Sched_Signal(&sched, task_display);
 }
 
 void set_bpm_display(Player_t *player, uint8_t bpm)
 {
+    render_lock();
     Player_SetBPM(player, bpm);
+    render_unlock();
     show_bpm_display(bpm);
+    Sched_Signal(&sched, task_premix);
+}
+
+/**
+ * @brief   Switches to the output backend output_select
+ *
+ * @note    The audio interrupt keeps running: it submits to Output_Null
+ *          during the switch
+ */
+void init_hardware_output()
+{
+    unsigned i = output_select;
+
+    if (i >= OUTPUTS) i = OUTPUT_DEFAULT;
+    if (Output_Select(outputs[i], TickDivisor * OUTPUT_OVERSAMPLE) < 0) {
+        set_rythm_display("NO OUT");
+    }
+    output_index = output_select = i;
 }
 
+/**
+ * @brief   Buttons, at IRQ_LEVEL_BUTTON
+ *
+ * @note    Only counts the presses. The player and the LCD are changed by
+ *          the buttons task
+ */
 void buttoncallback(uint32_t v)
 {
     uint32_t b = Button_ReadReleased();
 
+    TRACE(TRACE_ISR_ENTER, TRACE_IRQ_GPIO);
     if (b & BUTTON1)
     {
-        LED_Toggle(LED1);
-        Player_TogglePause(player);
+        pause_requests++;
+        TRACE(TRACE_UI, TRACE_UI_PAUSE << 16);
     }
 
     if (b & BUTTON2)
     {
-        char *rythm = Player_NextRythm(player);
-        set_rythm_display(rythm);
+        rythm_requests++;
+        TRACE(TRACE_UI, TRACE_UI_RYTHM << 16);
     }
+
+    if (b) {
+        Sched_Signal(&sched, task_buttons);
+    }
+    TRACE(TRACE_ISR_EXIT, TRACE_IRQ_GPIO);
 }
 
 static const uint8_t sine_table[100] = {
@@ -133,8 +275,9 @@ static const uint8_t sine_table[100] = {
 void play_tone()
 {
     static int index = 0;
+    int16_t v = (int16_t)((sine_table[index] - 63) << 9);
 
-    output_audio_sample_uint7_t(sine_table[index]);
+    Output_Submit(&v, 0, 1);
 
     index++;
     if (index >= (sizeof(sine_table) / sizeof(sine_table[0])))
@@ -143,52 +286,435 @@ void play_tone()
     }
 }
 
-void SysTick_Handler(void)
+/**
+ * @brief   Touch task, periodic, about every TOUCH_PERIOD mixed samples
+ */
+static int touch_task(void *arg)
+{
+    Touch_PeriodicProcess();
+    unsigned int v = Touch_Read();
+    int touch_center = Touch_GetCenterOfTouch(v);
+    if (touch_center > 0) {
+        uint8_t bpm = 60 + (7 - touch_center) * 15;
+        if (bpm != display_bpm) {
+            TRACE(TRACE_UI, TRACE_UI_BPM << 16 | bpm);
+            set_bpm_display(player, bpm);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief   Buttons task, signaled by buttoncallback
+ */
+static int buttons_task(void *arg)
+{
+    static uint8_t pause_done = 0;
+    static uint8_t rythm_done = 0;
+
+    while (pause_done != pause_requests) {
+        pause_done++;
+        LED_Toggle(LED1);
+        render_lock();
+        Player_TogglePause(player);
+        render_unlock();
+    }
+    while (rythm_done != rythm_requests) {
+        rythm_done++;
+        render_lock();
+        char *name = Player_NextRythm(player);
+        render_unlock();
+        set_rythm_display(name);
+        Sched_Signal(&sched, task_premix);
+    }
+    return 0;
+}
+
+/**
+ * @brief   Display task: writes what changed to the LCD
+ */
+static int display_task(void *arg)
+{
+    uint8_t dirty = display_dirty;
+
+    display_dirty = 0;
+    if (dirty & 1) {
+        LCD_WriteAlphanumericDisplay(display_text);
+    }
+    if (dirty & 2) {
+        current_bpm[0] = '0' + (display_bpm / 100);
+        current_bpm[1] = '0' + ((display_bpm / 10) % 10);
+        current_bpm[2] = '0' + (display_bpm % 10);
+        current_bpm[3] = '\0'; // Null-terminate the string
+        LCD_WriteNumericDisplay(current_bpm);
+    }
+    return 0;
+}
+
+/**
+ * @brief   Premix task: renders the premixed loop in slices
+ *
+ * @note    Signaled when the pattern or the tempo changes. It stays
+ *          released while Player_Background has work
+ */
+static int premix_task(void *arg)
+{
+    return Player_Background(player);
+}
+
+#if TELEMETRY_ENABLE
+/**
+ * @brief   Port of the telemetry: one word to the ITM, never waits
+ */
+static int telemetry_write(uint32_t word)
+{
+    return SWO_TryWrite(TELEMETRY_PORT, word);
+}
+
+/**
+ * @brief   Sends the performance counters. Dropped if the last packet
+ *          is still going out
+ */
+static void send_telemetry(void)
+{
+    Telemetry_Stats_t s;
+    AudioFifo_Stats_t f;
+    Player_VoiceStats_t v;
+    uint32_t ticks = Sleep_GetTicks();
+
+    AudioFifo_GetStats(&fifo, &f);
+    Player_GetVoiceStats(player, &v);
+    s.time_ms = (ticks >> 15) * 1000 + (((ticks & 0x7FFF) * 1000) >> 15);
+    s.isr_cycles_last = audio_isr_cycles_last;
+    s.isr_cycles_max = audio_isr_cycles_max;
+    s.render_cycles_max = render_cycles_max;
+    s.latency_max = audio_latency_max;
+    s.voices = v.voices;
+    s.voice_limit = v.limit;
+    s.steals = v.steals;
+    s.render_load = budget.stats.load;
+    s.fifo_fill = f.fill;
+    s.fifo_low = f.low;
+    s.late_ticks = Deadline_GetCount(DEADLINE_TICK);
+    s.fifo_underruns = Deadline_GetCount(DEADLINE_FIFO);
+    s.i2s_underruns = Deadline_GetCount(DEADLINE_I2S);
+    s.late_steps = Deadline_GetCount(DEADLINE_STEP);
+    s.dropped = telemetry.dropped;
+    Telemetry_Send(&telemetry, TELEMETRY_STATS, &s, sizeof(s) / sizeof(uint32_t));
+}
+#endif
+
+/**
+ * @brief   Monitor task, periodic: output changed with the debugger,
+ *          energy statistics and telemetry
+ */
+static int monitor_task(void *arg)
+{
+    if (output_select != output_index) {
+        init_hardware_output();
+    }
+    Sleep_GetStats(&energy);
+#if TELEMETRY_ENABLE
+    send_telemetry();
+#endif
+    return 0;
+}
+
+/**
+ * @brief   Sets the SysTick period, starting now
+ *
+ * @note    The counter restarts a few cycles after the interrupt, which
+ *          is far below one sample
+ */
+static void systick_period(uint32_t cycles)
+{
+    SysTick->LOAD = cycles - 1;
+    SysTick->VAL = 0;
+}
+
+/**
+ * @brief   SysTick while idle. elapsed mixed samples have passed
+ *
+ * @note    The output restarts at idle_until, with the FIFO target of
+ *          silence in the FIFO. A step brought forward by the UI (new
+ *          rythm, resume) lowers idle_until and restarts it at the next
+ *          period
+ */
+RAMFUNC static void idle_tick(uint32_t elapsed)
+{
+    uint32_t frames = idle_frames + elapsed;
+    uint32_t until = idle_until;
+
+    idle_frames = frames;
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk; // The player follows in PendSV
+    if (frames < until) {
+        idle_period = until - frames;
+        if (idle_period > TOUCH_PERIOD) {
+            idle_period = TOUCH_PERIOD;
+        }
+        systick_period(idle_period * OUTPUT_OVERSAMPLE * frame_cycles);
+        return;
+    }
+
+    AudioFifo_PushSilence(&fifo, fifo.target / OUTPUT_OVERSAMPLE * OUTPUT_OVERSAMPLE);
+    Output_Resume();
+    systick_period(frame_cycles);
+    resume_pending = 1;
+    audio_state = AUDIO_RUNNING;
+}
+
+/**
+ * @brief   Moves the player over the idle time and sets idle_until
+ *
+ * @note    Runs in PendSV while draining or idle. Without a change from the
+ *          UI, idle_until stays the same
+ */
+RAMFUNC static void idle_plan(uint32_t lead)
 {
-    static int16_t value = 0;
-    static int touchcounter = 0;
+    uint32_t n = idle_frames - idle_skipped;
+
+    Player_Skip(player, n);
+    idle_skipped += n;
 
-    // /* Touch processing */
-    if( touchcounter != 0 ) {
-        touchcounter--;
+    uint32_t left = Player_GetIdleSamples(player);
+    if (left == PLAYER_IDLE_FOREVER) {
+        idle_until = UINT32_MAX;
     } else {
-        touchcounter = TOUCH_PERIOD;
-        Touch_PeriodicProcess();
-        unsigned int v = Touch_Read();
-        int touch_center = Touch_GetCenterOfTouch(v);
-        if (touch_center > 0) {
-            set_bpm_display(player, 60 + (7 - touch_center) * 15);
+        idle_until = idle_skipped + (left > lead ? left - lead : 0);
+    }
+}
+
+/**
+ * @brief   Returns the mode for the main loop to sleep in
+ *
+ * @note    EM2 only while paused and parked on an output that needs no
+ *          high frequency clock to stay quiet: a PWM pin would freeze at its
+ *          level. The buttons work in EM2, the touch slider (TIMER1) does not.
+ *          The periodic tasks wait; the periods lost are counted as skipped
+ */
+static unsigned sleep_mode(void)
+{
+#if IDLE_DEEP
+    const Output_Backend_t *out = outputs[output_index];
+
+    if (audio_state == AUDIO_IDLE && Player_GetIdleSamples(player) == PLAYER_IDLE_FOREVER
+        && (out == &Output_I2S || out == &Output_Null)) {
+        return SLEEP_EM2;
+    }
+#endif
+    return SLEEP_EM1;
+}
+
+/**
+ * @brief   Mixes blocks into the FIFO until it reaches its target
+ *
+ * @note    Runs in PendSV, below every other interrupt, when SysTick sees
+ *          room for a block. Each block is RENDER_BLOCK samples at
+ *          TickDivisor, so RENDER_BLOCK * OUTPUT_OVERSAMPLE output frames
+ *
+ * @note    When the player will be silent for a while, it stops and lets
+ *          SysTick play the FIFO out before going idle
+ */
+RAMFUNC void PendSV_Handler(void)
+{
+    static int16_t mixed[2][RENDER_BLOCK];
+    static int16_t out[2][RENDER_BLOCK * OUTPUT_OVERSAMPLE];
+    static int stereo = 0;
+    uint32_t lead = fifo.target / OUTPUT_OVERSAMPLE;
+
+    TRACE(TRACE_ISR_ENTER, TRACE_IRQ_PENDSV);
+    if (resume_pending) {
+        // The silence in the FIFO stands for lead samples of the player
+        uint32_t skip = idle_frames - idle_skipped + lead;
+        uint32_t left = Player_GetIdleSamples(player);
+        if (left < skip) {
+            Deadline_Record(DEADLINE_STEP, skip - left);
+        }
+        Player_Skip(player, skip);
+        idle_frames = 0;
+        idle_skipped = 0;
+        resume_pending = 0;
+        Upsample_Init(&upsample);
+        Upsample_Init(&upsample_right);
+    }
+    if (audio_state != AUDIO_RUNNING) {
+        idle_plan(lead);
+        TRACE(TRACE_ISR_EXIT, TRACE_IRQ_PENDSV);
+        return;
+    }
+
+    while (audio_state == AUDIO_RUNNING
+           && AudioFifo_GetDemand(&fifo) >= RENDER_BLOCK * OUTPUT_OVERSAMPLE) {
+        if (Player_GetIdleSamples(player) >= lead + IDLE_MIN) {
+            idle_plan(lead);
+            audio_state = AUDIO_DRAINING;
+            break;
+        }
+        uint32_t start = Cycles_Read();
+
+        int mono = Output_GetChannels() == 1;
+        int s = Player_Render(player, mixed[0], mono ? 0 : mixed[1], RENDER_BLOCK);
+        if (s && !stereo) {
+            // The right channel goes on from the state of the mono output
+            upsample_right = upsample;
+        }
+        stereo = s;
+#if OUTPUT_OVERSAMPLE == 2
+        Upsample_ProcessBlock(&upsample, mixed[0], out[0], RENDER_BLOCK);
+        if (stereo) {
+            Upsample_ProcessBlock(&upsample_right, mixed[1], out[1], RENDER_BLOCK);
+        }
+        AudioFifo_Push(&fifo, out[0], stereo ? out[1] : 0, RENDER_BLOCK * OUTPUT_OVERSAMPLE);
+#else
+        AudioFifo_Push(&fifo, mixed[0], stereo ? mixed[1] : 0, RENDER_BLOCK);
+#endif
+
+        uint32_t cycles = Cycles_Read() - start;
+        if (cycles > render_cycles_max) {
+            render_cycles_max = cycles;
+        }
+        if (!MIX_CONSTANT_TIME) {
+            Player_SetVoiceLimit(player,
+                                 VoiceBudget_Update(&budget, cycles, Player_GetVoices(player)));
         }
     }
+    TRACE(TRACE_ISR_EXIT, TRACE_IRQ_PENDSV);
+}
+
+/**
+ * @brief   Output interrupt: one frame from the FIFO per period
+ *
+ * @note    While idle it only runs every idle_period samples
+ */
+RAMFUNC void SysTick_Handler(void)
+{
+    // The counter reloaded when the interrupt was raised
+    uint32_t latency = SysTick->LOAD - SysTick->VAL;
+    int16_t left, right;
+    uint32_t start = Cycles_Read();
+
+    TRACE(TRACE_ISR_ENTER, TRACE_IRQ_SYSTICK);
+    audio_latency_last = latency;
+    if (latency > audio_latency_max) {
+        audio_latency_max = latency;
+    }
+
+    if (audio_state == AUDIO_IDLE) {
+        idle_tick(idle_period);
+        TRACE(TRACE_ISR_EXIT, TRACE_IRQ_SYSTICK);
+        return;
+    }
 
-    value = Player_Tick(player);
+    if (!AudioFifo_Pop(&fifo, &left, &right)) {
+        Deadline_Record(DEADLINE_FIFO, fifo.underruns);
+    }
+    Output_Submit(&left, left != right ? &right : 0, 1);
 
-    output_audio_sample(value);
+    if (audio_state == AUDIO_RUNNING
+        && AudioFifo_GetDemand(&fifo) >= RENDER_BLOCK * OUTPUT_OVERSAMPLE) {
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk; // Render in PendSV
+    }
 
     // play_tone();
+
+    uint32_t cycles = Cycles_Read() - start;
+    audio_isr_cycles_last = cycles;
+    if (cycles > audio_isr_cycles_max) {
+        audio_isr_cycles_max = cycles;
+    }
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        audio_late++;
+        Deadline_Record(DEADLINE_TICK, latency + cycles);
+    }
+
+    // FIFO played out: park the output and slow down
+    if (audio_state == AUDIO_DRAINING && AudioFifo_GetFill(&fifo) == 0) {
+        audio_state = AUDIO_IDLE;
+        Output_Park();
+        idle_tick(0);
+    }
+    TRACE(TRACE_ISR_EXIT, TRACE_IRQ_SYSTICK);
+}
+
+#ifdef LATENCY_TEST
+/* Load for the latency measurement (build with -DLATENCY_TEST): TIMER2
+   interrupts about 300 times a second at IRQ_LEVEL_UI and spins for
+   LATENCY_TEST_CYCLES, many output frames. audio_latency_max and
+   audio_late must read the same as without it */
+#define LATENCY_TEST_CYCLES 20000
+
+void TIMER2_IRQHandler(void)
+{
+    uint32_t start = Cycles_Read();
+
+    TIMER2->IFC = TIMER_IFC_OF;
+    while (Cycles_Read() - start < LATENCY_TEST_CYCLES) {}
 }
 
+static void latency_test_init(void)
+{
+    CMU->HFPERCLKEN0 |= CMU_HFPERCLKEN0_TIMER2;
+    TIMER2->CTRL = TIMER_CTRL_PRESC_DIV1024;
+    TIMER2->TOP = 150;                      // 48 MHz / 1024 / 151
+    TIMER2->IFC = _TIMER_IFC_MASK;
+    TIMER2->IEN = TIMER_IEN_OF;
+    NVIC_SetPriority(TIMER2_IRQn, IRQ_LEVEL_UI);
+    NVIC_ClearPendingIRQ(TIMER2_IRQn);
+    NVIC_EnableIRQ(TIMER2_IRQn);
+    TIMER2->CMD = TIMER_CMD_START;
+}
+#endif
+
 int main(void)
 {
     // Set clock source to external crystal: 48 MHz
     (void)SystemCoreClockSet(CLOCK_HFXO, 1, 1);
 
+    /* Cycle counter for audio ISR instrumentation and the trace */
+    Cycles_Init();
+    Trace_Init(SystemCoreClock);
+
+#if TELEMETRY_ENABLE
+    /* Performance counters on the SWO pin */
+    SWO_Init(1 << TELEMETRY_PORT);
+    Telemetry_Init(&telemetry, telemetry_write);
+#endif
+
     /* Configure LEDs */
     LED_Init(LED1);
 
+    /* Configure LCD */
+    LCD_Init();
+
+    /* Time base for the energy modes, on the LCD clock */
+    Sleep_Init();
+
+    /* Main loop tasks, on the same clock. Ties go to the first one */
+    Sched_Init(&sched, Sleep_GetTicks);
+    task_buttons = Sched_AddEvent(&sched, "buttons", buttons_task, 0, TICKS(20));
+    Sched_AddPeriodic(&sched, "touch", touch_task, 0,
+                      TOUCH_PERIOD * SLEEP_TICKS_PER_SECOND / TickDivisor,
+                      TOUCH_PERIOD * SLEEP_TICKS_PER_SECOND / TickDivisor);
+    task_display = Sched_AddEvent(&sched, "display", display_task, 0, TICKS(50));
+    Sched_AddPeriodic(&sched, "monitor", monitor_task, 0, TICKS(100), TICKS(100));
+    task_premix = Sched_AddEvent(&sched, "premix", premix_task, 0, TICKS(1000));
+
     /* Configure buttons */
     Button_Init(BUTTON1 | BUTTON2);
     Button_SetCallback(buttoncallback);
 
-    /* Configure LCD */
-    LCD_Init();
-
     /* Configure hardware output */
     init_hardware_output();
 
     // Configure touch input
     Touch_Init();
 
+    // Validate sound bank. Without it the player runs silently
+    int bank_ok = SoundBank_Init(__soundbank_start__, (uint32_t) __soundbank_size__) == 0;
+
+    // Copy the attack of each sound to RAM
+    AttackCache_Init();
+
     // Initialize player
     Player_Config_t config = {
         .sample_rate = TickDivisor,
@@ -197,17 +723,52 @@ int main(void)
     };
     player = Player_GetInstance();
     Player_Init(player, config);
+    Player_SetPremix(player, 1); // Only effective when built with PREMIX_BYTES
+    Player_SetLimiter(player, 1);
+    Player_SetConstantTime(player, MIX_CONSTANT_TIME);
+    Sched_Signal(&sched, task_premix);
     show_bpm_display(config.bpm);
-    set_rythm_display(Player_GetRythmName(player));
+    set_rythm_display(bank_ok ? Player_GetRythmName(player) : "NO BANK");
 
     /* Enable interrupts */
     __enable_irq();
 
-    /* Configure SysTick */
-    SysTick_Config(SystemCoreClock / TickDivisor);
+    /* Render ahead at the lowest priority, then configure SysTick */
+    Upsample_Init(&upsample);
+    Upsample_Init(&upsample_right);
+    AudioFifo_Init(&fifo);
+    VoiceBudget_Init(&budget, SystemCoreClock / TickDivisor * RENDER_BLOCK, &budget_config);
+    NVIC_SetPriority(PendSV_IRQn, IRQ_LEVEL_DEFERRED);
+    PendSV_Handler();
+    AudioFifo_ResetStats(&fifo);
+    Deadline_Reset();
+    VoiceBudget_ResetStats(&budget);
+    frame_cycles = SystemCoreClock / (TickDivisor * OUTPUT_OVERSAMPLE);
+    SysTick_Config(frame_cycles);
+    NVIC_SetPriority(SysTick_IRQn, IRQ_LEVEL_AUDIO); // SysTick_Config sets the lowest
+
+#ifdef LATENCY_TEST
+    latency_test_init();
+#endif
 
     while (1)
     {
-        __WFI(); // Enter low power state
+        // One task at a time, between audio interrupts
+        if (Sched_Run(&sched)) {
+            continue;
+        }
+
+#if TELEMETRY_ENABLE
+        // Rest of the last packet, as far as the ITM takes it
+        Telemetry_Pump(&telemetry);
+#endif
+
+        // Nothing released: enter low power state. The interrupt that
+        // wakes the core runs at __enable_irq
+        __disable_irq();
+        if (Sched_GetWait(&sched) != 0) {
+            Sleep_Enter(sleep_mode());
+        }
+        __enable_irq();
     }
 }
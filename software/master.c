@@ -0,0 +1,98 @@
+/** ***************************************************************************
+ * @file    master.c
+ * @brief   Master bus: soft clipper and peak limiter
+ * @version 1.0
+ *
+ * @note    Above the knee K the clipper follows y = K + R*d/(R+d), with
+ *          d = x-K and R = 32767-K. It has slope 1 at the knee and tends to
+ *          full scale, so there is no corner in the transfer curve.
+******************************************************************************/
+#include "master.h"
+
+/**
+ * @brief   Master_Init
+ *
+ * @note    Builds the soft clipper table. The limiter starts disabled
+ */
+void Master_Init(Master_t *master) {
+const uint32_t r = INT16_MAX - MASTER_KNEE;
+
+    for(uint32_t i=0;i<=MASTER_LUT_SIZE;i++) {
+        uint32_t d = i<<MASTER_LUT_SHIFT;
+        master->lut[i] = (int16_t) (MASTER_KNEE + (r*d)/(r+d));
+    }
+    master->limiter = 0;
+    master->count = 0;
+    master->peak = 0;
+    master->gain = MASTER_UNITY;
+    master->gain_step = 0;
+    master->target = MASTER_UNITY;
+}
+
+/**
+ * @brief   Enables or disables the limiter
+ *
+ * @note    The gain restarts at unity
+ */
+void Master_SetLimiter(Master_t *master, uint8_t enable) {
+
+    master->limiter = 0;
+    master->count = 0;
+    master->peak = 0;
+    master->gain = MASTER_UNITY;
+    master->gain_step = 0;
+    master->target = MASTER_UNITY;
+    master->limiter = enable;
+}
+
+/**
+ * @brief   Computes the gain ramp for the next block
+ *
+ * @note    Called by Master_Process at the end of each block
+ */
+RAMFUNC void Master_UpdateGain(Master_t *master) {
+int32_t gain = master->target;          // End of the ramp, without rounding
+int32_t wanted = MASTER_UNITY;
+
+    if( master->peak > MASTER_THRESHOLD )
+        wanted = (int32_t) (((uint32_t) MASTER_THRESHOLD<<15) / master->peak);
+
+    if( wanted < gain ) {
+        master->target = wanted;        // Attack: in one block
+    } else {
+        // Release, rounded up so unity is reached
+        master->target = gain + ((wanted - gain + (1<<MASTER_RELEASE_SHIFT) - 1)
+                                  >> MASTER_RELEASE_SHIFT);
+    }
+    master->gain = gain;
+    master->gain_step = (master->target - gain) >> MASTER_BLOCK_SHIFT;
+    master->peak = 0;
+    master->count = 0;
+}
+
+/**
+ * @brief   Moves the limiter over n samples of silence
+ *
+ * @note    Same state as n calls of Master_Process with zero, one block at a
+ *          time. Once the gain is back at unity only the count moves
+ */
+RAMFUNC void Master_Skip(Master_t *master, uint32_t n) {
+
+    if( !master->limiter )
+        return;
+    while( n > 0 ) {
+        if( master->gain == MASTER_UNITY && master->gain_step == 0
+         && master->target == MASTER_UNITY && master->peak == 0 ) {
+            master->count = (master->count + n) % MASTER_BLOCK;
+            return;
+        }
+        uint32_t m = MASTER_BLOCK - master->count;
+        if( m > n ) {
+            master->gain += master->gain_step * (int32_t) n;
+            master->count += n;
+            return;
+        }
+        n -= m;
+        Master_UpdateGain(master);
+    }
+}
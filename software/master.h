@@ -0,0 +1,180 @@
+/** ***************************************************************************
+ * @file    master.h
+ * @brief   Master bus: soft clipper and peak limiter
+ * @version 1.0
+ *
+ * @note    The soft clipper is the identity up to MASTER_KNEE and bends
+ *          smoothly towards full scale above it, read from a table with
+ *          linear interpolation. It replaces the hard clamp of the mix.
+ *
+ * @note    The limiter has no look-ahead. It measures the peak of each block
+ *          of MASTER_BLOCK samples and ramps the gain during the next block
+ *          so that peak would land on MASTER_THRESHOLD. The gain falls within
+ *          one block and recovers by 1/2^MASTER_RELEASE_SHIFT of the distance
+ *          per block. Transients it misses are caught by the soft clipper.
+ *
+ * @note    Per sample, the limiter costs a compare, a multiply and an add.
+ *          The division is done once per block.
+******************************************************************************/
+#ifndef MASTER_H
+#define MASTER_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#ifndef MASTER_KNEE
+#define MASTER_KNEE             24576   // Start of the soft clipping (-2.5 dBFS)
+#endif
+#ifndef MASTER_THRESHOLD
+#define MASTER_THRESHOLD        MASTER_KNEE
+#endif
+#ifndef MASTER_RELEASE_SHIFT
+#define MASTER_RELEASE_SHIFT    5       // About 45 ms at 22050 Hz
+#endif
+
+#define MASTER_LUT_SHIFT        9       // Input step of the table
+#define MASTER_LUT_SIZE         256     // Covers MASTER_KNEE + 131072
+#define MASTER_BLOCK_SHIFT      5
+#define MASTER_BLOCK            (1<<MASTER_BLOCK_SHIFT)
+#define MASTER_UNITY            32768   // Gain 1.0 in Q15
+
+typedef struct {
+    int16_t   lut[MASTER_LUT_SIZE+1];   // Soft clipper above the knee
+    uint8_t   limiter;                  // Limiter enabled
+    uint32_t  count;                    // Samples of the current block
+    uint32_t  peak;                     // Peak of the current block
+    int32_t   gain;                     // Current gain (Q15)
+    int32_t   gain_step;                // Gain ramp per sample
+    int32_t   target;                   // Gain at the end of the block
+} Master_t;
+
+void Master_Init(Master_t *master);
+void Master_SetLimiter(Master_t *master, uint8_t enable);
+RAMFUNC void Master_UpdateGain(Master_t *master);
+RAMFUNC void Master_Skip(Master_t *master, uint32_t n);
+
+/**
+ * @brief   Soft clips a sample of the mix to 16 bits, in constant time
+ *
+ * @note    The table is read at every level and the result is selected with
+ *          masks, so a sample above the knee costs the same as one below.
+ *          Past the end of the table it interpolates all the way to the last
+ *          entry. Same result as Master_SoftClip
+ */
+static inline int16_t Master_SoftClipFixed(const Master_t *master, int32_t x) {
+uint32_t a = (uint32_t) (x < 0 ? -x : x);
+uint32_t over = -(uint32_t) (a > MASTER_KNEE);         // All ones above the knee
+uint32_t d = (a - MASTER_KNEE) & over;
+uint32_t i = d>>MASTER_LUT_SHIFT;
+uint32_t frac = d & ((1<<MASTER_LUT_SHIFT)-1);
+uint32_t end = -(uint32_t) (i >= MASTER_LUT_SIZE);     // All ones past the table
+int32_t y0, y;
+
+    i = (i & ~end) | ((MASTER_LUT_SIZE-1) & end);
+    frac = (frac & ~end) | ((1u<<MASTER_LUT_SHIFT) & end);
+    y0 = master->lut[i];
+    y = y0 + (((master->lut[i+1] - y0) * (int32_t) frac) >> MASTER_LUT_SHIFT);
+    y = (int32_t) (((uint32_t) y & over) | (a & ~over));
+    return (int16_t) (x < 0 ? -y : y);
+}
+
+/**
+ * @brief   Soft clips a sample of the mix to 16 bits
+ */
+static inline int16_t Master_SoftClip(const Master_t *master, int32_t x) {
+uint32_t a = (uint32_t) (x < 0 ? -x : x);
+int32_t y;
+
+    if( a <= MASTER_KNEE )
+        return (int16_t) x;
+
+    a -= MASTER_KNEE;
+    uint32_t i = a>>MASTER_LUT_SHIFT;
+    if( i >= MASTER_LUT_SIZE ) {
+        y = master->lut[MASTER_LUT_SIZE];
+    } else {
+        int32_t y0 = master->lut[i];
+        int32_t frac = (int32_t) (a & ((1<<MASTER_LUT_SHIFT)-1));
+        y = y0 + (((master->lut[i+1] - y0) * frac) >> MASTER_LUT_SHIFT);
+    }
+    return (int16_t) (x < 0 ? -y : y);
+}
+
+/**
+ * @brief   Limiter of one sample of the mix, before the soft clipper
+ */
+static inline int32_t Master_Limit(Master_t *master, int32_t x) {
+
+    if( master->limiter ) {
+        uint32_t a = (uint32_t) (x < 0 ? -x : x);
+        if( a > master->peak ) master->peak = a;
+        x = (int32_t) (((int64_t) x * master->gain) >> 15);
+        master->gain += master->gain_step;
+        if( ++master->count >= MASTER_BLOCK )
+            Master_UpdateGain(master);
+    }
+    return x;
+}
+
+/**
+ * @brief   Limiter of one stereo sample, before the soft clipper
+ *
+ * @note    The limiter is linked: the gain follows the louder channel, so
+ *          the stereo image does not move
+ */
+static inline void Master_LimitStereo(Master_t *master, int32_t *l, int32_t *r) {
+
+    if( master->limiter ) {
+        uint32_t al = (uint32_t) (*l < 0 ? -*l : *l);
+        uint32_t ar = (uint32_t) (*r < 0 ? -*r : *r);
+        if( al > master->peak ) master->peak = al;
+        if( ar > master->peak ) master->peak = ar;
+        *l = (int32_t) (((int64_t) *l * master->gain) >> 15);
+        *r = (int32_t) (((int64_t) *r * master->gain) >> 15);
+        master->gain += master->gain_step;
+        if( ++master->count >= MASTER_BLOCK )
+            Master_UpdateGain(master);
+    }
+}
+
+/**
+ * @brief   Processes one sample of the mix through the master bus
+ */
+static inline int16_t Master_Process(Master_t *master, int32_t x) {
+
+    return Master_SoftClip(master, Master_Limit(master, x));
+}
+
+/**
+ * @brief   Master_Process with the soft clipper without branches
+ *
+ * @note    For the constant time mode of the player. Same result
+ */
+static inline int16_t Master_ProcessFixed(Master_t *master, int32_t x) {
+
+    return Master_SoftClipFixed(master, Master_Limit(master, x));
+}
+
+/**
+ * @brief   Processes one stereo sample through the master bus
+ */
+static inline void Master_ProcessStereo(Master_t *master, int32_t l, int32_t r,
+                                        int16_t *left, int16_t *right) {
+
+    Master_LimitStereo(master, &l, &r);
+    *left = Master_SoftClip(master, l);
+    *right = Master_SoftClip(master, r);
+}
+
+/**
+ * @brief   Master_ProcessStereo with the soft clipper without branches
+ */
+static inline void Master_ProcessStereoFixed(Master_t *master, int32_t l, int32_t r,
+                                             int16_t *left, int16_t *right) {
+
+    Master_LimitStereo(master, &l, &r);
+    *left = Master_SoftClipFixed(master, l);
+    *right = Master_SoftClipFixed(master, r);
+}
+
+#endif // MASTER_H
+
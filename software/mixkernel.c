@@ -0,0 +1,188 @@
+/** ***************************************************************************
+ * @file    mixkernel.c
+ * @brief   Inner loop of the voice mixer
+ * @version 1.0
+ *
+ * @note    Per frame the fast kernel is LDR, SXTH, ADD ASR #16, and the add
+ *          to the bus with ASR #1: about 5 cycles plus the load and store of
+ *          the bus, against about 12 for the reference loop with its two
+ *          halfword loads and the index arithmetic. The bus words stay in
+ *          registers across the 4 frames of an unrolled step.
+******************************************************************************/
+#include <string.h>
+#include "mixkernel.h"
+
+#if MIXKERNEL_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief   Loads a stereo frame as one word
+ *
+ * @note    memcpy is the portable way to read two int16_t as a word; GCC
+ *          turns it into a single LDR
+ */
+static inline uint32_t load_frame(const int16_t *frame) {
+uint32_t w;
+
+    memcpy(&w, frame, sizeof(w));
+    return w;
+}
+
+/**
+ * @brief   (L+R)/2 of a frame loaded as a word
+ *
+ * @note    The sum does not depend on which half is L, so it does not
+ *          depend on the byte order either
+ */
+static inline int32_t frame_mono(uint32_t w) {
+
+    return ((int32_t) (int16_t) w + ((int32_t) w >> 16)) >> 1;
+}
+
+/**
+ * @brief   Adds n frames to acc, one sample at a time (reference)
+ *
+ * @param   acc     n bus samples
+ * @param   frames  n interleaved stereo frames (2*n int16_t)
+ */
+RAMFUNC void MixKernel_AddRef(int32_t *acc, const int16_t *frames, uint32_t n) {
+
+    for(uint32_t k=0;k<n;k++) {
+        acc[k] += (frames[2*k] + frames[2*k+1]) >> 1;
+    }
+}
+
+/**
+ * @brief   Adds n frames to acc, a frame per load, 4 frames per step
+ *
+ * @param   acc     n bus samples
+ * @param   frames  n interleaved stereo frames, word aligned
+ */
+RAMFUNC void MixKernel_AddFast(int32_t *acc, const int16_t *frames, uint32_t n) {
+
+    while( n >= 4 ) {
+        uint32_t w0 = load_frame(frames);
+        uint32_t w1 = load_frame(frames+2);
+        uint32_t w2 = load_frame(frames+4);
+        uint32_t w3 = load_frame(frames+6);
+        int32_t a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+        acc[0] = a0 + frame_mono(w0);
+        acc[1] = a1 + frame_mono(w1);
+        acc[2] = a2 + frame_mono(w2);
+        acc[3] = a3 + frame_mono(w3);
+        acc += 4;
+        frames += 8;
+        n -= 4;
+    }
+    while( n-- ) {
+        *acc++ += frame_mono(load_frame(frames));
+        frames += 2;
+    }
+}
+
+#if MIXKERNEL_SIMD
+/**
+ * @brief   Adds n frames to acc, 8 frames per step with SSE2
+ *
+ * @note    The bus is 32 bits and the reference wraps, so the adds do not
+ *          saturate: a saturating add would not be bit identical
+ */
+__attribute__((target("sse2")))
+void MixKernel_AddSse2(int32_t *acc, const int16_t *frames, uint32_t n) {
+const __m128i ones = _mm_set1_epi16(1);
+
+    while( n >= 8 ) {
+        __m128i f0 = _mm_loadu_si128((const __m128i *) frames);
+        __m128i f1 = _mm_loadu_si128((const __m128i *) (frames+8));
+        __m128i m0 = _mm_srai_epi32(_mm_madd_epi16(f0, ones), 1);
+        __m128i m1 = _mm_srai_epi32(_mm_madd_epi16(f1, ones), 1);
+        __m128i a0 = _mm_loadu_si128((const __m128i *) acc);
+        __m128i a1 = _mm_loadu_si128((const __m128i *) (acc+4));
+        _mm_storeu_si128((__m128i *) acc, _mm_add_epi32(a0, m0));
+        _mm_storeu_si128((__m128i *) (acc+4), _mm_add_epi32(a1, m1));
+        acc += 8;
+        frames += 16;
+        n -= 8;
+    }
+    MixKernel_AddFast(acc, frames, n);
+}
+
+/**
+ * @brief   Adds n frames to acc, 16 frames per step with AVX2
+ */
+__attribute__((target("avx2")))
+void MixKernel_AddAvx2(int32_t *acc, const int16_t *frames, uint32_t n) {
+const __m256i ones = _mm256_set1_epi16(1);
+
+    while( n >= 16 ) {
+        __m256i f0 = _mm256_loadu_si256((const __m256i *) frames);
+        __m256i f1 = _mm256_loadu_si256((const __m256i *) (frames+16));
+        __m256i m0 = _mm256_srai_epi32(_mm256_madd_epi16(f0, ones), 1);
+        __m256i m1 = _mm256_srai_epi32(_mm256_madd_epi16(f1, ones), 1);
+        __m256i a0 = _mm256_loadu_si256((const __m256i *) acc);
+        __m256i a1 = _mm256_loadu_si256((const __m256i *) (acc+8));
+        _mm256_storeu_si256((__m256i *) acc, _mm256_add_epi32(a0, m0));
+        _mm256_storeu_si256((__m256i *) (acc+8), _mm256_add_epi32(a1, m1));
+        acc += 16;
+        frames += 32;
+        n -= 16;
+    }
+    MixKernel_AddSse2(acc, frames, n);
+}
+
+/**
+ * @brief   Instruction sets of this processor used by the host kernels
+ *
+ * @returns MIXKERNEL_SSE2 | MIXKERNEL_AVX2, as present
+ */
+unsigned MixKernel_GetHostFeatures(void) {
+unsigned features = 0;
+
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("sse2") ) features |= MIXKERNEL_SSE2;
+    if( __builtin_cpu_supports("avx2") ) features |= MIXKERNEL_AVX2;
+    return features;
+}
+
+static void add_first(int32_t *acc, const int16_t *frames, uint32_t n);
+
+static void (*add_host)(int32_t *, const int16_t *, uint32_t) = add_first;
+static const char *host_name = "scalar";
+
+/**
+ * @brief   First call: picks the kernel, then runs it
+ */
+static void add_first(int32_t *acc, const int16_t *frames, uint32_t n) {
+unsigned features = MixKernel_GetHostFeatures();
+
+    if( features & MIXKERNEL_AVX2 ) {
+        add_host = MixKernel_AddAvx2;
+        host_name = "avx2";
+    } else if( features & MIXKERNEL_SSE2 ) {
+        add_host = MixKernel_AddSse2;
+        host_name = "sse2";
+    } else {
+        add_host = MixKernel_AddFast;
+    }
+    add_host(acc, frames, n);
+}
+
+/**
+ * @brief   Adds n frames to acc with the best kernel of the host
+ */
+void MixKernel_AddHost(int32_t *acc, const int16_t *frames, uint32_t n) {
+
+    add_host(acc, frames, n);
+}
+
+/**
+ * @brief   Kernel used by MixKernel_AddHost: "avx2", "sse2" or "scalar"
+ *
+ * @note    Picked on the first call, "scalar" before it
+ */
+const char *MixKernel_GetHostName(void) {
+
+    return host_name;
+}
+#endif
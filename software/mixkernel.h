@@ -0,0 +1,93 @@
+/** ***************************************************************************
+ * @file    mixkernel.h
+ * @brief   Inner loop of the voice mixer: adds a run of frames to a bus
+ * @version 1.0
+ *
+ * @note    A voice adds (L+R)/2 of each stereo frame to the bus of its
+ *          instrument, as the per sample mixer in player.c. Player_Render
+ *          calls the kernel once per voice and run of samples (voice major),
+ *          so the loop over the frames is the only one left in the hot path.
+ *
+ * @note    MixKernel_AddRef is the plain C loop, one sample at a time.
+ *          MixKernel_AddFast is written for the Cortex-M3: a frame is one
+ *          32 bit load (L in the low half, R in the high half), the halves
+ *          are added with SXTH and ADD ..., ASR #16, and the loop is
+ *          unrolled 4 times, with no branch inside. Both give the same
+ *          result for any input. The sound bank entries are word aligned
+ *          (SoundBank_Init checks it) and a voice always starts at an even
+ *          tick, so the loads are aligned.
+ *
+ * @note    MixKernel_Add is the one used by the player. Build with
+ *          -DMIXKERNEL_REFERENCE=1 to use the reference loop instead.
+ *          'make benchmark' checks that both are bit identical.
+ *
+ * @note    On x86 hosts (offline renders, scripts/local_test.c) it is
+ *          MixKernel_AddHost instead: AVX2 16 frames per step or SSE2 8
+ *          frames per step, whichever the processor has (the first call
+ *          picks it), and MixKernel_AddFast for the frames left and on
+ *          processors with neither. PMADDWD by ones gives L+R of each
+ *          frame as 32 bits, exact, so they are bit identical to the
+ *          reference too. -DMIXKERNEL_SIMD=0 leaves them out.
+ *
+ * @note    mixkernel.c is compiled with -O2 even in DEBUG builds (see the
+ *          Makefile): at -O0 the unrolled loop keeps everything in memory.
+******************************************************************************/
+#ifndef MIXKERNEL_H
+#define MIXKERNEL_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#ifndef MIXKERNEL_REFERENCE
+#define MIXKERNEL_REFERENCE     0
+#endif
+
+/* x86 hosts: SSE2 and AVX2 kernels, chosen at run time */
+#ifndef MIXKERNEL_SIMD
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MIXKERNEL_SIMD          1
+#else
+#define MIXKERNEL_SIMD          0
+#endif
+#endif
+
+#if MIXKERNEL_REFERENCE
+#define MixKernel_Add           MixKernel_AddRef
+#elif MIXKERNEL_SIMD
+#define MixKernel_Add           MixKernel_AddHost
+#else
+#define MixKernel_Add           MixKernel_AddFast
+#endif
+
+RAMFUNC void MixKernel_AddRef(int32_t *acc, const int16_t *frames, uint32_t n);
+RAMFUNC void MixKernel_AddFast(int32_t *acc, const int16_t *frames, uint32_t n);
+
+#if MIXKERNEL_SIMD
+enum {
+    MIXKERNEL_SSE2 = 0x01,
+    MIXKERNEL_AVX2 = 0x02,
+};
+
+void MixKernel_AddSse2(int32_t *acc, const int16_t *frames, uint32_t n);
+void MixKernel_AddAvx2(int32_t *acc, const int16_t *frames, uint32_t n);
+void MixKernel_AddHost(int32_t *acc, const int16_t *frames, uint32_t n);
+unsigned MixKernel_GetHostFeatures(void);
+const char *MixKernel_GetHostName(void);
+#endif
+
+/**
+ * @brief   Saturates to the int16_t range
+ *
+ * @note    One SSAT on the Cortex-M3, two compares elsewhere
+ */
+static inline int32_t MixKernel_Sat16(int32_t x) {
+#if defined(__arm__)
+    __asm ("ssat %0, #16, %1" : "=r" (x) : "r" (x));
+    return x;
+#else
+    if( x > INT16_MAX ) return INT16_MAX;
+    if( x < INT16_MIN ) return INT16_MIN;
+    return x;
+#endif
+}
+
+#endif // MIXKERNEL_H
@@ -0,0 +1,341 @@
+/** ***************************************************************************
+ * @file    output.c
+ * @brief   Audio output backends
+ * @version 1.1
+ *
+ * @note    Output_Select points the interrupt to Output_Null while the old
+ *          backend stops and the new one starts, so it can be called from
+ *          the main loop with the audio interrupt running.
+ *
+ * @note    Output_Park and Output_Resume run in the audio interrupt. During
+ *          a switch they only leave a request, which Output_Select applies
+ *          to the new backend when it is initialized. The hand-overs of
+ *          current and parked are done with every interrupt masked: SysTick
+ *          is at IRQ_LEVEL_AUDIO (0), which BASEPRI can not mask.
+******************************************************************************/
+#include "output.h"
+
+static const Output_Backend_t * volatile current = &Output_Null;
+static const Output_Backend_t * volatile parked = 0;   // Stopped by Output_Park
+static volatile uint8_t switching = 0;                  // Output_Select running
+static volatile uint8_t park_pending = 0;               // Park the new backend
+
+/**
+ * @brief   Masks every interrupt and returns the previous PRIMASK
+ */
+static inline uint32_t irq_save(void) {
+#if defined(__arm__)
+uint32_t primask;
+
+    __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+    return primask;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief   Restores the PRIMASK returned by irq_save
+ */
+static inline void irq_restore(uint32_t primask) {
+#if defined(__arm__)
+    __asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+#else
+    (void) primask;
+#endif
+}
+
+/**
+ * @brief   Output_Select
+ *
+ * @note    Stops the current backend, then initializes and starts the new one.
+ *          If the output was parked, or is parked during the switch, the new
+ *          backend is left parked and Output_Resume starts it
+ *
+ * @param   rate    Output rate in Hz
+ *
+ * @returns 0=OK, negative if the backend could not be initialized. The
+ *          output is then Output_Null
+ */
+int Output_Select(const Output_Backend_t *backend, unsigned rate) {
+const Output_Backend_t *old;
+uint32_t primask;
+
+    primask = irq_save();
+    old = current;
+    current = &Output_Null;
+    park_pending = (parked != 0);
+    parked = 0;
+    switching = 1;
+    irq_restore(primask);
+
+    old->stop();
+    int rc = backend->init(rate);
+
+    primask = irq_save();
+    switching = 0;
+    if( rc >= 0 ) {
+        if( park_pending ) {
+            parked = backend;
+        } else {
+            backend->start();
+            current = backend;
+        }
+    }
+    irq_restore(primask);
+    return (rc < 0) ? rc : 0;
+}
+
+/**
+ * @brief   Returns the current backend
+ */
+const Output_Backend_t *Output_Get(void) {
+
+    return current;
+}
+
+/**
+ * @brief   Returns the number of channels of the current backend
+ */
+unsigned Output_GetChannels(void) {
+
+    return current->channels;
+}
+
+/**
+ * @brief   Returns the samples submitted but not played yet
+ */
+uint32_t Output_GetLatency(void) {
+
+    return current->latency();
+}
+
+/**
+ * @brief   Stops the current backend. Output_Null takes its place
+ */
+void Output_Stop(void) {
+const Output_Backend_t *old;
+uint32_t primask;
+
+    primask = irq_save();
+    old = current;
+    current = &Output_Null;
+    parked = 0;
+    irq_restore(primask);
+    old->stop();
+}
+
+/**
+ * @brief   Parks the current backend at midscale while the engine is idle
+ *
+ * @note    Output_Null takes its place until Output_Resume. Runs in the
+ *          audio interrupt. Output_Null itself is never parked: during a
+ *          switch the request is left to Output_Select
+ */
+void Output_Park(void) {
+const Output_Backend_t *old = current;
+
+    if( old == &Output_Null ) {
+        if( switching ) park_pending = 1;
+        return;
+    }
+    current = &Output_Null;
+    parked = old;
+    old->stop();
+}
+
+/**
+ * @brief   Restarts the backend parked by Output_Park
+ *
+ * @note    Runs in the audio interrupt. During a switch it cancels a park
+ *          request, so Output_Select starts the new backend
+ */
+void Output_Resume(void) {
+const Output_Backend_t *backend = parked;
+
+    if( switching ) {
+        park_pending = 0;
+        return;
+    }
+    if( !backend || backend == &Output_Null )
+        return;
+    parked = 0;
+    backend->start();
+    current = backend;
+}
+
+/**
+ * @brief   Output_Submit
+ *
+ * @param   left    Samples of the left or only channel
+ * @param   right   Samples of the right channel or 0 for mono
+ * @param   n       Number of samples per channel
+ */
+RAMFUNC void Output_Submit(const int16_t *left, const int16_t *right, uint32_t n) {
+
+    current->submit(left, right, n);
+}
+
+/*
+ * Conversion kernels
+ */
+
+/**
+ * @brief   Requantizes to 12 bits and packs both channels for DAC0->COMBDATA
+ *
+ * @note    CH0 (left) in bits 11:0, CH1 (right) in bits 27:16. A mono block
+ *          (right == 0) uses rl for both channels
+ */
+RAMFUNC void Output_ConvertDAC(Requant_t *rl, Requant_t *rr, const int16_t *left,
+                               const int16_t *right, uint32_t *comb, uint32_t n) {
+
+    if( !right ) {
+        for(uint32_t k=0;k<n;k++) {
+            uint32_t v = Requant_Process(rl, left[k]);
+            comb[k] = (v<<16)|v;
+        }
+        return;
+    }
+    for(uint32_t k=0;k<n;k++) {
+        uint32_t l = Requant_Process(rl, left[k]);
+        uint32_t r = Requant_Process(rr, right[k]);
+        comb[k] = (r<<16)|l;
+    }
+}
+
+/**
+ * @brief   Requantizes to the resolution of the PWM (see Requant_Init)
+ */
+RAMFUNC void Output_ConvertPWM(Requant_t *r, const int16_t *in, uint16_t *code, uint32_t n) {
+
+    for(uint32_t k=0;k<n;k++) {
+        code[k] = (uint16_t) Requant_Process(r, in[k]);
+    }
+}
+
+/**
+ * @brief   Requantizes to 2*bits and splits the code for the weighted pair
+ *
+ * @note    High part in bits 15:0, low part in bits 31:16
+ */
+RAMFUNC void Output_ConvertDualPWM(Requant_t *r, const int16_t *in, uint32_t *pair,
+                                   unsigned bits, uint32_t n) {
+const uint32_t mask = (1u<<bits) - 1;
+
+    for(uint32_t k=0;k<n;k++) {
+        uint32_t v = Requant_Process(r, in[k]);
+        pair[k] = ((v&mask)<<16)|(v>>bits);
+    }
+}
+
+/**
+ * @brief   Interleaves left and right in the order they are sent on the bus
+ *
+ * @note    No requantization: I2S carries the 16 bits. A mono block is sent
+ *          on both channels
+ */
+RAMFUNC void Output_ConvertI2S(const int16_t *left, const int16_t *right,
+                               uint16_t *frames, uint32_t n) {
+
+    if( !right ) right = left;
+    for(uint32_t k=0;k<n;k++) {
+        frames[2*k]   = (uint16_t) left[k];
+        frames[2*k+1] = (uint16_t) right[k];
+    }
+}
+
+/*
+ * Null backend
+ */
+
+static int  null_init(unsigned rate) { (void) rate; return 0; }
+static void null_nop(void) {}
+static uint32_t null_latency(void) { return 0; }
+RAMFUNC static void null_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+
+    (void) left; (void) right; (void) n;
+}
+
+const Output_Backend_t Output_Null = {
+    .name     = "NULL",
+    .channels = 2,
+    .init     = null_init,
+    .start    = null_nop,
+    .submit   = null_submit,
+    .stop     = null_nop,
+    .latency  = null_latency
+};
+
+/*
+ * File backend
+ */
+
+static struct {
+    void   (*writer)(const int16_t *frames, uint32_t n, void *arg);
+    void    *arg;
+    uint8_t  channels;
+    uint32_t count;                             // Frames in buffer
+    int16_t  buffer[2*OUTPUT_FILE_FRAMES];
+} file = { 0, 0, 1, 0, {0} };
+
+/**
+ * @brief   Output_SetFileWriter
+ *
+ * @note    Output_File passes blocks of interleaved frames to writer. With
+ *          one channel the stereo samples are averaged
+ *
+ * @param   channels    1 or 2
+ */
+void Output_SetFileWriter(void (*writer)(const int16_t *frames, uint32_t n, void *arg),
+                          void *arg, unsigned channels) {
+
+    file.writer = writer;
+    file.arg = arg;
+    file.channels = (channels == 2) ? 2 : 1;
+    file.count = 0;
+}
+
+static void file_flush(void) {
+
+    if( file.count && file.writer )
+        file.writer(file.buffer, file.count, file.arg);
+    file.count = 0;
+}
+
+static int file_init(unsigned rate) {
+
+    (void) rate;
+    file.count = 0;
+    return file.writer ? 0 : -1;
+}
+
+static uint32_t file_latency(void) {
+
+    return file.count;
+}
+
+RAMFUNC static void file_submit(const int16_t *left, const int16_t *right, uint32_t n) {
+
+    for(uint32_t k=0;k<n;k++) {
+        int16_t l = left[k];
+        int16_t r = right ? right[k] : l;
+        if( file.channels == 2 ) {
+            file.buffer[2*file.count]   = l;
+            file.buffer[2*file.count+1] = r;
+        } else {
+            file.buffer[file.count] = (int16_t) ((l + r) >> 1);
+        }
+        if( ++file.count == OUTPUT_FILE_FRAMES )
+            file_flush();
+    }
+}
+
+const Output_Backend_t Output_File = {
+    .name     = "FILE",
+    .channels = 2,
+    .init     = file_init,
+    .start    = null_nop,
+    .submit   = file_submit,
+    .stop     = file_flush,
+    .latency  = file_latency
+};
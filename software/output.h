@@ -0,0 +1,84 @@
+/** ***************************************************************************
+ * @file    output.h
+ * @brief   Audio output backends
+ * @version 1.0
+ *
+ * @note    A backend takes blocks of 16 bit samples and puts them on a pin, a
+ *          bus or a file. The engine only calls Output_Submit, so the backend
+ *          can be changed at run time with Output_Select.
+ *
+ * @note    Backends:
+ *          - Output_DAC: both channels of DAC0 (PB11/PB12), 12 bits, stereo.
+ *          - Output_PWM: TIMER0 CC1 (PC0), 7 bits, mono.
+ *          - Output_DualPWM: TIMER0 CC1/CC2 (PC0/PC1), 14 bits, mono.
+ *          - Output_I2S: USART1 in I2S mode, 16 bits, stereo.
+ *          - Output_File: frames handed to a writer function (host).
+ *          - Output_Null: drops the samples.
+ *          The first four are in the firmware directory and only exist on
+ *          the target. Their conversion kernels are here, so the benchmark
+ *          measures them on the host.
+ *
+ * @note    The samples are submitted at the output rate. A mono sample has
+ *          right == 0. Backends with one channel ignore right, so the engine
+ *          should ask Output_GetChannels and mix mono for them.
+ *
+ * @note    DAC and PWM hold one sample: they are paced by the caller, one
+ *          sample per output period. I2S and File queue what they get.
+ *
+ * @note    While the engine has nothing to play, Output_Park stops the
+ *          backend at midscale and Output_Resume starts it again, without
+ *          a new init.
+******************************************************************************/
+#ifndef OUTPUT_H
+#define OUTPUT_H
+#include <stdint.h>
+#include "ramfunc.h"
+#include "requant.h"
+
+/* Requantization of the DAC and PWM outputs: REQUANT_TRUNCATE, or
+   REQUANT_DITHER and/or REQUANT_SHAPE1/REQUANT_SHAPE2 (see requant.h) */
+#ifndef OUTPUT_REQUANT
+#define OUTPUT_REQUANT          (REQUANT_DITHER|REQUANT_SHAPE2)
+#endif
+
+#define OUTPUT_FILE_FRAMES      256     // Frames buffered by Output_File
+
+typedef struct {
+    const char *name;
+    uint8_t     channels;                           // 1 or 2
+    int       (*init)(unsigned rate);               // Output rate in Hz
+    void      (*start)(void);
+    void      (*submit)(const int16_t *left, const int16_t *right, uint32_t n);
+    void      (*stop)(void);                        // Output parked at midscale
+    uint32_t  (*latency)(void);                     // Samples not yet played
+} Output_Backend_t;
+
+extern const Output_Backend_t Output_Null;
+extern const Output_Backend_t Output_File;
+extern const Output_Backend_t Output_DAC;
+extern const Output_Backend_t Output_PWM;
+extern const Output_Backend_t Output_DualPWM;
+extern const Output_Backend_t Output_I2S;
+
+int                     Output_Select(const Output_Backend_t *backend, unsigned rate);
+const Output_Backend_t *Output_Get(void);
+unsigned                Output_GetChannels(void);
+uint32_t                Output_GetLatency(void);
+void                    Output_Stop(void);
+void                    Output_Park(void);
+void                    Output_Resume(void);
+RAMFUNC void            Output_Submit(const int16_t *left, const int16_t *right, uint32_t n);
+
+void Output_SetFileWriter(void (*writer)(const int16_t *frames, uint32_t n, void *arg),
+                          void *arg, unsigned channels);
+
+/* Block conversion kernels, one per kind of output */
+RAMFUNC void Output_ConvertDAC(Requant_t *rl, Requant_t *rr, const int16_t *left,
+                               const int16_t *right, uint32_t *comb, uint32_t n);
+RAMFUNC void Output_ConvertPWM(Requant_t *r, const int16_t *in, uint16_t *code, uint32_t n);
+RAMFUNC void Output_ConvertDualPWM(Requant_t *r, const int16_t *in, uint32_t *pair,
+                                   unsigned bits, uint32_t n);
+RAMFUNC void Output_ConvertI2S(const int16_t *left, const int16_t *right,
+                               uint16_t *frames, uint32_t n);
+
+#endif // OUTPUT_H
@@ -1,6 +1,12 @@
 #include "player.h"
-#include "resampled_kick.h"
-#include "resampled_snare.h"
+#include "soundbank.h"
+#include "attackcache.h"
+#include "premix.h"
+#include "master.h"
+#include "biquad.h"
+#include "effects.h"
+#include "trace.h"
+#include "mixkernel.h"
 
 enum {
     bKICK  = 0x01,
@@ -8,10 +14,30 @@ enum {
     bHIHAT = 0x04,
 };
 
+typedef struct {
+    uint8_t mask;                // Bit of the instrument in the rythm pattern
+    uint8_t sound;               // Entry in the sound bank
+} Instrument_t;
+
+// Ordem de disparo quando vários instrumentos caem no mesmo passo.
+// Indexed by PLAYER_KICK, PLAYER_SNARE, ...
+static const Instrument_t instruments[PLAYER_INSTRUMENTS] = {
+    [PLAYER_KICK]  = { bKICK,  SOUNDBANK_KICK  },
+    [PLAYER_SNARE] = { bSNARE, SOUNDBANK_SNARE },
+    [PLAYER_HIHAT] = { bHIHAT, SOUNDBANK_SNARE }, // Usando SNARE como placeholder para HIHAT
+};
+#define INSTRUMENTS_N (sizeof(instruments)/sizeof(instruments[0]))
+
+// Samples mixed per call of the mixing kernel in Player_Render
+#define PLAYER_RUN_MAX 32
+
 typedef struct {
     uint32_t       tick;         // Current tick in the playback
-    const int16_t  *sound;       // Pointer to the sound data
+    const int16_t  *sound;       // Pointer to the segment being read (RAM attack or flash)
     uint32_t       sound_length; // Length of the sound data in samples
+    uint32_t       segment_end;  // Tick where the current segment ends
+    const int16_t  *tail;        // Sound data in flash, read after the attack
+    uint8_t        instrument;   // Bus the voice is mixed into
 } CurrentSounds_t;
 
 struct Player
@@ -21,11 +47,73 @@ struct Player
     uint8_t         bpm;                                // Beats per minute
     uint8_t         beats_per_bar;                      // Number of beats in a bar
     CurrentSounds_t current_sounds[CURRENT_SOUNDS_MAX]; // Pointer to currently playing sounds
+    uint8_t         voices;                             // Entries of current_sounds in use
+    uint8_t         voice_limit;                        // Voices allowed, up to CURRENT_SOUNDS_MAX
+    uint32_t        steals;                             // Voices cut by steal_voice
+    uint32_t        drops;                              // Hits without a channel
+    uint8_t         constant_time;                      // Every channel mixed, see Player_SetConstantTime
     const uint8_t   *rythm;                             // Pointer to the rythm pattern
     uint32_t        rythm_length;                       // Length of the rythm pattern
+    uint8_t         rythm_number;                       // Entry of the rythm table being played
+    uint8_t         pattern[PLAYER_STEPS_MAX];          // Editable copy of the rythm pattern
     uint8_t         rythm_index;                        // Em qual passo do ritmo estamos (substitui current_quarter_beat)
     uint32_t        samples_per_beat;                   // Valor pré-calculado de amostras por passo do ritmo
     uint32_t        samples_until_next_beat;            // Contador regressivo até a próxima batida};
+    uint32_t        loop_position;                      // Amostras desde o início do ciclo do ritmo
+    // Premixed loop. 'generation' is bumped by every change of pattern, tempo
+    // or kit, 'premix_generation' is the generation rendered in the buffer
+    Premix_t        premix;
+    uint8_t         premix_enabled;
+    volatile uint8_t  premix_active;                    // Playing from the buffer (written by Tick and Stop only)
+    volatile uint32_t generation;
+    volatile uint32_t premix_generation;                // Written by Player_Background only
+    uint32_t        premix_building;                    // Generation being rendered, 0 = none
+    uint32_t        premix_unusable;                    // Generation that does not fit the buffer
+    // The buffer holds the tails of the loop before, so it is entered only
+    // after a whole loop played live with nothing changed. 'touched' is
+    // bumped by every change (written by the main context only),
+    // 'loop_touched' is its value at the start of the loop (mixer only)
+    volatile uint32_t touched;
+    uint32_t        loop_touched;
+    // Step edits to be patched into the premixed loop (ToggleStep -> Background)
+    uint8_t         edits[PLAYER_EDITS_MAX][2];         // Step, instrument
+    volatile uint8_t edits_head;                        // Written by Player_ToggleStep only
+    volatile uint8_t edits_tail;                        // Written by Player_Background only
+    Master_t        master;                             // Soft clipper and limiter
+    // Filters. Voices are summed per instrument and each sum is filtered,
+    // which is the same as filtering every voice of that instrument
+    Biquad_Q15_t    bus_filter[PLAYER_INSTRUMENTS];
+    Biquad_Q31_t    master_filter;
+    uint8_t         bus_filtered;                       // Bit i: bus i has a filter
+    // Send effects. The sends of a block are collected here and processed
+    // together; the wet block is played during the next one
+    uint16_t        sends[PLAYER_SENDS][PLAYER_INSTRUMENTS]; // PLAYER_SEND_UNITY = 1.0
+    uint8_t         sending;                            // Some send is not zero
+    volatile uint8_t fx_running;                        // Effects are processed
+    uint8_t         delay_steps;                        // Delay time in steps
+    uint8_t         fx_index;                           // Position in the block
+    int32_t         fx_in[PLAYER_SENDS][EFFECTS_BLOCK];
+    int32_t         fx_out[EFFECTS_BLOCK];
+    // Stereo. Voices take the pan of their instrument, applied to its bus
+    int8_t          pan[PLAYER_INSTRUMENTS];            // -PLAYER_PAN_MAX (left) .. +PLAYER_PAN_MAX
+    uint16_t        pan_gain[PLAYER_INSTRUMENTS][2];    // Left, right (Q14)
+    uint8_t         panned;                             // Bit i: instrument i is not centred
+    Biquad_Q31_t    master_filter_right;
+    int32_t         run_bus[PLAYER_INSTRUMENTS][PLAYER_RUN_MAX]; // Buses of a run (Player_Render)
+};
+
+/**
+ * @brief   Constant power pan law, normalized to 1.0 at the centre (Q14)
+ *
+ * @note    sqrt(2)*cos(k/32 * pi/2). Left gain is entry PLAYER_PAN_MAX+pan,
+ *          right gain entry PLAYER_PAN_MAX-pan
+ */
+static const uint16_t pan_table[2*PLAYER_PAN_MAX+1] = {
+    23170, 23143, 23059, 22920, 22725, 22476, 22173, 21816,
+    21407, 20946, 20435, 19874, 19266, 18611, 17911, 17168,
+    16384, 15560, 14699, 13803, 12873, 11912, 10922,  9907,
+     8867,  7806,  6726,  5630,  4520,  3400,  2271,  1137,
+        0
 };
 
 static Player_t global_player; // memória estática
@@ -60,6 +148,23 @@ const Rythm_t rythms[] = {
     {"ROCK", rock_rythm, rock_rythm_length},
     {"FUNK", funk_rythm, funk_rythm_length},
 };
+#define RYTHMS_N (sizeof(rythms)/sizeof(rythms[0]))
+
+/**
+ * @brief   Copies a rythm of the table to the editable pattern
+ */
+static void load_rythm(Player_t *player, uint8_t number) {
+    uint32_t length = rythms[number].length;
+    if (length > PLAYER_STEPS_MAX) length = PLAYER_STEPS_MAX;
+
+    for (uint32_t s = 0; s < length; s++) {
+        player->pattern[s] = rythms[number].rythm[s];
+    }
+    player->rythm_number = number;
+    player->rythm = player->pattern;
+    player->rythm_length = length;
+    TRACE(TRACE_PATTERN, number);
+}
 
 void Player_Init(Player_t *player, Player_Config_t config)
 {
@@ -75,9 +180,16 @@ void Player_Init(Player_t *player, Player_Config_t config)
         player->current_sounds[i].sound = 0;
         player->current_sounds[i].sound_length = 0;
     }
+    player->voices = 0;
+    player->voice_limit = CURRENT_SOUNDS_MAX;
+    player->steals = 0;
+    player->drops = 0;
+    player->constant_time = 0;
+    for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
+        player->current_sounds[i].instrument = 0;     // Free channels still add to a bus
+    }
 
-    player->rythm = rythms[0].rythm;
-    player->rythm_length = rythms[0].length;
+    load_rythm(player, 0);
     player->rythm_index = 0;
 
     // OTMIZAÇÃO: Pré-calcula o número de amostras por batida do ritmo
@@ -85,23 +197,62 @@ void Player_Init(Player_t *player, Player_Config_t config)
     
     // Inicia o contador para disparar a primeira batida imediatamente.
     player->samples_until_next_beat = 0;
+    player->loop_position = 0;
+
+    player->premix_enabled = 0;
+    player->premix_active = 0;
+    player->premix_building = 0;
+    player->premix_unusable = 0;
+    player->premix_generation = 0;
+    player->generation = 1;
+    player->touched = 1;
+    player->loop_touched = 0;
+    player->edits_head = 0;
+    player->edits_tail = 0;
+
+    Master_Init(&player->master);
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+        Biquad_InitQ15(&player->bus_filter[i]);
+    }
+    Biquad_InitQ31(&player->master_filter);
+    player->bus_filtered = 0;
+
+    Effects_Init();
+    for (unsigned e = 0; e < PLAYER_SENDS; e++) {
+        for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+            player->sends[e][i] = 0;
+        }
+    }
+    player->sending = 0;
+    player->fx_running = 0;
+    player->fx_index = 0;
+    for (unsigned k = 0; k < EFFECTS_BLOCK; k++) {
+        player->fx_out[k] = 0;
+    }
+    Player_SetDelaySteps(player, 3); // Colcheia pontuada
+
+    Biquad_InitQ31(&player->master_filter_right);
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+        player->pan[i] = 0;
+        player->pan_gain[i][0] = pan_table[PLAYER_PAN_MAX];
+        player->pan_gain[i][1] = pan_table[PLAYER_PAN_MAX];
+    }
+    player->panned = 0;
 }
 
 char *Player_NextRythm(Player_t *player) {
     if (!player) return 0;
-    static int current_rythm_index = 0;
-    current_rythm_index = (current_rythm_index + 1) % (sizeof(rythms) / sizeof(rythms[0]));
-    player->rythm = rythms[current_rythm_index].rythm;
-    player->rythm_length = rythms[current_rythm_index].length;
+    load_rythm(player, (player->rythm_number + 1) % RYTHMS_N);
     
     // OTMIZAÇÃO: Reseta o estado do ritmo
     player->rythm_index = 0; 
     player->samples_until_next_beat = 0;
+    Player_InvalidatePremix(player);
     
-    return rythms[current_rythm_index].name;
+    return rythms[player->rythm_number].name;
 }
 
-uint8_t get_free_sound_channel(Player_t *player) {
+RAMFUNC uint8_t get_free_sound_channel(Player_t *player) {
     for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
         if (player->current_sounds[i].sound == 0) {
             return i;
@@ -110,76 +261,649 @@ uint8_t get_free_sound_channel(Player_t *player) {
     return CURRENT_SOUNDS_MAX;
 }
 
-int16_t Player_Tick(Player_t *player)
-{
-    if (!player || player->paused) return 0;
+/**
+ * @brief   get_free_sound_channel for the constant time mode
+ *
+ * @note    Every channel is scanned, so the cost does not depend on which
+ *          are free (see Player_SetConstantTime)
+ */
+RAMFUNC static uint8_t get_free_sound_channel_fixed(Player_t *player) {
+    uint8_t channel = CURRENT_SOUNDS_MAX;
 
-    if (player->samples_until_next_beat <= 0) {
-        // Reinicia o contador para a próxima batida. Usar '+=' previne drift.
-        player->samples_until_next_beat += player->samples_per_beat;
-
-        // Pega a batida atual do padrão de ritmo
-        uint8_t beat = player->rythm[player->rythm_index];
-        
-        if (beat & bKICK) {
-            uint8_t channel = get_free_sound_channel(player);
-            if (channel < CURRENT_SOUNDS_MAX) {
-                CurrentSounds_t *sound = &player->current_sounds[channel];
-                sound->tick = 0;
-                sound->sound = KICK;
-                sound->sound_length = sizeof(KICK) / sizeof(KICK[0]);
-            }
+    for (int i = CURRENT_SOUNDS_MAX - 1; i >= 0; i--) {
+        channel = (player->current_sounds[i].sound == 0) ? i : channel;
+    }
+    return channel;
+}
+
+/**
+ * @brief   Finds the voice that is most likely the quietest
+ *
+ * @note    Percussion decays, so the samples a voice has left tell its level
+ *          without reading it. Voices in the tail go first, the one nearest
+ *          to its end; voices still in the attack only when there is no tail
+ *
+ * @returns Channel of the voice, CURRENT_SOUNDS_MAX if no voice is playing
+ */
+RAMFUNC static uint8_t quietest_voice(const Player_t *player) {
+    uint8_t channel = CURRENT_SOUNDS_MAX;
+    uint32_t quietest = UINT32_MAX;
+
+    for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
+        const CurrentSounds_t *sound = &player->current_sounds[i];
+        uint32_t left = sound->sound_length - sound->tick;
+        if (sound->segment_end != sound->sound_length) left |= 0x80000000u; // Attack
+        if (sound->sound == 0) left = UINT32_MAX;                           // Free
+        if (left < quietest) {
+            quietest = left;
+            channel = i;
         }
-        if (beat & bSNARE) {
-            uint8_t channel = get_free_sound_channel(player);
-            if (channel < CURRENT_SOUNDS_MAX) {
-                CurrentSounds_t *sound = &player->current_sounds[channel];
-                sound->tick = 0;
-                sound->sound = SNARE;
-                sound->sound_length = sizeof(SNARE) / sizeof(SNARE[0]);
-            }
+    }
+    return channel;
+}
+
+/**
+ * @brief   Frees a voice found by quietest_voice
+ *
+ * @returns channel
+ */
+RAMFUNC static uint8_t free_voice(Player_t *player, uint8_t channel) {
+    if (channel < CURRENT_SOUNDS_MAX) {
+        player->current_sounds[channel].sound = 0;
+        player->voices--;
+        player->steals++;
+        TRACE(TRACE_VOICE_STEAL, channel);
+    }
+    return channel;
+}
+
+/**
+ * @brief   Frees the voice that is most likely the quietest
+ *
+ * @returns Channel freed, CURRENT_SOUNDS_MAX if no voice is playing
+ */
+RAMFUNC static uint8_t steal_voice(Player_t *player) {
+    return free_voice(player, quietest_voice(player));
+}
+
+/**
+ * @brief   Starts a voice of an instrument at the given tick
+ *
+ * @note    The attack is read from RAM and the tail from flash
+ *
+ * @note    In constant time mode every start does the same work: both
+ *          channel scans and the attack lookup, whatever it finds. A step
+ *          also calls it for the instruments it does not play, with
+ *          play = 0, which stops before anything changes
+ */
+RAMFUNC static void start_voice(Player_t *player, uint8_t instrument, uint32_t tick, int play) {
+    uint8_t index = instruments[instrument].sound;
+    uint32_t length;
+    const int16_t *data = SoundBank_GetSound(index, &length);
+    if (!data || tick >= length) return; // Sem banco de sons válido
+
+    uint32_t attack_length;
+    const int16_t *attack = AttackCache_Get(index, &attack_length);
+
+    // Over the limit the new hit replaces the quietest voice
+    uint8_t channel;
+    int steal = player->voices >= player->voice_limit;
+    if (player->constant_time) {
+        uint8_t quiet = quietest_voice(player);
+        uint8_t idle = get_free_sound_channel_fixed(player);
+        if (!play) return;
+        channel = steal ? free_voice(player, quiet) : idle;
+    } else {
+        channel = steal ? steal_voice(player) : get_free_sound_channel(player);
+    }
+    if (channel >= CURRENT_SOUNDS_MAX) {
+        player->drops++;
+        TRACE(TRACE_VOICE_DROP, instrument);
+        return;
+    }
+
+    CurrentSounds_t *sound = &player->current_sounds[channel];
+    player->voices++;
+    TRACE(TRACE_VOICE_START, instrument << 8 | channel);
+    sound->tick = tick;
+    sound->instrument = instrument;
+    sound->sound_length = length;
+    sound->tail = data;
+    if (attack && tick < attack_length) {
+        sound->segment_end = attack_length;
+        sound->sound = attack;
+    } else {
+        sound->segment_end = length;
+        sound->sound = data;
+    }
+}
+
+/**
+ * @brief   Leaves the premixed loop and goes back to live mixing
+ *
+ * @note    The voices that are sounding at the current loop position are
+ *          restarted at the right tick, so their tails are not cut
+ */
+RAMFUNC static void leave_premix(Player_t *player) {
+    const Premix_t *premix = &player->premix;
+    uint32_t pos = player->loop_position;
+
+    for (uint32_t h = 0; h < premix->hit_count; h++) {
+        const Premix_Hit_t *hit = &premix->hits[h];
+        uint32_t d = (pos >= hit->start) ? pos - hit->start
+                                         : pos + premix->length - hit->start;
+        for (uint32_t f = d; f < hit->frames; f += premix->length) {
+            start_voice(player, hit->instrument, 2 * f, 1);
+        }
+    }
+    player->premix_active = 0;
+    TRACE(TRACE_PREMIX, 0);
+}
+
+/**
+ * @brief   Collects the sends of one sample and returns the wet sample
+ *
+ * @note    Every EFFECTS_BLOCK samples the block is processed. Once the sends
+ *          are zero and the lines are silent, the effects stop
+ */
+RAMFUNC static int32_t effects_tick(Player_t *player, const int32_t *bus) {
+    uint32_t k = player->fx_index;
+    int32_t delay = 0, reverb = 0;
+
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+        delay  += bus[i] * player->sends[PLAYER_DELAY][i];
+        reverb += bus[i] * player->sends[PLAYER_REVERB][i];
+    }
+    player->fx_in[PLAYER_DELAY][k] = delay >> 8;
+    player->fx_in[PLAYER_REVERB][k] = reverb >> 8;
+    int32_t wet = player->fx_out[k];
+
+    if (++k == EFFECTS_BLOCK) {
+        k = 0;
+        Effects_ProcessBlock(player->fx_in[PLAYER_DELAY], player->fx_in[PLAYER_REVERB],
+                             player->fx_out);
+        if (!player->sending && Effects_IsIdle() && !player->constant_time) {
+            player->fx_running = 0;
         }
-        if (beat & bHIHAT) {
-            uint8_t channel = get_free_sound_channel(player);
-            if (channel < CURRENT_SOUNDS_MAX) {
-                CurrentSounds_t *sound = &player->current_sounds[channel];
-                sound->tick = 0;
-                sound->sound = SNARE; // Usando SNARE como placeholder para HIHAT
-                sound->sound_length = sizeof(SNARE) / sizeof(SNARE[0]);
+    }
+    player->fx_index = k;
+    return wet;
+}
+
+/**
+ * @brief   Mixes every channel into the buses, playing or not
+ *
+ * @note    Constant time: a free channel reads two zeros from 'silence'
+ *          (gain 0) and stands still; the ends of the attack and of the
+ *          sound are taken with masks instead of branches. One sample costs
+ *          the same with no voice or with CURRENT_SOUNDS_MAX of them, and
+ *          the result is the same as the loop over the playing voices
+ */
+static const int16_t silence[2] = { 0, 0 };
+
+RAMFUNC static inline void mix_lanes(Player_t *player, int32_t *bus) {
+    uint32_t ended = 0;
+
+    for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
+        CurrentSounds_t *sound = &player->current_sounds[i];
+        uintptr_t data = (uintptr_t) sound->sound;
+        uintptr_t on = -(uintptr_t) (data != 0);        // All ones while playing
+        const int16_t *src = (const int16_t *) ((data & on) | ((uintptr_t) silence & ~on));
+        uint32_t tick = sound->tick & (uint32_t) on;
+
+        bus[sound->instrument] += (src[tick] + src[tick+1]) >> 1;
+
+        tick += 2 & (uint32_t) on;
+        uintptr_t seg = on & -(uintptr_t) (tick >= sound->segment_end);
+        uintptr_t end = seg & -(uintptr_t) (tick >= sound->sound_length);
+        sound->sound = (const int16_t *) ((data & ~seg) | ((uintptr_t) sound->tail & seg & ~end));
+        sound->segment_end = (sound->segment_end & ~(uint32_t) seg)
+                           | (sound->sound_length & (uint32_t) seg);
+        sound->tick = tick;
+        ended += end & 1;
+        if (TRACE_ENABLE && end) TRACE(TRACE_VOICE_END, i);
+    }
+    player->voices -= ended;
+}
+
+/**
+ * @brief   Step of the pattern: starts the voices of the step
+ *
+ * @note    At the start of the cycle it switches to the premixed loop when
+ *          it is ready
+ */
+RAMFUNC static void next_step(Player_t *player)
+{
+    // Reinicia o contador para a próxima batida. Usar '+=' previne drift.
+    player->samples_until_next_beat += player->samples_per_beat;
+
+    // Início do ciclo: troca para o buffer pré-mixado se estiver pronto.
+    // As caudas do ciclo anterior já estão no buffer.
+    if (player->rythm_index == 0) {
+        uint32_t touched = player->touched;
+        int clean = (touched == player->loop_touched); // Loop before played as the buffer
+        player->loop_touched = touched;
+        player->loop_position = 0;
+        if (clean && !player->premix_active && player->premix_enabled
+            && player->premix_generation == player->generation
+            && player->edits_tail == player->edits_head
+            && !player->bus_filtered && !player->sending && !player->panned
+            && !player->constant_time) {
+            for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
+                player->current_sounds[i].sound = 0;
             }
+            player->voices = 0;
+            player->premix_active = 1;
+            TRACE(TRACE_PREMIX, 1);
         }
+    }
+
+    // Pega a batida atual do padrão de ritmo
+    uint8_t beat = player->rythm[player->rythm_index];
+    TRACE(TRACE_STEP, player->rythm_index << 8 | beat);
 
-        // Avança para o próximo passo do ritmo
-        player->rythm_index++;
-        if (player->rythm_index >= player->rythm_length) {
-            player->rythm_index = 0; // Volta para o começo
+    for (unsigned i = 0; i < INSTRUMENTS_N && !player->premix_active; i++) {
+        if (beat & instruments[i].mask) {
+            start_voice(player, i, 0, 1);
+        } else if (player->constant_time) {
+            start_voice(player, i, 0, 0);   // Same cost as a hit
         }
     }
 
-    player->samples_until_next_beat--;
+    // Avança para o próximo passo do ritmo
+    player->rythm_index++;
+    if (player->rythm_index >= player->rythm_length) {
+        player->rythm_index = 0; // Volta para o começo
+    }
+}
 
-    int32_t sound_to_play = 0;
-    for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
+/**
+ * @brief   Leaves the premixed loop if it no longer matches, and plays the
+ *          step when it is due
+ */
+RAMFUNC static inline void begin_sample(Player_t *player)
+{
+    // Padrão, andamento ou kit mudou: volta para a mixagem ao vivo
+    if (player->premix_active
+        && (player->premix_generation != player->generation || player->constant_time
+            || player->touched != player->loop_touched)) {
+        leave_premix(player);
+    }
+
+    if (player->samples_until_next_beat <= 0) {
+        next_step(player);
+    }
+}
+
+/**
+ * @brief   Sample of the premixed loop, 0 while mixing live
+ */
+RAMFUNC static inline int32_t premix_tick(Player_t *player)
+{
+    if (player->premix_active) {
+        return Premix_Read(&player->premix, player->loop_position++);
+    }
+    player->loop_position++;
+    return 0;
+}
+
+/**
+ * @brief   Mixes the playing voices into the buses, one sample
+ */
+RAMFUNC static inline void mix_voices(Player_t *player, int32_t *bus)
+{
+    // Sem vozes não há o que varrer
+    for (int i = 0; i < CURRENT_SOUNDS_MAX && player->voices; i++) {
         CurrentSounds_t *sound = &player->current_sounds[i];
         if (sound->sound != 0) {
-            sound_to_play += ((sound->sound[sound->tick] + sound->sound[sound->tick+1]) >> 1);
+            bus[sound->instrument] += ((sound->sound[sound->tick] + sound->sound[sound->tick+1]) >> 1);
             
             sound->tick += 2;
-            if (sound->tick >= sound->sound_length) {
-                sound->sound = 0;
+            if (sound->tick >= sound->segment_end) {
+                if (sound->tick >= sound->sound_length) {
+                    sound->sound = 0;
+                    player->voices--;
+                    TRACE(TRACE_VOICE_END, i);
+                } else {
+                    // Fim do ataque: mesmos índices, agora na flash
+                    sound->sound = sound->tail;
+                    sound->segment_end = sound->sound_length;
+                }
             }
         }
     }
-    
-    if (sound_to_play > INT16_MAX) {
-        return INT16_MAX;
-    } else if (sound_to_play < INT16_MIN) {
-        return INT16_MIN;
+}
+
+/**
+ * @brief   Mixes the playing voices into the buses, n samples
+ *
+ * @note    Voice major: each voice adds its frames with MixKernel_Add, cut
+ *          where its attack or its sound ends. Same sums as n calls of
+ *          mix_voices. No step may fall inside the n samples
+ *
+ * @param   n   Up to PLAYER_RUN_MAX
+ */
+RAMFUNC static void mix_voices_run(Player_t *player, uint32_t n)
+{
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+        for (uint32_t k = 0; k < n; k++) player->run_bus[i][k] = 0;
+    }
+
+    for (int i = 0; i < CURRENT_SOUNDS_MAX && player->voices; i++) {
+        CurrentSounds_t *sound = &player->current_sounds[i];
+        int32_t *acc = player->run_bus[sound->instrument];
+        uint32_t k = 0;
+        while (sound->sound != 0 && k < n) {
+            uint32_t frames = (sound->segment_end - sound->tick) >> 1;
+            if (frames > n - k) frames = n - k;
+            MixKernel_Add(&acc[k], &sound->sound[sound->tick], frames);
+            sound->tick += 2 * frames;
+            k += frames;
+            if (sound->tick >= sound->segment_end) {
+                if (sound->tick >= sound->sound_length) {
+                    sound->sound = 0;
+                    player->voices--;
+                    TRACE(TRACE_VOICE_END, i);
+                } else {
+                    sound->sound = sound->tail;
+                    sound->segment_end = sound->sound_length;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Buses to the output of one sample: filters, effects, pan and the
+ *          master filter, before the master bus
+ *
+ * @param   sound_to_play   Sample of the premixed loop
+ *
+ * @note    While every instrument is centred the mix is mono: only *left is
+ *          set and it returns 0. Otherwise it sets both and returns 1
+ */
+RAMFUNC static inline int mix_buses(Player_t *player, int32_t *bus, int32_t sound_to_play,
+                                    int32_t *left, int32_t *right)
+{
+    // Barramentos dos instrumentos, com filtro se houver
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS && player->bus_filtered; i++) {
+        if (player->bus_filtered & (1 << i)) {
+            int32_t x = MixKernel_Sat16(bus[i]);
+            bus[i] = Biquad_TickQ15(&player->bus_filter[i], (int16_t) x);
+        }
+    }
+    int32_t wet = 0;
+    if (player->fx_running) {
+        wet = effects_tick(player, bus);
+    }
+
+    // Caminho mono: todos os instrumentos no centro
+    if (!player->panned) {
+        for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+            sound_to_play += bus[i];
+        }
+        sound_to_play += wet;
+        if (player->master_filter.sections) {
+            sound_to_play = Biquad_TickQ31(&player->master_filter, sound_to_play);
+        }
+        *left = sound_to_play;
+        return 0;
+    }
+
+    int32_t l = sound_to_play + wet;
+    int32_t r = sound_to_play + wet;
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+        l += (int32_t) (((int64_t) bus[i] * player->pan_gain[i][0]) >> 14);
+        r += (int32_t) (((int64_t) bus[i] * player->pan_gain[i][1]) >> 14);
+    }
+    if (player->master_filter.sections) {
+        l = Biquad_TickQ31(&player->master_filter, l);
+        r = Biquad_TickQ31(&player->master_filter_right, r);
+    }
+    *left = l;
+    *right = r;
+    return 1;
+}
+
+/**
+ * @brief   Mixes one sample, before the master bus
+ *
+ * @note    While every instrument is centred the mix is mono: only *left is
+ *          set and it returns 0. Otherwise it sets both and returns 1
+ */
+RAMFUNC static inline int mix(Player_t *player, int32_t *left, int32_t *right)
+{
+    begin_sample(player);
+    player->samples_until_next_beat--;
+
+    int32_t sound_to_play = premix_tick(player);
+
+    int32_t bus[PLAYER_INSTRUMENTS] = {0};
+    if (player->constant_time) {
+        mix_lanes(player, bus);
+    } else if (!player->premix_active) {
+        mix_voices(player, bus);
+    }
+    return mix_buses(player, bus, sound_to_play, left, right);
+}
+
+RAMFUNC int16_t Player_Tick(Player_t *player)
+{
+    int32_t left, right;
+
+    if (!player || player->paused) return 0;
+
+    // Em estéreo, soma os dois canais
+    if (mix(player, &left, &right)) {
+        left = (left + right) >> 1;
     }
     
-    return (int16_t)sound_to_play;
+    // Saturação suave no lugar do corte seco
+    if (player->constant_time) return Master_ProcessFixed(&player->master, left);
+    return Master_Process(&player->master, left);
+}
+
+/**
+ * @brief   Plays one stereo sample
+ *
+ * @returns 0 if the sample is mono (left == right), 1 otherwise
+ */
+RAMFUNC int Player_TickStereo(Player_t *player, int16_t *left, int16_t *right)
+{
+    int32_t l, r;
+
+    if (!player || player->paused) {
+        *left = *right = 0;
+        return 0;
+    }
+
+    if (player->constant_time) {
+        if (!mix(player, &l, &r)) {
+            *left = *right = Master_ProcessFixed(&player->master, l);
+            return 0;
+        }
+        Master_ProcessStereoFixed(&player->master, l, r, left, right);
+        return 1;
+    }
+
+    if (!mix(player, &l, &r)) {
+        *left = *right = Master_Process(&player->master, l);
+        return 0;
+    }
+    Master_ProcessStereo(&player->master, l, r, left, right);
+    return 1;
+}
+
+/**
+ * @brief   Plays a block of n samples
+ *
+ * @note    The block is cut at the steps of the pattern and in runs of up
+ *          to PLAYER_RUN_MAX samples. In a run the voices are mixed one at
+ *          a time by the mixing kernel (mix_voices_run), then the buses go
+ *          through the rest of the chain sample by sample. The output is
+ *          the same as n calls of Player_TickStereo (or Player_Tick). In
+ *          constant time mode it is those calls
+ *
+ * @param   right   Right channel, or 0 to mix mono into left as Player_Tick
+ *
+ * @returns 1 if any sample of the block is stereo. Mono samples have
+ *          right == left
+ */
+RAMFUNC int Player_Render(Player_t *player, int16_t *left, int16_t *right, uint32_t n)
+{
+    int stereo = 0;
+
+    if (!player || player->paused || player->constant_time) {
+        if (!right) {
+            for (uint32_t k = 0; k < n; k++) left[k] = Player_Tick(player);
+            return 0;
+        }
+        for (uint32_t k = 0; k < n; k++) {
+            stereo |= Player_TickStereo(player, &left[k], &right[k]);
+        }
+        return stereo;
+    }
+
+    uint32_t k = 0;
+    while (k < n) {
+        begin_sample(player);
+        uint32_t run = n - k;
+        if (run > PLAYER_RUN_MAX) run = PLAYER_RUN_MAX;
+        if (run > player->samples_until_next_beat) run = player->samples_until_next_beat;
+        player->samples_until_next_beat -= run;
+
+        int live = !player->premix_active && player->voices;
+        if (live) {
+            mix_voices_run(player, run);
+        }
+        for (uint32_t j = 0; j < run; j++, k++) {
+            int32_t bus[PLAYER_INSTRUMENTS] = {0};
+            int32_t l, r;
+            if (live) {
+                for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) bus[i] = player->run_bus[i][j];
+            }
+            if (!mix_buses(player, bus, premix_tick(player), &l, &r)) {
+                left[k] = Master_Process(&player->master, l);
+                if (right) right[k] = left[k];
+            } else if (right) {
+                Master_ProcessStereo(&player->master, l, r, &left[k], &right[k]);
+                stereo = 1;
+            } else {
+                left[k] = Master_Process(&player->master, (l + r) >> 1);
+            }
+        }
+    }
+    return stereo;
+}
+
+/**
+ * @brief   Returns how many samples from now the player only plays silence
+ *
+ * @note    Silence means no voice, no premixed loop, effects stopped and
+ *          filters settled within PLAYER_IDLE_RESIDUE. It lasts until the
+ *          next step of the pattern
+ *
+ * @returns 0 if the player is sounding, PLAYER_IDLE_FOREVER while paused
+ */
+uint32_t Player_GetIdleSamples(Player_t *player) {
+    if (!player || player->paused) return PLAYER_IDLE_FOREVER;
+    if (player->voices || player->premix_active || player->fx_running) return 0;
+
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS && player->bus_filtered; i++) {
+        if ((player->bus_filtered & (1 << i))
+            && !Biquad_IsQuietQ15(&player->bus_filter[i], PLAYER_IDLE_RESIDUE)) return 0;
+    }
+    if (!Biquad_IsQuietQ31(&player->master_filter, PLAYER_IDLE_RESIDUE)
+        || !Biquad_IsQuietQ31(&player->master_filter_right, PLAYER_IDLE_RESIDUE)) return 0;
+
+    return player->samples_until_next_beat;
+}
+
+/**
+ * @brief   Live voices being mixed (0 while the premixed loop plays)
+ */
+uint8_t Player_GetVoices(Player_t *player) {
+    return player->premix_active ? 0 : player->voices;
+}
+
+/**
+ * @brief   Sets the number of voices mixed at once
+ *
+ * @note    Voices above the limit are stolen now, the quietest first, so
+ *          the next block already costs less. Called by the mixer with the
+ *          limit of the voice budget (voicebudget.h), in its own context
+ *
+ * @param   limit   1..CURRENT_SOUNDS_MAX, clamped
+ */
+RAMFUNC void Player_SetVoiceLimit(Player_t *player, unsigned limit) {
+    if (limit < 1) limit = 1;
+    if (limit > CURRENT_SOUNDS_MAX) limit = CURRENT_SOUNDS_MAX;
+    player->voice_limit = limit;
+    while (player->voices > limit) {
+        steal_voice(player);
+    }
 }
 
+/**
+ * @brief   Constant time mixing, for a worst case that is also the average
+ *
+ * @note    Every channel is mixed at every sample (mix_lanes), the effects
+ *          keep running and the premixed loop is not used, so the cost of a
+ *          block does not depend on the voices, the sends or the pattern.
+ *          A step starts every instrument, the ones it does not play
+ *          included (start_voice), and the soft clipper has no branch on
+ *          the level (Master_ProcessFixed). Only the blocks with a step
+ *          cost more, by the same amount for every step
+ *          The player is then never idle either. Costs the time of
+ *          CURRENT_SOUNDS_MAX voices all the time; the output is the same
+ *
+ * @param   enable  1 = constant time, 0 = skip what is silent (default)
+ */
+void Player_SetConstantTime(Player_t *player, uint8_t enable) {
+    if (!player) return;
+    player->constant_time = enable;
+    if (enable) player->fx_running = 1;
+}
+
+/**
+ * @brief   Voices, limit, steals and drops since Player_Init
+ */
+void Player_GetVoiceStats(Player_t *player, Player_VoiceStats_t *stats) {
+    stats->voices = Player_GetVoices(player);
+    stats->limit = player->voice_limit;
+    stats->steals = player->steals;
+    stats->drops = player->drops;
+}
+
+/**
+ * @brief   Moves the player n samples forward without mixing
+ *
+ * @note    For silence reported by Player_GetIdleSamples. It stops at the
+ *          next step, which is left for the mixer. The residue of the
+ *          filters is cleared and the limiter recovers as in silence
+ */
+RAMFUNC void Player_Skip(Player_t *player, uint32_t n) {
+    if (!player || player->paused || n == 0) return;
+
+    if (n > player->samples_until_next_beat) n = player->samples_until_next_beat;
+    player->samples_until_next_beat -= n;
+    player->loop_position += n;
+
+    for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+        Biquad_ClearQ15(&player->bus_filter[i]);
+    }
+    Biquad_ClearQ31(&player->master_filter);
+    Biquad_ClearQ31(&player->master_filter_right);
+    Master_Skip(&player->master, n);
+}
+
+/**
+ * @brief   Stops and rewinds the pattern, cutting every voice
+ *
+ * @note    Call it with the mixer stopped (render_lock in main.c). The
+ *          premixed loop is left too, and entered again only after a whole
+ *          loop played live, so no tail of the last loop is heard
+ */
 void Player_Stop(Player_t *player)
 {
     if (!player) return;
@@ -188,6 +912,10 @@ void Player_Stop(Player_t *player)
     for (int i = 0; i < CURRENT_SOUNDS_MAX; i++) {
         player->current_sounds[i].sound = 0;
     }
+    player->voices = 0;
+    // Sem as caudas do último ciclo: o buffer só volta depois de um ciclo ao vivo
+    player->premix_active = 0;
+    player->touched++;
     player->paused = 1;
 }
 
@@ -211,10 +939,8 @@ void Player_TogglePause(Player_t *player)
 
 char *Player_GetRythmName(Player_t *player) {
     if (!player) return 0;
-    for (int i = 0; i < sizeof(rythms) / sizeof(rythms[0]); i++) {
-        if (player->rythm == rythms[i].rythm) {
-            return rythms[i].name;
-        }
+    if (player->rythm_number < RYTHMS_N) {
+        return rythms[player->rythm_number].name;
     }
     return "Unknown";
 }
@@ -230,4 +956,279 @@ void Player_SetBPM(Player_t *player, uint8_t bpm) {
     // OTMIZAÇÃO: Ajusta o contador atual para manter a fase do ritmo
     // Esta divisão só acontece raramente (quando o usuário muda o BPM).
     player->samples_until_next_beat = (player->samples_until_next_beat * old_bpm) / bpm;
+    Player_SetDelaySteps(player, player->delay_steps);
+    Player_InvalidatePremix(player);
+}
+
+/**
+ * @brief   Sets the send of an instrument to an effect
+ *
+ * @param   effect  PLAYER_DELAY or PLAYER_REVERB
+ * @param   level   0 to PLAYER_SEND_UNITY
+ *
+ * @note    While some send is not zero, the premixed loop is not used
+ *
+ * @returns 0=OK, -1 if instrument or effect is invalid
+ */
+int Player_SetSend(Player_t *player, uint8_t instrument, uint8_t effect, uint16_t level) {
+    if (!player || instrument >= INSTRUMENTS_N || effect >= PLAYER_SENDS) return -1;
+    if (level > PLAYER_SEND_UNITY) level = PLAYER_SEND_UNITY;
+
+    player->sends[effect][instrument] = level;
+    uint8_t sending = 0;
+    for (unsigned e = 0; e < PLAYER_SENDS; e++) {
+        for (unsigned i = 0; i < PLAYER_INSTRUMENTS; i++) {
+            if (player->sends[e][i]) sending = 1;
+        }
+    }
+    if (sending != player->sending) {
+        player->sending = sending;
+        if (sending) player->fx_running = 1;
+        Player_InvalidatePremix(player);
+    }
+    return 0;
+}
+
+/**
+ * @brief   Sets the delay time in steps of the rythm
+ *
+ * @note    The time follows the tempo. If it does not fit in the delay line,
+ *          fewer steps are used
+ */
+void Player_SetDelaySteps(Player_t *player, uint8_t steps) {
+    if (!player || steps == 0) return;
+    player->delay_steps = steps;
+
+    uint32_t capacity = Effects_GetDelayCapacity();
+    while (steps > 1 && steps * player->samples_per_beat > capacity) {
+        steps--;
+    }
+    Effects_SetDelayTime(steps * player->samples_per_beat);
+}
+
+void Player_InvalidatePremix(Player_t *player) {
+    if (!player) return;
+    player->generation++;
+    player->touched++;
+}
+
+/**
+ * @brief   Turns an instrument on or off in one step of the pattern
+ *
+ * @note    The live mixer sees the change at once. The edit is queued for
+ *          Player_Background, which patches only the samples of that hit in
+ *          the premixed loop instead of rendering it again. If the queue is
+ *          full, the loop is rendered again.
+ *
+ * @note    A step already played this loop, or a tail already sounding,
+ *          would change at once in the buffer. So the mixer leaves it (the
+ *          edit is patched while it mixes live) and comes back after a
+ *          whole loop with the new pattern: the output is the same as with
+ *          live mixing only. For an editor UI; no control of the board
+ *          calls it yet ('make benchmark' does)
+ *
+ * @returns New state of the step (0 or 1), -1 if step or instrument is invalid
+ */
+int Player_ToggleStep(Player_t *player, uint8_t step, uint8_t instrument) {
+    if (!player || step >= player->rythm_length || instrument >= INSTRUMENTS_N) return -1;
+
+    player->pattern[step] ^= instruments[instrument].mask;
+    player->touched++;
+
+    uint8_t head = player->edits_head;
+    uint8_t next = (head + 1) % PLAYER_EDITS_MAX;
+    if (next == player->edits_tail) {
+        Player_InvalidatePremix(player);
+    } else {
+        player->edits[head][0] = step;
+        player->edits[head][1] = instrument;
+        player->edits_head = next; // Publica a edição
+    }
+    return Player_GetStep(player, step, instrument);
+}
+
+/**
+ * @brief   Returns 1 if the instrument plays in the step, 0 otherwise
+ */
+int Player_GetStep(Player_t *player, uint8_t step, uint8_t instrument) {
+    if (!player || step >= player->rythm_length || instrument >= INSTRUMENTS_N) return 0;
+    return (player->pattern[step] & instruments[instrument].mask) != 0;
+}
+
+/**
+ * @brief   Adds a precomputed section to the filter of a bus
+ *
+ * @note    bus is an instrument (PLAYER_KICK, ...) or PLAYER_MASTER. While an
+ *          instrument bus is filtered, the premixed loop is not used
+ *
+ * @param   preset  BIQUAD_LP_2K, ... (see biquad.h)
+ *
+ * @returns 0=OK, -1 if the bus is full or there is no preset for the rate
+ */
+int Player_AddFilter(Player_t *player, uint8_t bus, unsigned preset) {
+    if (!player || bus > PLAYER_MASTER) return -1;
+
+    const Biquad_Coefs_t *coefs = Biquad_GetPreset(preset, player->sample_rate);
+    if (bus == PLAYER_MASTER) {
+        Biquad_AddSectionQ31(&player->master_filter_right, coefs);
+        return Biquad_AddSectionQ31(&player->master_filter, coefs);
+    }
+    if (Biquad_AddSectionQ15(&player->bus_filter[bus], coefs) < 0) return -1;
+    player->bus_filtered |= 1 << bus;
+    Player_InvalidatePremix(player);
+    return 0;
+}
+
+/**
+ * @brief   Removes all sections of the filter of a bus
+ */
+void Player_ClearFilter(Player_t *player, uint8_t bus) {
+    if (!player || bus > PLAYER_MASTER) return;
+
+    if (bus == PLAYER_MASTER) {
+        Biquad_InitQ31(&player->master_filter);
+        Biquad_InitQ31(&player->master_filter_right);
+        return;
+    }
+    player->bus_filtered &= ~(1 << bus);
+    Biquad_InitQ15(&player->bus_filter[bus]);
+    Player_InvalidatePremix(player);
+}
+
+/**
+ * @brief   Sets the pan of an instrument
+ *
+ * @param   pan -PLAYER_PAN_MAX (left) to PLAYER_PAN_MAX (right), 0 = centre
+ *
+ * @note    Constant power. While every instrument is centred, the player
+ *          stays on its mono path
+ *
+ * @returns 0=OK, -1 if the instrument is invalid
+ */
+int Player_SetPan(Player_t *player, uint8_t instrument, int8_t pan) {
+    if (!player || instrument >= INSTRUMENTS_N) return -1;
+    if (pan > PLAYER_PAN_MAX) pan = PLAYER_PAN_MAX;
+    if (pan < -PLAYER_PAN_MAX) pan = -PLAYER_PAN_MAX;
+
+    player->pan[instrument] = pan;
+    player->pan_gain[instrument][0] = pan_table[PLAYER_PAN_MAX + pan];
+    player->pan_gain[instrument][1] = pan_table[PLAYER_PAN_MAX - pan];
+
+    uint8_t panned = player->panned;
+    if (pan) {
+        panned |= 1 << instrument;
+    } else {
+        panned &= ~(1 << instrument);
+    }
+    if (panned && !player->panned) {
+        player->master_filter_right = player->master_filter; // Mesmo estado nos dois canais
+        Player_InvalidatePremix(player);
+    }
+    player->panned = panned;
+    return 0;
+}
+
+void Player_SetLimiter(Player_t *player, uint8_t enable) {
+    if (!player) return;
+    Master_SetLimiter(&player->master, enable);
+}
+
+void Player_SetPremix(Player_t *player, uint8_t enable) {
+    if (!player) return;
+    player->premix_enabled = enable;
+    if (!enable) Player_InvalidatePremix(player);
+}
+
+/**
+ * @brief   Renders the premixed loop in the background
+ *
+ * @note    Must be called from the lowest priority context (main loop).
+ *          It only touches the buffer while the player is not reading it
+ *          and publishes it by setting premix_generation when complete.
+ *          If anything changes in the meantime, the render starts over.
+ *
+ * @note    Step edits are patched into a ready loop once the mixer has
+ *          left it. An edit that arrives during a render restarts it.
+ *
+ * @returns 1 while there is rendering to do, 0 when idle
+ */
+int Player_Background(Player_t *player) {
+    if (!player) return 0;
+
+    Premix_t *premix = &player->premix;
+    uint32_t generation = player->generation;
+    // Patched only after the mixer has left the buffer (Player_ToggleStep)
+    if (player->edits_tail != player->edits_head && player->premix_active) return 1;
+    while (player->edits_tail != player->edits_head) {
+        uint8_t tail = player->edits_tail;
+        uint8_t step = player->edits[tail][0];
+        uint8_t instrument = player->edits[tail][1];
+
+        if (player->premix_generation == generation) {
+            const Instrument_t *inst = &instruments[instrument];
+            int hit = Premix_FindHit(premix, step, instrument);
+            if ((player->pattern[step] & inst->mask) && hit < 0) {
+                uint32_t length;
+                const int16_t *data = SoundBank_GetSound(inst->sound, &length);
+                if (data && Premix_PatchAdd(premix, step * player->samples_per_beat,
+                                            inst->sound, data, length, step, instrument) < 0) {
+                    Player_InvalidatePremix(player); // Sem espaço para a batida
+                }
+            } else if (!(player->pattern[step] & inst->mask) && hit >= 0) {
+                Premix_PatchRemove(premix, hit);
+            }
+        } else {
+            player->premix_building = 0; // A lista de batidas mudou
+        }
+        player->edits_tail = (tail + 1) % PLAYER_EDITS_MAX;
+    }
+
+    if (!player->premix_enabled || player->bus_filtered || player->sending
+        || player->panned) return 0;
+
+    generation = player->generation;
+    if (player->premix_generation == generation
+        || player->premix_unusable == generation) return 0;
+
+    // Wait until the audio path has left the old buffer
+    if (player->premix_active) return 1;
+
+    if (player->premix_building != generation) {
+        // Snapshot of the pattern. A change during the render bumps the
+        // generation and the result is discarded
+        const uint8_t *rythm = player->rythm;
+        uint32_t steps = player->rythm_length;
+        uint32_t spb = player->samples_per_beat;
+
+        player->premix_building = 0;
+        player->premix_unusable = generation; // Até a lista de batidas estar completa
+        if (Premix_Reset(premix, steps * spb) < 0) return 0; // Não cabe: fica ao vivo
+        for (uint32_t s = 0; s < steps; s++) {
+            for (unsigned i = 0; i < INSTRUMENTS_N; i++) {
+                if (!(rythm[s] & instruments[i].mask)) continue;
+                uint32_t length;
+                const int16_t *data = SoundBank_GetSound(instruments[i].sound, &length);
+                if (data && Premix_AddHit(premix, s * spb, instruments[i].sound, data, length,
+                                          s, i) < 0) {
+                    return 0; // Too many hits for the buffer
+                }
+            }
+        }
+        player->premix_unusable = 0;
+        player->premix_building = generation;
+    }
+
+    int done = Premix_Render(premix, PREMIX_BLOCK);
+    if (done < 0) {
+        player->premix_building = 0;
+        player->premix_unusable = generation; // Blocos altos demais: fica ao vivo
+        return 0;
+    }
+    if (!done) return 1;
+
+    player->premix_building = 0;
+    if (player->generation == generation) {
+        player->premix_generation = generation;
+    }
+    return 0;
 }
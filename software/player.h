@@ -6,14 +6,48 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 #include <stdint.h>
+#include "ramfunc.h"
 
-#define CURRENT_SOUNDS_MAX 20
+#ifndef CURRENT_SOUNDS_MAX
+#define CURRENT_SOUNDS_MAX 20   // Voice channels, the ceiling of the voice limit
+#endif
+#define PLAYER_STEPS_MAX   32   // Longest rythm pattern
+#define PLAYER_EDITS_MAX   8    // Step edits waiting to be patched into the premixed loop
+
+// Instruments of a rythm pattern
+enum {
+    PLAYER_KICK  = 0,
+    PLAYER_SNARE = 1,
+    PLAYER_HIHAT = 2,
+    PLAYER_INSTRUMENTS
+};
+#define PLAYER_MASTER      PLAYER_INSTRUMENTS // Bus after the sum of the instruments
+
+// Send effects
+enum {
+    PLAYER_DELAY  = 0,
+    PLAYER_REVERB = 1,
+    PLAYER_SENDS
+};
+#define PLAYER_SEND_UNITY  256
+#define PLAYER_PAN_MAX     16   // Pan steps to each side
+
+#define PLAYER_IDLE_FOREVER UINT32_MAX // Paused: silent until resumed
+#define PLAYER_IDLE_RESIDUE 2   // Filter state taken as silence (LSB)
 
 extern const uint8_t rock_rythm[];
 extern const uint32_t rock_rythm_length;
 
 typedef struct Player Player_t;
 
+// Voice accounting, see Player_SetVoiceLimit
+typedef struct {
+    uint8_t  voices;           // Live voices now
+    uint8_t  limit;            // Voices allowed
+    uint32_t steals;           // Voices cut to make room or to meet the limit
+    uint32_t drops;            // Hits not played
+} Player_VoiceStats_t;
+
 typedef struct {
     uint32_t sample_rate;      // Sample rate in Hz
     uint8_t  bpm;              // Beats per minute
@@ -23,7 +57,14 @@ typedef struct {
 // Functions to control playback
 Player_t *Player_GetInstance(void);
 void Player_Init(Player_t *player, Player_Config_t config);
-int16_t Player_Tick(Player_t *player);
+RAMFUNC int16_t Player_Tick(Player_t *player);
+RAMFUNC int Player_TickStereo(Player_t *player, int16_t *left, int16_t *right);
+RAMFUNC int Player_Render(Player_t *player, int16_t *left, int16_t *right, uint32_t n);
+uint32_t Player_GetIdleSamples(Player_t *player);
+uint8_t  Player_GetVoices(Player_t *player);
+RAMFUNC void Player_SetVoiceLimit(Player_t *player, unsigned limit);
+void Player_GetVoiceStats(Player_t *player, Player_VoiceStats_t *stats);
+RAMFUNC void Player_Skip(Player_t *player, uint32_t n);
 void Player_Stop(Player_t *player);
 void Player_Pause(Player_t *player);
 void Player_Resume(Player_t *player);
@@ -31,5 +72,17 @@ void Player_TogglePause(Player_t *player);
 char *Player_NextRythm(Player_t *player);
 char *Player_GetRythmName(Player_t *player);
 void Player_SetBPM(Player_t *player, uint8_t bpm);
+int  Player_ToggleStep(Player_t *player, uint8_t step, uint8_t instrument);
+int  Player_GetStep(Player_t *player, uint8_t step, uint8_t instrument);
+int  Player_AddFilter(Player_t *player, uint8_t bus, unsigned preset);
+void Player_ClearFilter(Player_t *player, uint8_t bus);
+int  Player_SetSend(Player_t *player, uint8_t instrument, uint8_t effect, uint16_t level);
+void Player_SetDelaySteps(Player_t *player, uint8_t steps);
+int  Player_SetPan(Player_t *player, uint8_t instrument, int8_t pan);
+void Player_SetLimiter(Player_t *player, uint8_t enable);
+void Player_SetPremix(Player_t *player, uint8_t enable);
+void Player_SetConstantTime(Player_t *player, uint8_t enable);
+void Player_InvalidatePremix(Player_t *player);
+int  Player_Background(Player_t *player);
 
 #endif // PLAYER_H
\ No newline at end of file
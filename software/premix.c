@@ -0,0 +1,388 @@
+/** ***************************************************************************
+ * @file    premix.c
+ * @brief   Premixed loop buffer
+ * @version 1.2
+ *
+ * @note    Sample i of the loop is the sum of every hit h whose sound covers
+ *          it, counting the wraps: frames (i-start) mod length + k*length,
+ *          for k = 0, 1, ... while inside the sound. Each frame is the mean
+ *          of left and right, exactly as the live mixer computes it.
+ *
+ * @note    The peak of a hit in a block is the sum, over the wraps k, of the
+ *          largest magnitude of its frames in that block. Render and patch
+ *          compute it the same way, so removing a hit restores the bound.
+ *
+ * @note    The loop is rendered and patched only while the player is not
+ *          reading it, so the buffer, the bounds and the 32 bit slots are
+ *          always consistent when Premix_Read runs.
+******************************************************************************/
+#include "premix.h"
+
+#if PREMIX_BYTES > 0
+#define PREMIX_CAPACITY (PREMIX_BYTES/sizeof(int16_t))
+static int16_t  premix_ram[PREMIX_CAPACITY] __attribute__((aligned(4)));
+static uint32_t premix_bound[(PREMIX_CAPACITY+PREMIX_BLOCK-1)/PREMIX_BLOCK];
+static uint8_t  premix_wide_of[(PREMIX_CAPACITY+PREMIX_BLOCK-1)/PREMIX_BLOCK];
+static int32_t  premix_wide[PREMIX_WIDE_BLOCKS][PREMIX_BLOCK];
+#else
+#define PREMIX_CAPACITY 0
+#endif
+
+#if PREMIX_WIDE_BLOCKS > 32 || PREMIX_WIDE_BLOCKS >= PREMIX_NARROW
+#error "PREMIX_WIDE_BLOCKS must fit in wide_used"
+#endif
+
+/**
+ * @brief   Frame f of a hit: mean of left and right
+ */
+static inline int32_t frame(const Premix_Hit_t *hit, uint32_t f) {
+
+    return (hit->data[2*f] + hit->data[2*f+1]) >> 1;
+}
+
+/**
+ * @brief   Frame of a hit played at loop position pos in the first wrap
+ */
+static inline uint32_t offset(const Premix_t *premix, const Premix_Hit_t *hit, uint32_t pos) {
+
+    return (pos >= hit->start) ? pos - hit->start
+                               : pos + premix->length - hit->start;
+}
+
+/**
+ * @brief   Peak of a hit in a block (see note at the top)
+ */
+static uint32_t hit_peak(const Premix_t *premix, const Premix_Hit_t *hit,
+                         uint32_t frames, uint32_t block) {
+const uint32_t length = premix->length;
+uint32_t first = block<<PREMIX_BLOCK_SHIFT;
+uint32_t n = length - first;
+uint32_t d0 = offset(premix, hit, first);
+uint32_t peak = 0;
+
+    if( n > PREMIX_BLOCK ) n = PREMIX_BLOCK;
+
+    for(uint32_t base=0;base<frames;base+=length) {
+        uint32_t m = 0;
+        uint32_t d = d0;
+        for(uint32_t j=0;j<n;j++) {
+            uint32_t f = base + d;
+            if( f < frames ) {
+                int32_t v = frame(hit, f);
+                uint32_t a = (uint32_t) (v < 0 ? -v : v);
+                if( a > m ) m = a;
+            }
+            if( ++d == length ) d = 0;
+        }
+        peak += m;
+    }
+    return peak;
+}
+
+/**
+ * @brief   Gives a block a 32 bit slot while one of its samples does not
+ *          fit in 16 bits, and frees it when they all fit again
+ *
+ * @note    The samples are only summed when the bound exceeds INT16_MAX.
+ *          The bound is the sum of the peaks, far above the real level when
+ *          long tails overlap, so most of those blocks still fit
+ *
+ * @param   exact   Exact samples of the block, or null to sum them from
+ *                  the hit list
+ *
+ * @returns 0=OK, -1 if every slot is in use
+ */
+static int set_wide(Premix_t *premix, uint32_t block, const int32_t *exact) {
+int32_t sum[PREMIX_BLOCK];
+uint32_t first = block<<PREMIX_BLOCK_SHIFT;
+uint32_t n = premix->length - first;
+unsigned slot = premix->wide_of[block];
+int loud = 0;
+
+    if( n > PREMIX_BLOCK ) n = PREMIX_BLOCK;
+
+    if( premix->bound[block] > INT16_MAX ) {
+        for(uint32_t j=0;j<n;j++) {
+            sum[j] = exact ? exact[j] : Premix_Sum(premix, first+j);
+            if( sum[j] > INT16_MAX || sum[j] < INT16_MIN ) loud = 1;
+        }
+    }
+
+    if( !loud ) {
+        if( slot != PREMIX_NARROW ) {
+            premix->wide_used &= ~(1u<<slot);
+            premix->wide_of[block] = PREMIX_NARROW;
+        }
+        return 0;
+    }
+
+    if( slot == PREMIX_NARROW ) {
+        for(slot=0;slot<PREMIX_WIDE_BLOCKS && (premix->wide_used>>slot)&1;slot++) {}
+        if( slot >= PREMIX_WIDE_BLOCKS )
+            return -1;
+        premix->wide_used |= 1u<<slot;
+        premix->wide_of[block] = slot;
+    }
+    for(uint32_t j=0;j<n;j++) premix->wide[slot][j] = sum[j];
+    return 0;
+}
+
+/**
+ * @brief   Adds (sign=1) or subtracts (sign=-1) a hit to the loop
+ *
+ * @note    Only the blocks covered by the hit are touched
+ *
+ * @returns 0=OK, -1 if a block needs a 32 bit slot and none is free
+ */
+static int patch(Premix_t *premix, const Premix_Hit_t *hit, uint32_t frames, int sign) {
+const uint32_t length = premix->length;
+const uint32_t last_block = (length-1)>>PREMIX_BLOCK_SHIFT;
+uint32_t first_block, nblocks;
+
+    if( frames >= length ) {
+        first_block = 0;
+        nblocks = last_block + 1;
+    } else {
+        uint32_t end = hit->start + frames - 1;     // Last position, unwrapped
+        first_block = hit->start>>PREMIX_BLOCK_SHIFT;
+        if( end < length ) {
+            nblocks = (end>>PREMIX_BLOCK_SHIFT) - first_block + 1;
+        } else {
+            nblocks = (last_block - first_block + 1)
+                     + ((end - length)>>PREMIX_BLOCK_SHIFT) + 1;
+            if( nblocks > last_block + 1 ) nblocks = last_block + 1;
+        }
+    }
+
+    uint32_t pos = hit->start;
+    for(uint32_t f=0;f<frames;f++) {
+        int32_t v = sign*frame(hit, f);
+        premix->buffer[pos] = (int16_t) (uint16_t) (premix->buffer[pos] + v);
+        if( ++pos == length ) pos = 0;
+    }
+
+    int result = 0;
+    for(uint32_t i=0,b=first_block;i<nblocks;i++) {
+        uint32_t peak = hit_peak(premix, hit, frames, b);
+        premix->bound[b] = (sign > 0) ? premix->bound[b] + peak : premix->bound[b] - peak;
+        if( set_wide(premix, b, 0) < 0 ) result = -1;
+        if( ++b > last_block ) b = 0;
+    }
+    return result;
+}
+
+/**
+ * @brief   Returns the capacity of the buffer in samples
+ */
+uint32_t Premix_GetCapacity(void) {
+
+    return PREMIX_CAPACITY;
+}
+
+/**
+ * @brief   Premix_Reset
+ *
+ * @note    Starts a new loop. Hits must be added before rendering
+ *
+ * @param   length  Loop length in samples
+ *
+ * @returns 0=OK, -1 if the loop does not fit in the buffer
+ */
+int Premix_Reset(Premix_t *premix, uint32_t length) {
+
+    premix->buffer = 0;
+    premix->bound = 0;
+    premix->wide_of = 0;
+    premix->wide = 0;
+    premix->wide_used = 0;
+    premix->length = 0;
+    premix->rendered = 0;
+    premix->hit_count = 0;
+
+    if( length == 0 || length > PREMIX_CAPACITY )
+        return -1;
+
+#if PREMIX_BYTES > 0
+    premix->buffer = premix_ram;
+    premix->bound = premix_bound;
+    premix->wide_of = premix_wide_of;
+    premix->wide = premix_wide;
+    for(uint32_t b=0;b<=(length-1)>>PREMIX_BLOCK_SHIFT;b++) premix_wide_of[b] = PREMIX_NARROW;
+#endif
+    premix->length = length;
+    return 0;
+}
+
+/**
+ * @brief   Premix_AddHit
+ *
+ * @note    Adds a hit to a loop that is not rendered yet
+ *
+ * @param   start   Loop position where the sound starts
+ * @param   sound   Sound bank entry
+ * @param   data    Interleaved stereo samples
+ * @param   length  Length in int16_t
+ * @param   step    Step of the pattern
+ * @param   instrument Instrument of the step
+ *
+ * @returns Index of the hit, -1 if there is no room for it
+ */
+int Premix_AddHit(Premix_t *premix, uint32_t start, uint8_t sound,
+                  const int16_t *data, uint32_t length,
+                  uint8_t step, uint8_t instrument) {
+uint32_t i;
+
+    if( start >= premix->length || length < 2 )
+        return -1;
+
+    // Reuse a retired slot
+    for(i=0;i<premix->hit_count && premix->hits[i].frames != 0;i++) {}
+    if( i >= PREMIX_HITS_MAX )
+        return -1;
+
+    Premix_Hit_t *hit = &premix->hits[i];
+    hit->start      = start;
+    hit->sound      = sound;
+    hit->data       = data;
+    hit->step       = step;
+    hit->instrument = instrument;
+    hit->frames     = length/2;     // Published
+    if( i == premix->hit_count ) premix->hit_count = i+1;
+    return (int) i;
+}
+
+/**
+ * @brief   Returns the index of the hit of a step and instrument or -1
+ */
+int Premix_FindHit(const Premix_t *premix, uint8_t step, uint8_t instrument) {
+
+    for(uint32_t i=0;i<premix->hit_count;i++) {
+        const Premix_Hit_t *hit = &premix->hits[i];
+        if( hit->frames != 0 && hit->step == step && hit->instrument == instrument )
+            return (int) i;
+    }
+    return -1;
+}
+
+/**
+ * @brief   Premix_Render
+ *
+ * @note    Renders the next blocks of the loop. It is meant to be called
+ *          repeatedly from the background until it returns 1
+ *
+ * @param   budget  Maximal number of samples to render in this call. At
+ *                  least one block is rendered
+ *
+ * @returns 1 when the whole loop is rendered, 0 otherwise, -1 when it
+ *          has more loud blocks than PREMIX_WIDE_BLOCKS (not usable)
+ */
+int Premix_Render(Premix_t *premix, uint32_t budget) {
+int32_t acc[PREMIX_BLOCK];
+const uint32_t length = premix->length;
+
+    do {
+        if( premix->rendered >= length )
+            break;
+
+        uint32_t first = premix->rendered;
+        uint32_t n = length - first;
+        uint32_t bound = 0;
+        if( n > PREMIX_BLOCK ) n = PREMIX_BLOCK;
+
+        for(uint32_t j=0;j<n;j++) acc[j] = 0;
+
+        for(uint32_t h=0;h<premix->hit_count;h++) {
+            const Premix_Hit_t *hit = &premix->hits[h];
+            const uint32_t frames = hit->frames;
+            const uint32_t d0 = offset(premix, hit, first);
+            for(uint32_t base=0;base<frames;base+=length) {
+                uint32_t m = 0;
+                uint32_t d = d0;
+                for(uint32_t j=0;j<n;j++) {
+                    uint32_t f = base + d;
+                    if( f < frames ) {
+                        int32_t v = frame(hit, f);
+                        uint32_t a = (uint32_t) (v < 0 ? -v : v);
+                        acc[j] += v;
+                        if( a > m ) m = a;
+                    }
+                    if( ++d == length ) d = 0;
+                }
+                bound += m;
+            }
+        }
+
+        // Stored modulo 2^16. Exact while the samples fit in 16 bits
+        for(uint32_t j=0;j<n;j++) {
+            premix->buffer[first+j] = (int16_t) (uint16_t) acc[j];
+        }
+        premix->bound[first>>PREMIX_BLOCK_SHIFT] = bound;
+        if( set_wide(premix, first>>PREMIX_BLOCK_SHIFT, acc) < 0 )
+            return -1;
+        premix->rendered += n;
+        budget = (budget > n) ? budget - n : 0;
+    } while( budget > 0 );
+
+    return premix->rendered >= length;
+}
+
+/**
+ * @brief   Premix_PatchAdd
+ *
+ * @note    Adds a hit to a rendered loop. Only the samples covered by the
+ *          sound are updated
+ *
+ * @returns Index of the hit, -1 if there is no room for it or for the
+ *          loud blocks it makes (the loop must then be rendered again)
+ */
+int Premix_PatchAdd(Premix_t *premix, uint32_t start, uint8_t sound,
+                    const int16_t *data, uint32_t length,
+                    uint8_t step, uint8_t instrument) {
+int h;
+
+    h = Premix_AddHit(premix, start, sound, data, length, step, instrument);
+    if( h < 0 )
+        return -1;
+    if( patch(premix, &premix->hits[h], premix->hits[h].frames, 1) < 0 )
+        return -1;
+    return h;
+}
+
+/**
+ * @brief   Premix_PatchRemove
+ *
+ * @note    Subtracts a hit from a rendered loop and retires it
+ *
+ * @returns 0=OK, -1 if the hit does not exist
+ */
+int Premix_PatchRemove(Premix_t *premix, int h) {
+
+    if( h < 0 || (uint32_t) h >= premix->hit_count || premix->hits[h].frames == 0 )
+        return -1;
+
+    Premix_Hit_t *hit = &premix->hits[h];
+    uint32_t frames = hit->frames;
+    hit->frames = 0;                // Retired
+    patch(premix, hit, frames, -1);     // Bounds only go down
+    return 0;
+}
+
+/**
+ * @brief   Premix_Sum
+ *
+ * @note    Sums the sample at loop position pos from the hit list, for the
+ *          32 bit slots. O(hits) per sample: background only
+ */
+int32_t Premix_Sum(const Premix_t *premix, uint32_t pos) {
+int32_t sum = 0;
+const uint32_t length = premix->length;
+
+    for(uint32_t h=0;h<premix->hit_count;h++) {
+        const Premix_Hit_t *hit = &premix->hits[h];
+        const uint32_t frames = hit->frames;
+        for(uint32_t f=offset(premix, hit, pos);f<frames;f+=length) {
+            sum += frame(hit, f);
+        }
+    }
+    return sum;
+}
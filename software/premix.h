@@ -0,0 +1,91 @@
+/** ***************************************************************************
+ * @file    premix.h
+ * @brief   Premixed loop buffer
+ * @version 1.1
+ *
+ * @note    Holds one full loop of a pattern rendered into RAM, including the
+ *          tails that wrap into the next loop. Once rendered, playback is a
+ *          copy per sample instead of a mix of all voices.
+ *
+ * @note    The RAM is reserved at compile time with PREMIX_BYTES (default 0,
+ *          which disables the cache). A loop that does not fit is not
+ *          cached and the player keeps mixing live. At 22050 Hz and 16 steps,
+ *          64 KB holds loops down to about 162 BPM.
+ *
+ * @note    Samples are accumulated modulo 2^16, so a hit can be added or
+ *          subtracted later (Premix_PatchAdd/Premix_PatchRemove) without
+ *          rendering the loop again. Each block of PREMIX_BLOCK samples keeps
+ *          the sum of the peaks of the hits that touch it. When it fits in
+ *          16 bits the stored value is exact. Otherwise the samples of the
+ *          block are summed, and if one of them does not fit the block is
+ *          also kept in 32 bits, in one of PREMIX_WIDE_BLOCKS slots (8 KB
+ *          by default), filled by the render and the patches in the
+ *          background. Premix_Read is a copy either way. A loop with more
+ *          loud blocks than slots is not cached (Premix_Render returns -1)
+ *          and the player mixes it live. The rock pattern has up to 17.
+******************************************************************************/
+#ifndef PREMIX_H
+#define PREMIX_H
+#include <stdint.h>
+
+#ifndef PREMIX_BYTES
+#define PREMIX_BYTES            0
+#endif
+
+#ifndef PREMIX_WIDE_BLOCKS
+#define PREMIX_WIDE_BLOCKS      32      // Blocks kept in 32 bits (256 bytes each), up to 32
+#endif
+
+#define PREMIX_HITS_MAX         96      // Hits in one loop (steps x instruments)
+#define PREMIX_BLOCK_SHIFT      6
+#define PREMIX_BLOCK            (1<<PREMIX_BLOCK_SHIFT) // Samples per peak bound
+#define PREMIX_NARROW           0xFF    // Block without a 32 bit slot
+
+typedef struct {
+    uint32_t       start;       // Loop position of the first frame
+    const int16_t  *data;       // Interleaved stereo samples
+    volatile uint32_t frames;   // Length in frames. 0 = unused slot
+    uint8_t        sound;       // Sound bank entry
+    uint8_t        step;        // Step and instrument that created the hit
+    uint8_t        instrument;
+} Premix_Hit_t;
+
+typedef struct {
+    int16_t        *buffer;     // Premixed samples (modulo 2^16)
+    uint32_t       *bound;      // Peak bound of each block
+    uint8_t        *wide_of;    // Slot of each loud block, PREMIX_NARROW if none
+    int32_t        (*wide)[PREMIX_BLOCK]; // Exact samples of those blocks
+    uint32_t       wide_used;   // Bit i: slot i in use
+    uint32_t       length;      // Loop length in samples
+    uint32_t       rendered;    // Samples already rendered
+    volatile uint32_t hit_count;
+    Premix_Hit_t   hits[PREMIX_HITS_MAX];
+} Premix_t;
+
+int      Premix_Reset(Premix_t *premix, uint32_t length);
+int      Premix_AddHit(Premix_t *premix, uint32_t start, uint8_t sound,
+                       const int16_t *data, uint32_t length,
+                       uint8_t step, uint8_t instrument);
+int      Premix_FindHit(const Premix_t *premix, uint8_t step, uint8_t instrument);
+int      Premix_Render(Premix_t *premix, uint32_t budget);
+int      Premix_PatchAdd(Premix_t *premix, uint32_t start, uint8_t sound,
+                         const int16_t *data, uint32_t length,
+                         uint8_t step, uint8_t instrument);
+int      Premix_PatchRemove(Premix_t *premix, int hit);
+int32_t  Premix_Sum(const Premix_t *premix, uint32_t pos);
+uint32_t Premix_GetCapacity(void);
+
+/**
+ * @brief   Returns the premixed sample at loop position pos (not saturated)
+ *
+ * @note    Constant time: a 16 bit copy, or a 32 bit one for a loud block
+ */
+static inline int32_t Premix_Read(const Premix_t *premix, uint32_t pos) {
+uint32_t block = pos>>PREMIX_BLOCK_SHIFT;
+
+    if( premix->wide_of[block] == PREMIX_NARROW )
+        return premix->buffer[pos];
+    return premix->wide[premix->wide_of[block]][pos&(PREMIX_BLOCK-1)];
+}
+
+#endif // PREMIX_H
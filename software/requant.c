@@ -0,0 +1,41 @@
+/** ***************************************************************************
+ * @file    requant.c
+ * @brief   Requantization of 16 bit samples to the resolution of the output
+ * @version 1.0
+******************************************************************************/
+#include "requant.h"
+
+/**
+ * @brief   Requant_Init
+ *
+ * @param   bits    Resolution of the output (1 to 15)
+ * @param   mode    REQUANT_TRUNCATE or an OR of REQUANT_DITHER and one of
+ *                  REQUANT_SHAPE1/REQUANT_SHAPE2
+ *
+ * @returns 0=OK, -1 if bits is out of range
+ */
+int Requant_Init(Requant_t *r, unsigned bits, unsigned mode) {
+
+    if( bits < 1 || bits > 15 )
+        return -1;
+
+    r->mode = (uint8_t) mode;
+    r->shift = (uint8_t) (16 - bits);
+    r->max = (uint16_t) ((1u<<bits) - 1);
+    r->e1 = 0;
+    r->e2 = 0;
+    r->seed = 22050;
+    return 0;
+}
+
+/**
+ * @brief   Requant_ProcessBlock
+ *
+ * @note    Same as calling Requant_Process for every sample
+ */
+RAMFUNC void Requant_ProcessBlock(Requant_t *r, const int16_t *in, uint16_t *out, uint32_t n) {
+
+    for(uint32_t k=0;k<n;k++) {
+        out[k] = (uint16_t) Requant_Process(r, in[k]);
+    }
+}
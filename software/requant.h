@@ -0,0 +1,77 @@
+/** ***************************************************************************
+ * @file    requant.h
+ * @brief   Requantization of 16 bit samples to the resolution of the output
+ * @version 1.0
+ *
+ * @note    The output code is offset binary, 0 to 2^bits-1, ready for
+ *          PWM_Write (7 bits) or DAC_SetOutput (12 bits).
+ *
+ * @note    Modes (OR of flags):
+ *          - REQUANT_TRUNCATE: drop the low bits, as the output used to do.
+ *          - REQUANT_DITHER: add TPDF dither of +/- 1 LSB of the output, so
+ *            the error is noise and not distortion correlated with the signal.
+ *          - REQUANT_SHAPE1/REQUANT_SHAPE2: feed back the error with
+ *            (1 - z^-1) or (1 - z^-1)^2, moving the noise towards fs/2.
+ *
+ * @note    The error kept for shaping is limited to one step, so a clipped
+ *          output does not make the loop unstable.
+******************************************************************************/
+#ifndef REQUANT_H
+#define REQUANT_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#define REQUANT_TRUNCATE        0x00
+#define REQUANT_DITHER          0x01
+#define REQUANT_SHAPE1          0x02
+#define REQUANT_SHAPE2          0x04
+
+typedef struct {
+    uint8_t  mode;
+    uint8_t  shift;             // 16 - bits
+    uint16_t max;               // 2^bits - 1
+    int32_t  e1, e2;            // Last errors
+    uint32_t seed;              // Dither generator
+} Requant_t;
+
+int  Requant_Init(Requant_t *r, unsigned bits, unsigned mode);
+RAMFUNC void Requant_ProcessBlock(Requant_t *r, const int16_t *in, uint16_t *out, uint32_t n);
+
+/**
+ * @brief   Requantizes one sample
+ */
+static inline unsigned Requant_Process(Requant_t *r, int16_t sample) {
+const unsigned shift = r->shift;
+const int32_t step = 1<<shift;
+int32_t u = sample;
+int32_t c;
+
+    if( r->mode == REQUANT_TRUNCATE )
+        return (unsigned) (sample + 32768) >> shift;
+
+    if( r->mode & REQUANT_SHAPE2 ) {
+        u += 2*r->e1 - r->e2;
+    } else if( r->mode & REQUANT_SHAPE1 ) {
+        u += r->e1;
+    }
+
+    c = u + 32768 + (step>>1);
+    if( r->mode & REQUANT_DITHER ) {
+        // Sum of two uniform 16 bit values: triangular, +/- one step
+        r->seed = r->seed*1664525u + 1013904223u;
+        int32_t d = (int32_t) (r->seed & 0xFFFF) + (int32_t) (r->seed >> 16) - 0xFFFF;
+        c += d >> (16 - shift);
+    }
+    c >>= shift;
+    if( c < 0 ) c = 0;
+    if( c > r->max ) c = r->max;
+
+    int32_t e = u - ((c<<shift) - 32768);
+    if( e > step ) e = step;
+    if( e < -step ) e = -step;
+    r->e2 = r->e1;
+    r->e1 = e;
+    return (unsigned) c;
+}
+
+#endif // REQUANT_H
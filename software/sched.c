@@ -0,0 +1,214 @@
+/** ***************************************************************************
+ * @file    sched.c
+ * @brief   Run to completion task scheduler for the main loop
+ * @version 1.0
+ *
+ * @note    Times are compared as differences, so the clock may wrap around.
+ *          Periods and deadlines must stay below 2^31 ticks.
+******************************************************************************/
+#include "sched.h"
+#include "trace.h"
+
+/**
+ * @brief   Adds a task to the table
+ *
+ * @returns Task id or -1 when the table is full
+ */
+static int add_task(Sched_t *sched, const char *name, Sched_Func_t func, void *arg,
+                    uint32_t period, uint32_t deadline) {
+Sched_Task_t *t;
+
+    if( sched->count >= SCHED_TASKS_MAX ) return -1;
+    t = &sched->tasks[sched->count];
+    t->name = name;
+    t->func = func;
+    t->arg = arg;
+    t->period = period;
+    t->deadline = deadline;
+    t->release = sched->clock();
+    t->pending = 0;
+    t->runs = 0;
+    t->overruns = 0;
+    t->skipped = 0;
+    t->exec_max = 0;
+    t->response_max = 0;
+    sched->count++;
+    sched->next = t->release;
+    return sched->count - 1;
+}
+
+/**
+ * @brief   Released: periodic with the release time reached, or signaled
+ */
+static int is_ready(const Sched_Task_t *t, uint32_t now) {
+
+    if( t->period ) return (int32_t) (now - t->release) >= 0;
+    return t->pending;
+}
+
+/**
+ * @brief   Sched_Init
+ *
+ * @param   clock   Returns the time in ticks
+ */
+void Sched_Init(Sched_t *sched, Sched_Clock_t clock) {
+
+    sched->count = 0;
+    sched->clock = clock;
+    sched->signaled = 0;
+    sched->next = clock();
+}
+
+/**
+ * @brief   Adds a periodic task. The first release is now
+ *
+ * @param   period      Ticks between releases (not 0)
+ * @param   deadline    Ticks from the release to the end of the job
+ *
+ * @returns Task id or -1 when the table is full
+ */
+int Sched_AddPeriodic(Sched_t *sched, const char *name, Sched_Func_t func, void *arg,
+                      uint32_t period, uint32_t deadline) {
+
+    if( period == 0 ) return -1;
+    return add_task(sched, name, func, arg, period, deadline);
+}
+
+/**
+ * @brief   Adds an event task, released by Sched_Signal
+ *
+ * @returns Task id or -1 when the table is full
+ */
+int Sched_AddEvent(Sched_t *sched, const char *name, Sched_Func_t func, void *arg,
+                   uint32_t deadline) {
+
+    return add_task(sched, name, func, arg, 0, deadline);
+}
+
+/**
+ * @brief   Releases an event task
+ *
+ * @note    Callable from interrupts. A task already released keeps its
+ *          first release time, so signals are not counted: the task must
+ *          find out itself how much work there is. Only stores, no read
+ *          modify write, so the main loop needs no lock
+ */
+void Sched_Signal(Sched_t *sched, int id) {
+Sched_Task_t *t = &sched->tasks[id];
+
+    if( !t->pending ) {
+        t->release = sched->clock();
+        t->pending = 1;
+    }
+    sched->signaled = 1;
+}
+
+/**
+ * @brief   Runs the released task with the earliest deadline
+ *
+ * @note    Called from the main loop, after every wake up. Without a
+ *          signal and before the next periodic release it returns at once,
+ *          without looking at the tasks
+ *
+ * @returns 1 when a task ran, 0 when none was released
+ */
+int Sched_Run(Sched_t *sched) {
+uint32_t now = sched->clock();
+uint32_t next = now + INT32_MAX;
+Sched_Task_t *best = 0;
+int32_t best_slack = 0;
+uint32_t release, start, end, exec, response;
+int more;
+
+    if( !sched->signaled && (int32_t) (now - sched->next) < 0 ) return 0;
+    sched->signaled = 0;        // Before the scan: a later signal is kept
+
+    for(int i=0;i<sched->count;i++) {
+        Sched_Task_t *t = &sched->tasks[i];
+        if( !is_ready(t, now) ) {
+            if( t->period && (int32_t) (t->release - next) < 0 ) next = t->release;
+            continue;
+        }
+        int32_t slack = (int32_t) (t->release + t->deadline - now);
+        if( !best || slack < best_slack ) {
+            best = t;
+            best_slack = slack;
+        }
+    }
+    if( !best ) {
+        sched->next = next;
+        return 0;
+    }
+    sched->next = now;          // Look again after the job
+
+    if( best->period ) {
+        // Releases lost while late: run once for the last one
+        uint32_t late = now - best->release;
+        if( late >= best->period ) {
+            uint32_t k = late/best->period;
+            best->skipped += k;
+            best->release += k*best->period;
+        }
+    } else {
+        // Cleared before the call, so a signal during the job releases it again
+        best->pending = 0;
+    }
+    release = best->release;    // A signal during the job moves it
+
+    start = sched->clock();
+    TRACE(TRACE_TASK_BEGIN, best - sched->tasks);
+    more = best->func(best->arg);
+    TRACE(TRACE_TASK_END, best - sched->tasks);
+    end = sched->clock();
+
+    exec = end - start;
+    if( exec > best->exec_max ) best->exec_max = exec;
+
+    if( more ) {
+        // Same job, same deadline
+        if( !best->period ) {
+            best->release = release;
+            best->pending = 1;
+        }
+        return 1;
+    }
+
+    response = end - release;
+    best->runs++;
+    if( response > best->response_max ) best->response_max = response;
+    if( response > best->deadline ) best->overruns++;
+    if( best->period ) best->release = release + best->period;
+    return 1;
+}
+
+/**
+ * @brief   Ticks until the next release
+ *
+ * @note    The main loop sleeps only when this is not 0. Call it with the
+ *          interrupts disabled, so a signal cannot come in between. Valid
+ *          after a Sched_Run that returned 0
+ *
+ * @returns 0 when a task may be released, else the ticks to the next
+ *          periodic release (2^31-1 without periodic tasks)
+ */
+uint32_t Sched_GetWait(Sched_t *sched) {
+int32_t wait = (int32_t) (sched->next - sched->clock());
+
+    if( sched->signaled || wait <= 0 ) return 0;
+    return (uint32_t) wait;
+}
+
+/**
+ * @brief   Clears the accounting of all tasks
+ */
+void Sched_ResetStats(Sched_t *sched) {
+
+    for(int i=0;i<sched->count;i++) {
+        Sched_Task_t *t = &sched->tasks[i];
+        t->runs = 0;
+        t->overruns = 0;
+        t->skipped = 0;
+        t->exec_max = 0;
+        t->response_max = 0;
+    }
+}
@@ -0,0 +1,70 @@
+/** ***************************************************************************
+ * @file    sched.h
+ * @brief   Run to completion task scheduler for the main loop
+ * @version 1.0
+ *
+ * @note    Tasks are functions called from the main loop, one at a time, and
+ *          never preempted by another task (the interrupts still preempt
+ *          them). A periodic task is released every period ticks; an event
+ *          task is released by Sched_Signal, from an interrupt or another
+ *          task. Among the released tasks the one with the earliest absolute
+ *          deadline (release + deadline) runs first, ties go to the task
+ *          added first.
+ *
+ * @note    A task returns nonzero when it has more work: it stays released,
+ *          with the same deadline, and the other tasks can run in between.
+ *          That splits a long job (rendering the premixed loop) in slices.
+ *
+ * @note    Accounting per task: runs, overruns (the job finished after its
+ *          deadline), skipped periods (a periodic task so late that whole
+ *          releases were lost; it runs once and keeps its phase), longest
+ *          slice and longest response (release to finish). All in ticks.
+ *
+ * @note    The time comes from a clock function with any tick and a 32 bit
+ *          counter that wraps around. The scheduler does not touch the
+ *          hardware, so it runs on the host with a virtual clock
+ *          (scripts/sched_sim.c).
+******************************************************************************/
+#ifndef SCHED_H
+#define SCHED_H
+#include <stdint.h>
+
+#define SCHED_TASKS_MAX         8
+
+typedef uint32_t (*Sched_Clock_t)(void);
+typedef int      (*Sched_Func_t)(void *arg);    // Nonzero: more work
+
+typedef struct {
+    const char      *name;
+    Sched_Func_t     func;
+    void            *arg;
+    uint32_t         period;            // 0 = event task
+    uint32_t         deadline;          // Relative to the release
+    volatile uint32_t release;          // Time of the current release
+    volatile uint8_t pending;           // Event task released
+    uint32_t         runs;              // Jobs finished
+    uint32_t         overruns;          // Jobs finished after the deadline
+    uint32_t         skipped;           // Periodic releases lost
+    uint32_t         exec_max;          // Longest call of func
+    uint32_t         response_max;      // Longest release to finish
+} Sched_Task_t;
+
+typedef struct {
+    Sched_Task_t     tasks[SCHED_TASKS_MAX];
+    uint8_t          count;
+    volatile uint8_t signaled;          // Some event task was released
+    uint32_t         next;              // Earliest periodic release
+    Sched_Clock_t    clock;
+} Sched_t;
+
+void     Sched_Init(Sched_t *sched, Sched_Clock_t clock);
+int      Sched_AddPeriodic(Sched_t *sched, const char *name, Sched_Func_t func, void *arg,
+                           uint32_t period, uint32_t deadline);
+int      Sched_AddEvent(Sched_t *sched, const char *name, Sched_Func_t func, void *arg,
+                        uint32_t deadline);
+void     Sched_Signal(Sched_t *sched, int id);
+int      Sched_Run(Sched_t *sched);
+uint32_t Sched_GetWait(Sched_t *sched);
+void     Sched_ResetStats(Sched_t *sched);
+
+#endif // SCHED_H
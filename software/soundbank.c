@@ -0,0 +1,95 @@
+/** ***************************************************************************
+ * @file    soundbank.c
+ * @brief   Validation and lookup of the sound bank flash region
+ * @version 1.0
+******************************************************************************/
+#include <stddef.h>
+#include "soundbank.h"
+
+/**
+ * @brief   Validated bank. Null when there is no valid bank
+ */
+static const SoundBank_Header_t *bank = 0;
+
+/**
+ * @brief   SoundBank_Init
+ *
+ * @note    Checks magic numbers, version, entry count and that every entry
+ *          lies inside the region
+ *
+ * @param   base  Start of the sound bank region
+ * @param   size  Size of the region in bytes. 0 skips the range checks
+ *                (used on the host, where the bank is not in its own region)
+ *
+ * @returns 0=OK, negative value when the bank is missing or invalid
+ */
+int SoundBank_Init(const void *base, uint32_t size) {
+const SoundBank_Header_t *h = (const SoundBank_Header_t *) base;
+
+    bank = 0;
+    if( !h )
+        return -1;
+
+    if( size && size < sizeof(SoundBank_Header_t) )
+        return -1;
+
+    // Erased flash reads as 0xFFFFFFFF, so this also catches an empty region
+    if( h->magic != SOUNDBANK_MAGIC || h->magic_end != SOUNDBANK_MAGIC_END )
+        return -2;
+
+    if( h->version != SOUNDBANK_VERSION )
+        return -3;
+
+    if( h->count == 0 || h->count > SOUNDBANK_ENTRIES_MAX )
+        return -4;
+
+    for(unsigned i=0;i<h->count;i++) {
+        const SoundBank_Entry_t *e = &h->entries[i];
+        // Voices consume one stereo frame per tick, read as a word (mixkernel.h)
+        if( !e->data || e->length == 0 || (e->length&1) != 0 || ((uintptr_t) e->data&3) != 0 )
+            return -5;
+        if( size ) {
+            uintptr_t start = (uintptr_t) e->data;
+            uintptr_t end   = start + e->length*sizeof(int16_t);
+            if( start < (uintptr_t) base || end > (uintptr_t) base + size )
+                return -6;
+        }
+    }
+
+    bank = h;
+    return 0;
+}
+
+/**
+ * @brief   Returns 1 when a valid bank was found by SoundBank_Init
+ */
+int SoundBank_IsValid(void) {
+
+    return bank != 0;
+}
+
+/**
+ * @brief   Returns the number of sounds in the bank
+ */
+unsigned SoundBank_Count(void) {
+
+    return bank ? bank->count : 0;
+}
+
+/**
+ * @brief   SoundBank_GetSound
+ *
+ * @param   index   Entry index (SOUNDBANK_KICK, ...)
+ * @param   length  Receives the length in int16_t. May be null
+ *
+ * @returns Pointer to the interleaved samples or null if not present
+ */
+const int16_t *SoundBank_GetSound(unsigned index, uint32_t *length) {
+
+    if( !bank || index >= bank->count ) {
+        if( length ) *length = 0;
+        return 0;
+    }
+    if( length ) *length = bank->entries[index].length;
+    return bank->entries[index].data;
+}
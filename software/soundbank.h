@@ -0,0 +1,50 @@
+/** ***************************************************************************
+ * @file    soundbank.h
+ * @brief   Sound bank stored in its own flash region
+ * @version 1.0
+ *
+ * @note    The bank is linked and flashed separately from the firmware
+ *          (see startup/soundbank.ld and 'make flash-bank'). It starts with
+ *          a versioned header that is validated by SoundBank_Init at boot.
+ *
+ * @note    Samples are interleaved stereo (even: left, odd: right) at the
+ *          engine sample rate.
+******************************************************************************/
+#ifndef SOUNDBANK_H
+#define SOUNDBANK_H
+#include <stdint.h>
+
+#define SOUNDBANK_MAGIC         0x4B4E4253UL    // "SBNK"
+#define SOUNDBANK_MAGIC_END     0x444E4542UL    // "BEND"
+#define SOUNDBANK_VERSION       1               // Bump when the layout changes
+#define SOUNDBANK_ENTRIES_MAX   8
+#define SOUNDBANK_NAME_MAX      8
+
+/**
+ * @brief   Bank entries, in the order they are stored in the image
+ */
+enum {
+    SOUNDBANK_KICK  = 0,
+    SOUNDBANK_SNARE = 1,
+};
+
+typedef struct {
+    char           name[SOUNDBANK_NAME_MAX];    // Not null terminated when full
+    const int16_t  *data;                       // Interleaved stereo samples
+    uint32_t       length;                      // Length in int16_t (2 per frame)
+} SoundBank_Entry_t;
+
+typedef struct {
+    uint32_t          magic;                    // SOUNDBANK_MAGIC
+    uint16_t          version;                  // SOUNDBANK_VERSION
+    uint16_t          count;                    // Number of valid entries
+    SoundBank_Entry_t entries[SOUNDBANK_ENTRIES_MAX];
+    uint32_t          magic_end;                // SOUNDBANK_MAGIC_END
+} SoundBank_Header_t;
+
+int             SoundBank_Init(const void *base, uint32_t size);
+int             SoundBank_IsValid(void);
+unsigned        SoundBank_Count(void);
+const int16_t  *SoundBank_GetSound(unsigned index, uint32_t *length);
+
+#endif // SOUNDBANK_H
@@ -0,0 +1,69 @@
+/** ***************************************************************************
+ * @file    telemetry.c
+ * @brief   Packets of performance counters on a word stream (ITM/SWO)
+ * @version 1.0
+******************************************************************************/
+#include <string.h>
+#include "telemetry.h"
+
+/**
+ * @brief   Telemetry_Init
+ *
+ * @param   write   Writes one word, returns 0 when the port is busy
+ */
+void Telemetry_Init(Telemetry_t *tm, Telemetry_Write_t write) {
+
+    tm->length = 0;
+    tm->sent = 0;
+    tm->seq = 0;
+    tm->packets = 0;
+    tm->dropped = 0;
+    tm->write = write;
+}
+
+/**
+ * @brief   Queues a packet and starts writing it
+ *
+ * @note    From the main loop only, the same context as Telemetry_Pump
+ *
+ * @param   payload Words of the payload
+ *
+ * @returns 1 when queued, 0 when dropped (previous packet not out yet)
+ */
+int Telemetry_Send(Telemetry_t *tm, unsigned type, const void *payload, unsigned words) {
+uint32_t sum;
+
+    if( words > TELEMETRY_WORDS_MAX ) return 0;
+    if( tm->sent < tm->length ) {
+        tm->dropped++;
+        return 0;
+    }
+
+    tm->words[0] = (uint32_t) TELEMETRY_MAGIC<<24 | (type&0xFF)<<16 | words<<8 | tm->seq++;
+    memcpy(&tm->words[1], payload, words*sizeof(uint32_t));
+    sum = 0;
+    for(unsigned i=0;i<=words;i++) sum += tm->words[i];
+    tm->words[words+1] = 0 - sum;
+    tm->length = words + 2;
+    tm->sent = 0;
+
+    Telemetry_Pump(tm);
+    return 1;
+}
+
+/**
+ * @brief   Writes the words of the packet until the port is busy
+ *
+ * @note    Called in the main loop at every wake up
+ *
+ * @returns Words still to write
+ */
+unsigned Telemetry_Pump(Telemetry_t *tm) {
+
+    while( tm->sent < tm->length ) {
+        if( !tm->write(tm->words[tm->sent]) ) break;
+        tm->sent++;
+        if( tm->sent == tm->length ) tm->packets++;
+    }
+    return tm->length - tm->sent;
+}
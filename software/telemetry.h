@@ -0,0 +1,75 @@
+/** ***************************************************************************
+ * @file    telemetry.h
+ * @brief   Packets of performance counters on a word stream (ITM/SWO)
+ * @version 1.0
+ *
+ * @note    A packet is a header word, the payload and a check word:
+ *
+ *              header  = TELEMETRY_MAGIC << 24 | type << 16 | words << 8 | seq
+ *              check   = 0 - (header + payload), so all the words add to 0
+ *
+ *          The decoder (scripts/swo_decode.py) finds the packets again after
+ *          lost words by the magic, the length and the check word.
+ *
+ * @note    Nothing waits for the port. Telemetry_Send only copies the packet;
+ *          Telemetry_Pump writes words while the port takes them and keeps
+ *          the rest for the next call. A packet sent while the previous one
+ *          is still going out is dropped and counted.
+ *
+ * @note    The port is a function, SWO_TryWrite on the target, so the same
+ *          code runs on the host (scripts/swo_capture.c).
+******************************************************************************/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include <stdint.h>
+
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE        0
+#endif
+
+#define TELEMETRY_MAGIC         0xA5
+#define TELEMETRY_WORDS_MAX     16      // Payload words
+
+/* Packet types. The decoder has the same table */
+enum {
+    TELEMETRY_STATS = 1                 // Payload: Telemetry_Stats_t
+};
+
+/* Payload of TELEMETRY_STATS, sent by the monitor task. Maxima and minima
+   are since the last reset of the statistics, counters since boot */
+typedef struct {
+    uint32_t time_ms;                   // RTC time
+    uint32_t isr_cycles_last;           // SysTick handler
+    uint32_t isr_cycles_max;
+    uint32_t render_cycles_max;         // PendSV, per block
+    uint32_t latency_max;               // SysTick entry latency
+    uint32_t voices;                    // Live voices
+    uint32_t voice_limit;               // Voice budget (voicebudget.h)
+    uint32_t steals;                    // Voices cut by the limit or new hits
+    uint32_t render_load;               // Last block, 1/VOICEBUDGET_ONE of its time
+    uint32_t fifo_fill;                 // Render-ahead FIFO, frames
+    uint32_t fifo_low;
+    uint32_t late_ticks;                // Missed deadlines by cause (deadline.h)
+    uint32_t fifo_underruns;
+    uint32_t i2s_underruns;
+    uint32_t late_steps;
+    uint32_t dropped;                   // Telemetry packets dropped
+} Telemetry_Stats_t;
+
+typedef int (*Telemetry_Write_t)(uint32_t word);   // 0: port busy
+
+typedef struct {
+    uint32_t          words[TELEMETRY_WORDS_MAX+2];
+    uint8_t           length;           // Words of the packet in words[]
+    uint8_t           sent;             // Words already written
+    uint8_t           seq;
+    uint32_t          packets;          // Packets written out
+    uint32_t          dropped;          // Packets dropped, port still busy
+    Telemetry_Write_t write;
+} Telemetry_t;
+
+void     Telemetry_Init(Telemetry_t *tm, Telemetry_Write_t write);
+int      Telemetry_Send(Telemetry_t *tm, unsigned type, const void *payload, unsigned words);
+unsigned Telemetry_Pump(Telemetry_t *tm);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,47 @@
+/** ***************************************************************************
+ * @file    trace.c
+ * @brief   Event trace in a RAM ring, for a timeline on the host
+ * @version 1.0
+******************************************************************************/
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+Trace_t trace;
+
+#if !defined(__arm__)
+volatile uint32_t trace_host_time;
+#endif
+
+/**
+ * @brief   Empties the ring and records every event
+ *
+ * @param   clock_hz    Rate of the time stamps (core clock on the target)
+ */
+void Trace_Init(uint32_t clock_hz) {
+
+    trace.mask = 0;
+    trace.magic = TRACE_MAGIC;
+    trace.records = TRACE_RECORDS;
+    trace.clock_hz = clock_hz;
+    trace.head = 0;
+    trace.mask = (1u<<TRACE_EVENTS) - 1;
+}
+
+/**
+ * @brief   Writes the header and the ring, as laid out in Trace_t
+ *
+ * @note    Recording stops during the dump, so the ring does not move
+ *          under the writer
+ *
+ * @param   write   Byte sink: UART, file
+ */
+void Trace_Dump(void (*write)(const void *data, uint32_t n, void *arg), void *arg) {
+uint32_t mask = trace.mask;
+
+    trace.mask = 0;
+    write(&trace, sizeof(trace), arg);
+    trace.mask = mask;
+}
+
+#endif // TRACE_ENABLE
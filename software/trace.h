@@ -0,0 +1,132 @@
+/** ***************************************************************************
+ * @file    trace.h
+ * @brief   Event trace in a RAM ring, for a timeline on the host
+ * @version 1.0
+ *
+ * @note    Each record is 8 bytes: a time stamp and a word with the event id
+ *          (bits 31..24) and a payload (bits 23..0). The ring keeps the last
+ *          TRACE_RECORDS events; head counts all of them.
+ *
+ * @note    Built with TRACE_ENABLE=1 only. Otherwise TRACE() expands to
+ *          nothing and the ring takes no RAM. Recording masks the interrupts
+ *          for the few instructions that claim and fill a record, so every
+ *          level can trace. Events can be turned off one by one in mask.
+ *
+ * @note    The time stamp is the DWT cycle counter on the target. On the
+ *          host it is trace_host_time, advanced by the host program.
+ *
+ * @note    Trace_Dump writes the header and the ring to any byte sink (a
+ *          UART, a file on the host). The debugger can also dump the
+ *          variable trace as it is ('make trace-dump'). Both give the same
+ *          bytes, which scripts/trace2json.py turns into Chrome trace JSON
+ *          for chrome://tracing or Perfetto.
+******************************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE            0
+#endif
+
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS           512     // A power of 2
+#endif
+
+#define TRACE_MAGIC             0x31435254  // "TRC1"
+
+/* Event ids. The decoder in scripts/trace2json.py has the same table */
+enum {
+    TRACE_ISR_ENTER,            // Payload: TRACE_IRQ_*
+    TRACE_ISR_EXIT,
+    TRACE_TASK_BEGIN,           // Payload: task id (sched.h)
+    TRACE_TASK_END,
+    TRACE_STEP,                 // Payload: step << 8 | instruments of the step
+    TRACE_VOICE_START,          // Payload: instrument << 8 | channel
+    TRACE_VOICE_END,            // Payload: channel
+    TRACE_VOICE_DROP,           // No free channel. Payload: instrument
+    TRACE_PATTERN,              // Payload: rythm number
+    TRACE_PREMIX,               // Payload: 1 = premixed loop playing, 0 = live
+    TRACE_UI,                   // Payload: TRACE_UI_* << 16 | value
+    TRACE_MARK,                 // Free use
+    TRACE_VOICE_STEAL,          // Cut for a new hit or the voice limit. Payload: channel
+    TRACE_EVENTS
+};
+
+enum {
+    TRACE_IRQ_SYSTICK,
+    TRACE_IRQ_PENDSV,
+    TRACE_IRQ_DMA,
+    TRACE_IRQ_GPIO
+};
+
+enum {
+    TRACE_UI_PAUSE,             // Button 1
+    TRACE_UI_RYTHM,             // Button 2
+    TRACE_UI_BPM                // Touch. Value: BPM
+};
+
+typedef struct {
+    uint32_t time;
+    uint32_t event;             // id << 24 | payload
+} Trace_Record_t;
+
+typedef struct {
+    uint32_t          magic;    // TRACE_MAGIC
+    uint32_t          records;  // TRACE_RECORDS
+    uint32_t          clock_hz; // Time stamps per second
+    volatile uint32_t mask;     // Bit id set: event id recorded
+    volatile uint32_t head;     // Records written, ring[head % records] is next
+    Trace_Record_t    ring[TRACE_RECORDS];
+} Trace_t;
+
+#if TRACE_ENABLE
+
+extern Trace_t trace;
+
+#if defined(__arm__)
+#define TRACE_TIME()            (*(volatile uint32_t *) 0xE0001004)    // DWT->CYCCNT
+#else
+extern volatile uint32_t trace_host_time;
+#define TRACE_TIME()            trace_host_time
+#endif
+
+void Trace_Init(uint32_t clock_hz);
+void Trace_Dump(void (*write)(const void *data, uint32_t n, void *arg), void *arg);
+
+/**
+ * @brief   Records an event
+ *
+ * @note    About a dozen cycles on the Cortex-M3. Always inlined, also at
+ *          -O0: it is called from the RAM interrupt handlers
+ */
+__attribute__((always_inline))
+static inline void Trace_Record(unsigned id, uint32_t payload) {
+#if defined(__arm__)
+uint32_t primask;
+#endif
+Trace_Record_t *r;
+
+    if( (trace.mask&(1u<<id)) == 0 ) return;
+#if defined(__arm__)
+    __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+#endif
+    r = &trace.ring[trace.head%TRACE_RECORDS];
+    trace.head++;
+    r->time = TRACE_TIME();
+    r->event = (uint32_t) id<<24 | (payload&0xFFFFFF);
+#if defined(__arm__)
+    __asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+#endif
+}
+
+#define TRACE(id, payload)      Trace_Record((id), (payload))
+
+#else
+
+#define TRACE(id, payload)      ((void) 0)
+#define Trace_Init(clock_hz)    ((void) 0)
+
+#endif // TRACE_ENABLE
+
+#endif // TRACE_H
@@ -0,0 +1,36 @@
+/** ***************************************************************************
+ * @file    upsample.c
+ * @brief   2x interpolation with a halfband FIR
+ * @version 1.0
+******************************************************************************/
+#include "upsample.h"
+
+/**
+ * @brief   Non-zero taps of one half, outermost first (Q15, x2 for the
+ *          interpolation gain). Both halves sum to 32768
+ */
+const int16_t upsample_taps[UPSAMPLE_HALF] = {
+    -70, 375, -1093, 2570, -5873, 20475
+};
+
+/**
+ * @brief   Upsample_Init
+ */
+void Upsample_Init(Upsample_t *u) {
+
+    for(unsigned k=0;k<2*UPSAMPLE_LENGTH;k++) u->x[k] = 0;
+    u->index = 0;
+}
+
+/**
+ * @brief   Upsample_ProcessBlock
+ *
+ * @param   in  n samples
+ * @param   out 2*n samples
+ */
+RAMFUNC void Upsample_ProcessBlock(Upsample_t *u, const int16_t *in, int16_t *out, uint32_t n) {
+
+    for(uint32_t k=0;k<n;k++) {
+        Upsample_Process(u, in[k], &out[2*k]);
+    }
+}
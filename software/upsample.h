@@ -0,0 +1,60 @@
+/** ***************************************************************************
+ * @file    upsample.h
+ * @brief   2x interpolation with a halfband FIR
+ * @version 1.0
+ *
+ * @note    23 tap halfband (Kaiser window, beta 5). Half of the taps are zero
+ *          and the centre one only delays the input, so each input sample
+ *          costs 6 multiplies: the other output phase is a plain copy.
+ *
+ * @note    Ripple below 8 kHz is under 0.1 dB. Images of content below
+ *          8 kHz, which land above 14 kHz at 44100 Hz, are at least 43 dB
+ *          down. 'make benchmark' measures both.
+ *
+ * @note    Delay: 5.5 input samples.
+******************************************************************************/
+#ifndef UPSAMPLE_H
+#define UPSAMPLE_H
+#include <stdint.h>
+#include "ramfunc.h"
+
+#define UPSAMPLE_HALF           6                       // Unique taps
+#define UPSAMPLE_LENGTH         (2*UPSAMPLE_HALF)       // Input samples used
+
+typedef struct {
+    int16_t  x[2*UPSAMPLE_LENGTH];      // History, stored twice
+    uint32_t index;
+} Upsample_t;
+
+extern const int16_t upsample_taps[UPSAMPLE_HALF];
+
+void Upsample_Init(Upsample_t *u);
+RAMFUNC void Upsample_ProcessBlock(Upsample_t *u, const int16_t *in, int16_t *out, uint32_t n);
+
+/**
+ * @brief   Takes one input sample and returns two output samples
+ *
+ * @note    out[0] is the interpolated sample, out[1] the delayed input
+ */
+static inline void Upsample_Process(Upsample_t *u, int16_t in, int16_t *out) {
+uint32_t i = u->index;
+
+    // Newest sample at w[0], oldest at w[UPSAMPLE_LENGTH-1]
+    i = (i == 0) ? UPSAMPLE_LENGTH-1 : i-1;
+    u->x[i] = in;
+    u->x[i+UPSAMPLE_LENGTH] = in;
+    u->index = i;
+    const int16_t *w = &u->x[i];
+
+    int32_t acc = 1<<14;
+    for(unsigned k=0;k<UPSAMPLE_HALF;k++) {
+        acc += upsample_taps[k] * (w[k] + w[UPSAMPLE_LENGTH-1-k]);
+    }
+    acc >>= 15;
+    if( acc > INT16_MAX ) acc = INT16_MAX;
+    if( acc < INT16_MIN ) acc = INT16_MIN;
+    out[0] = (int16_t) acc;
+    out[1] = w[UPSAMPLE_HALF-1];
+}
+
+#endif // UPSAMPLE_H
@@ -0,0 +1,110 @@
+/** ***************************************************************************
+ * @file    voicebudget.c
+ * @brief   Polyphony limit that follows the measured cost of mixing
+ * @version 1.0
+******************************************************************************/
+#include "voicebudget.h"
+
+/**
+ * @brief   VoiceBudget_Init
+ *
+ * @note    The limit starts at config->max. An invalid config falls back to
+ *          the default policy with the same max
+ *
+ * @param   period  Cycles available for one block (its playing time)
+ */
+void VoiceBudget_Init(VoiceBudget_t *vb, uint32_t period, const VoiceBudget_Config_t *config) {
+VoiceBudget_Config_t fallback = { VOICEBUDGET_HIGH, VOICEBUDGET_LOW, VOICEBUDGET_HOLD,
+                                  VOICEBUDGET_MIN, config->max };
+
+    vb->period = period ? period : 1;
+    vb->stats.limit = config->max;
+    if( VoiceBudget_SetConfig(vb, config) < 0 ) {
+        if( fallback.max < fallback.min ) fallback.max = fallback.min;
+        VoiceBudget_SetConfig(vb, &fallback);
+    }
+    VoiceBudget_ResetStats(vb);
+}
+
+/**
+ * @brief   Changes the policy at run time
+ *
+ * @note    The current limit is moved inside min..max
+ *
+ * @returns 0=OK, -1 if low >= high, hold is 0 or min is 0 or above max
+ */
+int VoiceBudget_SetConfig(VoiceBudget_t *vb, const VoiceBudget_Config_t *config) {
+
+    if( config->low >= config->high || config->hold == 0
+     || config->min == 0 || config->min > config->max )
+        return -1;
+    vb->config = *config;
+    if( vb->stats.limit > config->max ) vb->stats.limit = config->max;
+    if( vb->stats.limit < config->min ) vb->stats.limit = config->min;
+    vb->calm = 0;
+    return 0;
+}
+
+/**
+ * @brief   Takes the cost of a block and returns the voice limit
+ *
+ * @param   cycles  Cycles spent rendering the block, preemptions included
+ * @param   voices  Voices mixed in the block
+ *
+ * @returns Voices allowed from the next block on
+ */
+unsigned VoiceBudget_Update(VoiceBudget_t *vb, uint32_t cycles, unsigned voices) {
+VoiceBudget_Config_t *c = &vb->config;
+VoiceBudget_Stats_t *s = &vb->stats;
+uint32_t load;
+
+    if( cycles > 4*vb->period ) cycles = 4*vb->period;    // No overflow below
+    load = cycles*VOICEBUDGET_ONE/vb->period;
+    s->load = load;
+    if( load > s->load_max ) s->load_max = load;
+    if( load > VOICEBUDGET_ONE ) s->overloads++;
+
+    if( load > c->high ) {
+        vb->calm = 0;
+        // Voices that fit under high if the cost is all in the voices
+        unsigned fit = voices*c->high/load;
+        if( voices && fit < s->limit ) {
+            if( fit < c->min ) fit = c->min;
+            if( fit < s->limit ) {
+                s->limit = fit;
+                s->lowered++;
+            }
+        }
+    } else if( load < c->low ) {
+        if( s->limit >= c->max ) {
+            vb->calm = 0;
+        } else if( ++vb->calm >= c->hold ) {
+            vb->calm = 0;
+            s->limit++;
+            s->raised++;
+        }
+    } else {
+        vb->calm = 0;
+    }
+    return s->limit;
+}
+
+/**
+ * @brief   Copies the state and the statistics
+ */
+void VoiceBudget_GetStats(const VoiceBudget_t *vb, VoiceBudget_Stats_t *stats) {
+
+    *stats = vb->stats;
+}
+
+/**
+ * @brief   Clears the load maximum and the counters. The limit stays
+ */
+void VoiceBudget_ResetStats(VoiceBudget_t *vb) {
+
+    vb->stats.load = 0;
+    vb->stats.load_max = 0;
+    vb->stats.lowered = 0;
+    vb->stats.raised = 0;
+    vb->stats.overloads = 0;
+}
@@ -0,0 +1,63 @@
+/** ***************************************************************************
+ * @file    voicebudget.h
+ * @brief   Polyphony limit that follows the measured cost of mixing
+ * @version 1.0
+ *
+ * @note    The mixer reports the cycles of every block it renders and the
+ *          voices it mixed. The load is those cycles over the time the block
+ *          plays, in 1/VOICEBUDGET_ONE. Above config.high the limit drops at
+ *          once to the voices that fit under high, assuming the cost grows
+ *          with the voices; the player then steals the quietest voices (see
+ *          Player_SetVoiceLimit). After config.hold blocks in a row below
+ *          config.low the limit goes up by one voice. Between low and high
+ *          it stays, so it does not swing at every block.
+ *
+ * @note    Effects, filters or oversampling cost more per block: the limit
+ *          then settles lower instead of missing the output deadline.
+ *
+ * @note    No hardware: the cycles come from the caller, so it runs on the
+ *          host (scripts/benchmark.c).
+******************************************************************************/
+#ifndef VOICEBUDGET_H
+#define VOICEBUDGET_H
+#include <stdint.h>
+
+#define VOICEBUDGET_ONE         1024    // Load of a block that takes all its time
+
+/* Default policy */
+#define VOICEBUDGET_HIGH        717     // 70 %, leaves time for the output and the tasks
+#define VOICEBUDGET_LOW         461     // 45 %
+#define VOICEBUDGET_HOLD        64      // Blocks, about 90 ms of 32 samples at 22.05 kHz
+#define VOICEBUDGET_MIN         2
+
+typedef struct {
+    uint16_t high;              // Load above which the limit is lowered
+    uint16_t low;               // Load below which it may go up
+    uint16_t hold;              // Blocks below low for each voice added
+    uint8_t  min;               // Limits of the limit
+    uint8_t  max;
+} VoiceBudget_Config_t;
+
+typedef struct {
+    uint8_t  limit;             // Voices allowed now
+    uint32_t load;              // Last block, 1/VOICEBUDGET_ONE
+    uint32_t load_max;
+    uint32_t lowered;           // Times the limit went down
+    uint32_t raised;            // Times it went up
+    uint32_t overloads;         // Blocks that took longer than they play
+} VoiceBudget_Stats_t;
+
+typedef struct {
+    VoiceBudget_Config_t config;
+    uint32_t             period;        // Cycles of a block at the output rate
+    uint16_t             calm;          // Blocks in a row below low
+    VoiceBudget_Stats_t  stats;
+} VoiceBudget_t;
+
+void     VoiceBudget_Init(VoiceBudget_t *vb, uint32_t period, const VoiceBudget_Config_t *config);
+int      VoiceBudget_SetConfig(VoiceBudget_t *vb, const VoiceBudget_Config_t *config);
+unsigned VoiceBudget_Update(VoiceBudget_t *vb, uint32_t cycles, unsigned voices);
+void     VoiceBudget_GetStats(const VoiceBudget_t *vb, VoiceBudget_Stats_t *stats);
+void     VoiceBudget_ResetStats(VoiceBudget_t *vb);
+
+#endif // VOICEBUDGET_H
@@ -0,0 +1,34 @@
+/** ***************************************************************************
+ * @file    soundbank.c
+ * @brief   Sound bank image
+ * @version 1.0
+ *
+ * @note    Not part of the firmware. It is linked alone with
+ *          startup/soundbank.ld into the SOUNDBANK flash region and flashed
+ *          with 'make flash-bank'. Changing a sound only requires rebuilding
+ *          and flashing this image.
+ *
+ * @note    Entry order must follow the SOUNDBANK_xxx enumeration
+******************************************************************************/
+#include <stdint.h>
+#include "soundbank.h"
+
+// Frames are read as words by the mixer, so the arrays are word aligned
+extern const int16_t KICK[] __attribute__((aligned(4)));
+extern const int16_t SNARE[] __attribute__((aligned(4)));
+
+#include "resampled_kick.h"
+#include "resampled_snare.h"
+
+#define ENTRY(NAME,ARRAY) { NAME, ARRAY, sizeof(ARRAY)/sizeof(ARRAY[0]) }
+
+const SoundBank_Header_t soundbank __attribute__((section(".soundbank.header"), used)) = {
+    .magic      = SOUNDBANK_MAGIC,
+    .version    = SOUNDBANK_VERSION,
+    .count      = 2,
+    .entries    = {
+        [SOUNDBANK_KICK]  = ENTRY("KICK",  KICK),
+        [SOUNDBANK_SNARE] = ENTRY("SNARE", SNARE),
+    },
+    .magic_end  = SOUNDBANK_MAGIC_END
+};
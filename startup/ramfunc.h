@@ -0,0 +1,28 @@
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+/**
+ * @file    ramfunc.h
+ * @brief   Annotation for functions executed from RAM
+ *
+ * @note    Functions marked with RAMFUNC are placed in the .ramfunc section,
+ *          which is copied from flash to RAM by Reset_Handler. At 48 MHz the
+ *          flash needs wait states, so the audio hot path runs from RAM and
+ *          leaves the flash bus to the sample reads.
+ *
+ * @note    RAM is out of range of a BL instruction from flash, so calls use
+ *          long_call. Mark the prototype too, so callers in other files
+ *          generate the right call.
+ *
+ * @note    Set RAMFUNC_DISABLE to run everything from flash. On the host
+ *          RAMFUNC expands to nothing.
+ *
+ * @note    The RAM cost is reported by 'make size'
+ */
+
+#if defined(__arm__) && !defined(RAMFUNC_DISABLE)
+#define RAMFUNC __attribute__((section(".ramfunc"),long_call,noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif // RAMFUNC_H
@@ -98,6 +98,9 @@ typedef void( *pFunc )( void );
 extern uint32_t __etext;
 extern uint32_t __data_start__;
 extern uint32_t __data_end__;
+extern uint32_t __ramfunc_load__;
+extern uint32_t __ramfunc_start__;
+extern uint32_t __ramfunc_end__;
 /*
  * These symbols are now defined in the *cmsis_gcc.h* header
  * file included by the *efm32gg990f1024.h* header file
@@ -340,6 +343,23 @@ uint32_t *pTable __attribute__((unused));
   }
 #endif /*__STARTUP_COPY_MULTIPLE */
 
+/*  Code placed in the .ramfunc section (see ramfunc.h) runs from RAM.
+ *
+ *  The ranges of copy from/to are specified by following symbols
+ *    __ramfunc_load__: LMA of the section, just after the data initializers
+ *    __ramfunc_start__: VMA of start of the section to copy to
+ *    __ramfunc_end__: VMA of end of the section to copy to
+ *
+ *  All addresses must be aligned to 4 bytes boundary.
+ */
+  pSrc  = &__ramfunc_load__;
+  pDest = &__ramfunc_start__;
+
+  for ( ; pDest < &__ramfunc_end__ ; )
+  {
+    *pDest++ = *pSrc++;
+  }
+
 /*  This part of work usually is done in C library startup code. Otherwise,
  *  define this macro to enable it in this startup.
  *